@@ -1,16 +1,30 @@
 #!/usr/bin/env python3
+import sys
 import time
 import subprocess
 from new_run_server import NewServerManager
 from new_run_client import run_client
 
-def run_experiment(sizes_mb, server_port=8888, cc_algo="cubic"):
-    """Run experiments for different data sizes"""
+def perf_log_stats(perf_log, size_bytes):
+    """Queueing delay (srtt - min_rtt) mean and p95 in ms, and retransmitted % of a perf log"""
+    result = subprocess.run(["./src/build/bin/perf_log_tsv", perf_log],
+                            stdout=subprocess.PIPE, universal_newlines=True)
+    # columns: min_rtt avg_urtt cnt srtt_us avg_thr thr_cnt pacing_rate loss_bytes ...
+    rows = [list(map(int, line.split("\t"))) for line in result.stdout.splitlines()
+            if line[:1].isdigit()]
+    delays = sorted((row[3] - row[0]) / 1000 for row in rows if row[0] > 0)
+    if not delays:
+        return None
+    retransmitted = 100 * sum(row[7] for row in rows) / size_bytes
+    return sum(delays) / len(delays), delays[len(delays) * 95 // 100], retransmitted
+
+def run_experiment(sizes_mb, server_port=8888, cc_algo="cubic", actuations=("cwnd",)):
+    """Run experiments for different data sizes, once per actuation (cwnd or pacing)"""
     server = NewServerManager()
     results = []
     
-    for size_mb in sizes_mb:
-        print(f"\n=== Testing {size_mb} MB ===")
+    for size_mb, actuation in [(size_mb, actuation) for size_mb in sizes_mb for actuation in actuations]:
+        print(f"\n=== Testing {size_mb} MB, {actuation} actuation ===")
         
         try:
             # Start server
@@ -18,7 +32,8 @@ def run_experiment(sizes_mb, server_port=8888, cc_algo="cubic"):
             server.start_server(
                 port=server_port,
                 cc_algo=cc_algo,
-                perf_log=f"server_perf_{size_mb}mb.log"
+                perf_log=f"server_perf_{size_mb}mb_{actuation}.log",
+                actuation=actuation
             )
             
             # Wait a bit for server to be ready
@@ -32,20 +47,20 @@ def run_experiment(sizes_mb, server_port=8888, cc_algo="cubic"):
                 port=server_port,
                 size_bytes=size_bytes,
                 cc_algo=cc_algo,
-                perf_log=f"client_perf_{size_mb}mb.log"
+                perf_log=f"client_perf_{size_mb}mb_{actuation}.log"
             )
             
             if success:
                 throughput_mbps = (size_mb * 8) / duration
-                results.append((size_mb, duration, throughput_mbps))
+                results.append((size_mb, actuation, duration, throughput_mbps))
                 print(f"Success: {duration:.2f}s, {throughput_mbps:.2f} Mbps")
             else:
                 print(f"Failed for {size_mb} MB")
-                results.append((size_mb, None, None))
+                results.append((size_mb, actuation, None, None))
             
         except Exception as e:
             print(f"Error during {size_mb} MB test: {e}")
-            results.append((size_mb, None, None))
+            results.append((size_mb, actuation, None, None))
         
         finally:
             # Stop server
@@ -54,19 +69,28 @@ def run_experiment(sizes_mb, server_port=8888, cc_algo="cubic"):
     
     # Print summary
     print("\n=== EXPERIMENT RESULTS ===")
-    print("Size (MB)\tDuration (s)\tThroughput (Mbps)")
-    print("-" * 45)
-    for size_mb, duration, throughput in results:
+    print("Size (MB)\tActuation\tDuration (s)\tThroughput (Mbps)\tQueueing delay (ms)\tRetransmitted (%)")
+    print("-" * 105)
+    for size_mb, actuation, duration, throughput in results:
         if duration is not None:
-            print(f"{size_mb}\t\t{duration:.2f}\t\t{throughput:.2f}")
+            stats = perf_log_stats(f"server_perf_{size_mb}mb_{actuation}.log",
+                                   int(size_mb * 1024 * 1024))
+            if stats:
+                delay, retransmitted = f"{stats[0]:.2f} (p95 {stats[1]:.2f})", f"{stats[2]:.3f}"
+            else:
+                delay, retransmitted = "-", "-"
+            print(f"{size_mb}\t\t{actuation}\t\t{duration:.2f}\t\t{throughput:.2f}\t\t\t{delay}\t\t{retransmitted}")
         else:
-            print(f"{size_mb}\t\tFAILED\t\tFAILED")
+            print(f"{size_mb}\t\t{actuation}\t\tFAILED\t\tFAILED")
 
 if __name__ == "__main__":
     # Test different sizes
     test_sizes = [1, 5, 10, 50, 100]  # MB
+    # new_run_experiment.py [ALGORITHM [ACTUATION...]], e.g. astraea cwnd pacing
+    cc_algo = sys.argv[1] if len(sys.argv) > 1 else "cubic"
+    actuations = tuple(sys.argv[2:]) or ("cwnd",)
     
     print("Starting network performance experiment...")
     print(f"Testing sizes: {test_sizes} MB")
     
-    run_experiment(test_sizes, server_port=8888, cc_algo="cubic")
\ No newline at end of file
+    run_experiment(test_sizes, server_port=8888, cc_algo=cc_algo, actuations=actuations)
\ No newline at end of file
@@ -8,14 +8,15 @@ class NewServerManager:
     def __init__(self):
         self.process = None
     
-    def start_server(self, port=8888, cc_algo="cubic", perf_log=None):
+    def start_server(self, port=8888, cc_algo="cubic", perf_log=None, actuation="cwnd"):
         """Start the new server sender process"""
         cmd = [
             "./src/build/bin/new_server_sender",
             f"--port={port}",
             f"--cong={cc_algo}",
             f"--pyhelper=./python/infer.py",
-            f"--model=./models/py-model1/"
+            f"--model=./models/py-model1/",
+            f"--actuation={actuation}"
         ]
         
         if perf_log:
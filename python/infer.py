@@ -139,6 +139,9 @@ def main():
 
     while True:
         info = ipc_sock.read()
+        if info is None:
+            # the flow has finished (or was never handed this helper)
+            break
         info = json.loads(info)
         state = info["state"]
         # logger.info("RL: state is {}".format(state))
@@ -12,6 +12,7 @@
 #include <vector>
 
 #include "address.hh"
+#include "bulk_sender.hh"
 #include "common.hh"
 #include "current_time.hh"
 #include "deepcc_socket.hh"
@@ -22,12 +23,14 @@
 #include "logging.hh"
 #include "poller.hh"
 #include "serialization.hh"
+#include "signalfd.hh"
 #include "socket.hh"
 #include "tcp_info.hh"
+#include "timestamp.hh"
 
 using namespace std;
 using namespace std::literals;
-using clock_type = std::chrono::high_resolution_clock;
+using clock_type = SteadyClock;
 using namespace PollerShortNames;
 typedef DeepCCSocket::TCPInfoRequestType RequestType;
 
@@ -41,7 +44,9 @@ std::atomic<bool> send_traffic(true);
 std::atomic<bool> do_polling(true);
 int global_flow_id = -1;
 IPC_ptr ipc = nullptr;
-std::chrono::_V2::system_clock::time_point ts_now = clock_type::now();
+/* payload of the last message from the inference side */
+static char ipc_buffer[UINT16_MAX];
+clock_type::time_point ts_now = clock_type::now();
 
 /* define message type */
 enum class MessageType { INIT = 0, START = 1, END = 2, ALIVE = 3, OBSERVE = 4 };
@@ -66,9 +71,9 @@ void ipc_send_message(IPC_ptr& ipc_sock, const MessageType& type,
     message["type"] = to_underlying(type);
   }
 
-  uint16_t len = message.dump().length();
+  const std::string payload = message.dump();
   if (ipc_sock) {
-    ipc_sock->write(put_field(len) + message.dump());
+    ipc_sock->writev({put_field(payload.size()), payload});
   }
 }
 
@@ -81,9 +86,8 @@ void signal_handler(int sig) {
       // message";
     }
     LOG(INFO) << "Caught signal, Client " << global_flow_id << " exiting...";
-    // first disable read from fd
-    poller.remove_fd(ipc->fd_num());
-    // disable write to IPC
+    // disable write to IPC; the polling loop stops reading once it sees
+    // do_polling, as the poller is not ours to change from this thread
     ipc->set_disconnected();
     do_polling = false;
     send_traffic = false;
@@ -141,14 +145,16 @@ void control_thread(DeepCCSocket& sock, IPC_ptr& ipc,
       *ipc, Direction::In,
       // callback
       [&]() -> ResultType {
-        auto header = ipc->read_exactly(2);
-        auto data_len = get_uint16(header.data());
-        auto data = ipc->read_exactly(data_len);
-        int type = json::parse(data).at("type");
+        char header[2];
+        ipc->read_exactly_into(header, sizeof(header));
+        const auto data_len = get_uint16(header);
+        ipc->read_exactly_into(ipc_buffer, data_len);
+        const json message = json::parse(ipc_buffer, ipc_buffer + data_len);
+        int type = message.at("type");
         if (type == static_cast<int>(MessageType::OBSERVE)) {
           // observer wants to observe the world
-          int observer = json::parse(data).at("observer");
-          int step = json::parse(data).at("step");
+          int observer = message.at("observer");
+          int step = message.at("step");
           LOG(TRACE) << "Client " << global_flow_id
                      << " received message from observer: " << observer
                      << ", step: " << step << " to observe to world";
@@ -156,8 +162,8 @@ void control_thread(DeepCCSocket& sock, IPC_ptr& ipc,
           ipc_send_message(ipc, MessageType::OBSERVE, data, observer, step);
         } else if (type == static_cast<int>(MessageType::ALIVE)) {
           // simple massage to enforce action
-          int flow_id = json::parse(data).at("flow_id");
-          int cwnd = json::parse(data).at("cwnd");
+          int flow_id = message.at("flow_id");
+          int cwnd = message.at("cwnd");
           sock.set_tcp_cwnd(cwnd);
           auto elapsed = clock_type::now() - ts_now;
           LOG(DEBUG) << "Client " << global_flow_id
@@ -191,33 +197,34 @@ void control_thread(DeepCCSocket& sock, IPC_ptr& ipc,
   polling_thread.join();
 }
 
-void data_thread(TCPSocket& sock) {
-  string data(BUFSIZ, 'a');
+void data_thread(TCPSocket& sock, const BulkSender::Mode send_mode) {
+  BulkSender sender(sock, send_mode);
   while (send_traffic.load()) {
-    sock.write(data, true);
+    sender.send();
   }
-  LOG(INFO) << "Data thread exits";
+  LOG(INFO) << "Data thread exits: " << sender.summary();
 }
 
 void usage_error(const string& program_name) {
   cerr << "Usage: " << program_name << " [OPTION]... [COMMAND]" << endl;
   cerr << endl;
   cerr << "Options = --ip=IP_ADDR --port=PORT --cong=ALGORITHM --ipc=IPC_FILE "
-          "--interval=INTERVAL (Milliseconds) --id=None"
+          "--interval=INTERVAL (Milliseconds) --id=None --send-mode=MODE"
        << endl;
   cerr << endl;
   cerr << "Default congestion control algorithms for incoming TCP is CUBIC; "
        << "Default control interval is 10ms; "
-       << "Default flow id is None" << endl;
+       << "Default flow id is None; "
+       << "send-mode is buffer (default), zerocopy, sendfile or splice"
+       << endl;
 
   throw runtime_error("invalid arguments");
 }
 
 int main(int argc, char** argv) {
-  /* register signal handler */
-  signal(SIGTERM, signal_handler);
-  signal(SIGKILL, signal_handler);
-  signal(SIGINT, signal_handler);
+  /* handle SIGINT and SIGTERM on a thread, where the handler may log; a
+     signal handler could interrupt the logger holding the lock it needs */
+  handle_signals_on_thread({SIGINT, SIGTERM}, signal_handler);
 
   if (argc < 1) {
     usage_error(argv[0]);
@@ -229,9 +236,11 @@ int main(int argc, char** argv) {
       {"cong", optional_argument, nullptr, 'c'},
       {"interval", optional_argument, nullptr, 't'},
       {"id", optional_argument, nullptr, 'f'},
+      {"send-mode", required_argument, nullptr, 's'},
       {0, 0, nullptr, 0}};
 
   string ip, service, cong_ctl, ipc_file, interval, id;
+  BulkSender::Mode send_mode = BulkSender::Mode::BUFFER;
   while (true) {
     const int opt = getopt_long(argc, argv, "", command_line_options, nullptr);
     if (opt == -1) { /* end of options */
@@ -253,6 +262,9 @@ int main(int argc, char** argv) {
     case 'p':
       service = optarg;
       break;
+    case 's':
+      send_mode = BulkSender::parse_mode(optarg);
+      break;
     case 't':
       interval = optarg;
       break;
@@ -320,7 +332,7 @@ int main(int argc, char** argv) {
                           control_interval));
     LOG(DEBUG) << "Client " << global_flow_id << " Started control thread ... ";
   }
-  thread dt(data_thread, std::ref(client));
+  thread dt(data_thread, std::ref(client), send_mode);
   LOG(INFO) << "Client " << global_flow_id << " is sending data ... ";
 
   /* wait for finish */
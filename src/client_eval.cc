@@ -5,7 +5,6 @@
 #include <atomic>
 #include <chrono>
 #include <deque>
-#include <fstream>
 #include <iostream>
 #include <mutex>
 #include <string>
@@ -15,23 +14,39 @@
 #include "address.hh"
 #include "child_process.hh"
 #include "common.hh"
+#include "control_sample.hh"
 #include "current_time.hh"
 #include "deepcc_socket.hh"
 #include "exception.hh"
 #include "filesystem.hh"
+#include "frame_codec.hh"
+#include "helper_pool.hh"
+#include "histogram.hh"
 #include "ipc_socket.hh"
 #include "json.hpp"
 #include "logging.hh"
+#include "observation_sampler.hh"
+#include "paced_state_provider.hh"
+#include "perf_log.hh"
 #include "pid.hh"
 #include "poller.hh"
+#include "send_buffer_sizer.hh"
 #include "serialization.hh"
+#include "signalfd.hh"
 #include "socket.hh"
 #include "system_runner.hh"
 #include "tcp_info.hh"
+#include "tcp_state_provider.hh"
+#include "timestamp.hh"
+#include "trace.hh"
+#ifdef INPROCESS_INFERENCE
+#include "context.hh"
+#include "tf_inference.hh"
+#endif
 
 using namespace std;
 using namespace std::literals;
-using clock_type = std::chrono::high_resolution_clock;
+using clock_type = SteadyClock;
 using namespace PollerShortNames;
 typedef DeepCCSocket::TCPInfoRequestType RequestType;
 
@@ -44,8 +59,24 @@ std::atomic<bool> send_traffic(true);
 int global_flow_id = -1;
 std::unique_ptr<ChildProcess> astraea_pyhelper = nullptr;
 std::unique_ptr<IPCSocket> ipc = nullptr;
-std::chrono::_V2::system_clock::time_point ts_now = clock_type::now();
-std::unique_ptr<std::ofstream> perf_log;
+/* replies from the inference side */
+std::unique_ptr<FrameReader> ipc_frames = nullptr;
+clock_type::time_point ts_now = clock_type::now();
+/* when the flow asked for its Python helper, for time-to-first-action */
+clock_type::time_point helper_requested{};
+std::unique_ptr<PerfLog> perf_log;
+/* set with --buffer-headroom */
+std::unique_ptr<SendBufferSizer> buffer_sizer;
+/* id of the next control step, used by --trace */
+uint64_t control_step = 0;
+/* from sampling the socket to setting the cwnd, for every control step */
+Histogram step_latency_us;
+/* the signal thread reports step_latency_us while the control thread adds */
+std::mutex step_latency_mutex;
+#ifdef INPROCESS_INFERENCE
+/* set when the model runs in this process instead of a Python helper */
+std::unique_ptr<FlowContext> flow_context = nullptr;
+#endif
 
 /* define message type */
 enum class MessageType { INIT = 0, START = 1, END = 2, ALIVE = 3, OBSERVE = 4 };
@@ -73,15 +104,31 @@ void ipc_send_message(IPC_ptr& ipc_sock, const MessageType& type,
     message["type"] = to_underlying(type);
   }
 
-  uint16_t len = message.dump().length();
+  const std::string payload = message.dump();
   if (ipc_sock) {
-    ipc_sock->write(put_field(len) + message.dump());
+    ipc_sock->writev({put_field(payload.size()), payload});
   }
 }
 
+void report_step_latency(void) {
+  std::lock_guard<std::mutex> lock(step_latency_mutex);
+  if (step_latency_us.count() == 0) {
+    return;
+  }
+  const char* mode = "pyhelper";
+#ifdef INPROCESS_INFERENCE
+  if (flow_context) {
+    mode = "inprocess";
+  }
+#endif
+  LOG(INFO) << "Client " << global_flow_id << " control step latency (us, "
+            << mode << "): " << step_latency_us.summary();
+}
+
 void signal_handler(int sig) {
   if (sig == SIGINT or sig == SIGKILL or sig == SIGTERM) {
     LOG(INFO) << "Caught signal, Client " << global_flow_id << " exiting...";
+    report_step_latency();
     // first disable read from fd
     // disable write to IPC
     send_traffic = false;
@@ -99,66 +146,141 @@ void signal_handler(int sig) {
   }
 }
 
-void do_congestion_control(DeepCCSocket& sock, IPC_ptr& ipc_sock) {
-  auto state = sock.get_tcp_deepcc_info_json(RequestType::REQUEST_ACTION);
-  LOG(TRACE) << "Client " << global_flow_id << " send state: " << state.dump();
+/* send the state to the Python helper and wait for its cwnd */
+int helper_action(IPC_ptr& ipc_sock, const json& state) {
   ipc_send_message(ipc_sock, MessageType::ALIVE, state);
+  const auto reply = ipc_frames->next();
+  if (not reply) {
+    throw runtime_error("IPC closed by the Python helper");
+  }
+  return json::parse(reply->begin(), reply->end()).at("cwnd");
+}
+
+#ifdef INPROCESS_INFERENCE
+/* run the model on this thread, as the inference service would */
+int inprocess_action(const ControlSample& sample) {
+  const float action =
+      TFInference::Get()->inference_sync(flow_context->format_state(sample));
+  return map_action(action, sample.info.cwnd);
+}
+#endif
+
+void do_congestion_control(DeepCCSocket& sock, IPC_ptr& ipc_sock) {
+  const uint64_t step = control_step++;
+  const auto step_start = clock_type::now();
+  TRACE_STEP(ClientSample, global_flow_id, step);
+  const auto sample = sock.get_control_sample(RequestType::REQUEST_ACTION);
+  LOG(TRACE) << "Client " << global_flow_id
+             << " send state: " << sample.to_json().dump();
+  TRACE_STEP(ClientSend, global_flow_id, step);
   // set timestamp
   ts_now = clock_type::now();
   // wait for action
-  auto header = ipc->read_exactly(2);
-  auto data_len = get_uint16(header.data());
-  auto data = ipc->read_exactly(data_len);
-  int cwnd = json::parse(data).at("cwnd");
+#ifdef INPROCESS_INFERENCE
+  const int cwnd = flow_context ? inprocess_action(sample)
+                                : helper_action(ipc_sock, sample.to_json());
+#else
+  const int cwnd = helper_action(ipc_sock, sample.to_json());
+#endif
   sock.set_tcp_cwnd(cwnd);
+  if (buffer_sizer) {
+    buffer_sizer->update(sample, cwnd);
+  }
+  TRACE_STEP(ClientSetCwnd, global_flow_id, step);
+  {
+    std::lock_guard<std::mutex> lock(step_latency_mutex);
+    step_latency_us.add(std::chrono::duration_cast<std::chrono::microseconds>(
+                            clock_type::now() - step_start)
+                            .count());
+  }
+  if (step == 0) {
+    LOG(INFO) << "Client " << global_flow_id << " time to first action: "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(
+                     clock_type::now() - helper_requested)
+                     .count()
+              << "ms";
+  }
   auto elapsed = clock_type::now() - ts_now;
   LOG(DEBUG)
       << "Client GET cwnd: " << cwnd << ", elapsed time is "
       << std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()
       << "us";
   if (perf_log) {
-    unsigned int srtt = state["srtt_us"];
-    // change srtt to us
-    srtt = srtt >> 3;
-    *perf_log << state["min_rtt"] << "\t" << state["avg_urtt"] << "\t"
-              << state["cnt"] << "\t" << srtt << "\t" << state["avg_thr"]
-              << "\t" << state["thr_cnt"] << "\t" << state["pacing_rate"]
-              << "\t" << state["loss_bytes"] << "\t" << state["packets_out"]
-              << "\t" << state["retrans_out"] << "\t"
-              << state["max_packets_out"] << "\t" << state["cwnd"] << "\t"
-              << cwnd << endl;
+    sample.append_to(*perf_log, cwnd);
   }
 }
 
 void do_monitor(DeepCCSocket& sock) {
-  while(send_traffic.load()) {
-    auto state = sock.get_tcp_deepcc_info_json(RequestType::REQUEST_ACTION);
-    if (perf_log) {
-      unsigned int srtt = state["srtt_us"];
-      // change srtt to us
-      srtt = srtt >> 3;
-      *perf_log << state["min_rtt"] << "\t" << state["avg_urtt"] << "\t"
-                << state["cnt"] << "\t" << srtt << "\t" << state["avg_thr"]
-                << "\t" << state["thr_cnt"] << "\t" << state["pacing_rate"]
-                << "\t" << state["loss_bytes"] << "\t" << state["packets_out"]
-                << "\t" << state["retrans_out"] << "\t"
-                << state["max_packets_out"] << "\t" << state["cwnd"] << "\t"
-                << 0 << endl;
-    }
-    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+  // the watching sampler's steps, read without the socket's lock
+  static StateSnapshot previous{};
+  const StateSnapshot snapshot = sock.snapshot();
+  if (snapshot.samples == previous.samples) {
+    return;
+  }
+  const auto sample = sock.control_sample(snapshot, previous);
+  previous = snapshot;
+  if (perf_log) {
+    sample.append_to(*perf_log, 0);
+  }
+  if (buffer_sizer) {
+    buffer_sizer->update(sample, sample.info.cwnd);
   }
 }
 
-void control_thread(DeepCCSocket& sock, IPC_ptr& ipc,
-                    const std::chrono::milliseconds interval) {
-  // start regular congestion control parttern
-  auto when_started = clock_type::now();
-  auto target_time = when_started + interval;
-  while (send_traffic.load()) {
-    do_congestion_control(sock, ipc);
-    std::this_thread::sleep_until(target_time);
-    target_time += interval;
+void control_thread(DeepCCSocket& sock, IPC_ptr& ipc, const bool use_RL,
+                    const std::chrono::milliseconds interval,
+                    const std::chrono::microseconds observe_interval) {
+  // control and monitor ticks share the timers of one poller
+  Poller poller;
+  // replayed and synthetic states go by time_scale times faster
+  const auto period_us = [&sock](const std::chrono::microseconds period) {
+    return std::max(
+        uint64_t(period.count() / sock.state_provider().time_scale()),
+        uint64_t(1));
+  };
+  std::unique_ptr<ObservationSampler> sampler;
+  if (use_RL) {
+    // start regular congestion control parttern
+    poller.add_periodic_timer(
+        period_us(interval), [&]() { do_congestion_control(sock, ipc); }, 0);
+    // observations in between, merged into the next control step
+    if (observe_interval.count() > 0) {
+      sampler = std::make_unique<ObservationSampler>(
+          sock, period_us(observe_interval));
+    }
+  } else {
+    // the sampler takes the steps; the monitor reads each one half a period
+    // after it was published
+    sampler = std::make_unique<ObservationSampler>(
+        sock, period_us(30ms), ObservationSampler::Mode::Watch);
+    poller.add_periodic_timer(period_us(30ms), [&]() { do_monitor(sock); },
+                              period_us(15ms));
+  }
+  while (send_traffic.load() and not sock.state_provider().finished()) {
+    if (poller.poll(-1).result == Poller::Result::Type::Exit) {
+      break;
+    }
   }
+  // out of states: stop the data thread too
+  send_traffic = false;
+  if (sampler) {
+    LOG(DEBUG) << "Client " << global_flow_id << " took "
+               << sampler->samples() << " observations, "
+               << sock.observations_dropped() << " dropped";
+    sampler.reset();
+  }
+  report_step_latency();
+  if (buffer_sizer) {
+    LOG(DEBUG) << "Client " << global_flow_id << " send buffer "
+               << buffer_sizer->send_buffer() << " bytes, not-sent low-water "
+               << buffer_sizer->notsent_lowat() << " bytes, "
+               << buffer_sizer->resizes() << " resizes";
+  }
+  auto stats = poller.timer_stats();
+  LOG(DEBUG) << "Client " << global_flow_id << " timers fired " << stats.fired
+             << " times, mean lateness "
+             << stats.total_lateness_us / std::max(stats.fired, uint64_t(1))
+             << "us, max lateness " << stats.max_lateness_us << "us";
 }
 
 void data_thread(TCPSocket& sock) {
@@ -174,7 +296,11 @@ void usage_error(const string& program_name) {
   cerr << endl;
   cerr << "Options = --ip=IP_ADDR --port=PORT --cong=ALGORITHM"
           "--interval=INTERVAL (Milliseconds) --pyhelper=PYTHON_PATH "
-          "--model=MODEL_PATH --id=None --perf-log=None"
+          "--model=MODEL_PATH --id=None --perf-log=None --trace=None "
+          "--helper-pool=None --graph=None --checkpoint=None "
+          "--tcp-state=deepcc --time-scale=1 --actions-log=None "
+          "--observe-us=0 --max-tput-window=0 --buffer-headroom=0 "
+          "--actuation=cwnd"
        << endl;
   cerr << endl;
   cerr << "Default congestion control algorithms for incoming TCP is CUBIC; "
@@ -183,17 +309,40 @@ void usage_error(const string& program_name) {
        << "Default flow id is None; " << endl
        << "pyhelper specifies the path of Python-inference script; " << endl
        << "model-path specifies the pre-trained model, and will be passed to "
-          "python inference module"
+          "python inference module; " << endl
+       << "helper-pool takes a ready helper from the helper_pool listening "
+          "there instead of starting one; " << endl
+       << "graph and checkpoint load the model into this process and run it "
+          "on the control thread, with no helper (needs "
+          "COMPILE_INFERENCE_SERVICE); "
+       << endl
+       << "tcp-state is deepcc (the patched kernel), tcp_info (any kernel), "
+          "replay:PERF_LOG or synthetic[:MBPS[:RTT_MS[:SECONDS]]] (no kernel); "
+       << endl
+       << "time-scale runs replay and synthetic states that many times "
+          "faster, and actions-log records the windows set on them; "
+       << endl
+       << "observe-us samples the TCP state that often (microseconds) between "
+          "control steps and merges the samples into the next step; "
+       << endl
+       << "max-tput-window takes max_tput over that many milliseconds "
+          "instead of the whole flow; "
+       << endl
+       << "buffer-headroom sizes the send buffer to that many times the "
+          "bytes in flight, and the unsent bytes to one less BDP (0: the "
+          "kernel's sizes); "
+       << endl
+       << "actuation is cwnd (the window alone) or pacing (also a pacing rate "
+          "of the window per min_rtt, with deepcc or tcp_info states)"
        << endl;
 
   throw runtime_error("invalid arguments");
 }
 
 int main(int argc, char** argv) {
-  /* register signal handler */
-  signal(SIGTERM, signal_handler);
-  signal(SIGKILL, signal_handler);
-  signal(SIGINT, signal_handler);
+  /* handle SIGINT and SIGTERM on a thread, where closing the perf log may
+     wait on its writer; a signal handler could interrupt the lock it needs */
+  handle_signals_on_thread({SIGINT, SIGTERM}, signal_handler);
   /* ignore SIGPIPE generated by Socket write */
   if (signal(SIGPIPE, SIG_IGN) == SIG_ERR) {
     throw runtime_error("signal: failed to ignore SIGPIPE");
@@ -211,11 +360,36 @@ int main(int argc, char** argv) {
       {"interval", optional_argument, nullptr, 't'},
       {"id", optional_argument, nullptr, 'f'},
       {"perf-log", optional_argument, nullptr, 'l'},
+      {"trace", required_argument, nullptr, 'r'},
+      {"helper-pool", required_argument, nullptr, 'o'},
+      {"graph", required_argument, nullptr, 'g'},
+      {"checkpoint", required_argument, nullptr, 'k'},
+      {"tcp-state", required_argument, nullptr, 'e'},
+      {"time-scale", required_argument, nullptr, 'x'},
+      {"actions-log", required_argument, nullptr, 'j'},
+      {"observe-us", required_argument, nullptr, 'u'},
+      {"max-tput-window", required_argument, nullptr, 'w'},
+      {"buffer-headroom", required_argument, nullptr, 'b'},
+      {"actuation", required_argument, nullptr, 'n'},
       {0, 0, nullptr, 0}};
 
   /* use RL inference or not */
   bool use_RL = false;
-  string ip, service, pyhelper, model, cong_ctl, interval, id, perf_log_path;
+  string ip, service, pyhelper, model, cong_ctl, interval, id, perf_log_path,
+      trace_path, helper_pool, graph, checkpoint;
+  /* patched kernel, or TCP_INFO on any kernel */
+  string tcp_state = "deepcc";
+  /* for replay and synthetic states only */
+  double time_scale = 1;
+  string actions_log;
+  /* intermediate observations between control steps, 0 for none */
+  uint64_t observe_us = 0;
+  /* max_tput over the whole flow unless given, in ms */
+  uint64_t max_tput_window = 0;
+  /* size the send buffer to the BDP unless 0 */
+  double buffer_headroom = 0;
+  /* the window alone, or paced as well */
+  string actuation = "cwnd";
   while (true) {
     const int opt = getopt_long(argc, argv, "", command_line_options, nullptr);
     if (opt == -1) { /* end of options */
@@ -228,24 +402,57 @@ int main(int argc, char** argv) {
     case 'c':
       cong_ctl = optarg;
       break;
+    case 'e':
+      tcp_state = optarg;
+      break;
     case 'f':
       id = optarg;
       break;
+    case 'g':
+      graph = optarg;
+      break;
     case 'h':
       pyhelper = optarg;
       break;
+    case 'k':
+      checkpoint = optarg;
+      break;
     case 'l':
       perf_log_path = optarg;
       break;
     case 'm':
       model = optarg;
       break;
+    case 'o':
+      helper_pool = optarg;
+      break;
     case 'p':
       service = optarg;
       break;
+    case 'r':
+      trace_path = optarg;
+      break;
     case 't':
       interval = optarg;
       break;
+    case 'x':
+      time_scale = stod(optarg);
+      break;
+    case 'j':
+      actions_log = optarg;
+      break;
+    case 'u':
+      observe_us = stoull(optarg);
+      break;
+    case 'w':
+      max_tput_window = stoull(optarg);
+      break;
+    case 'b':
+      buffer_headroom = stod(optarg);
+      break;
+    case 'n':
+      actuation = optarg;
+      break;
     case '?':
       usage_error(argv[0]);
       break;
@@ -259,6 +466,14 @@ int main(int argc, char** argv) {
     usage_error(argv[0]);
   }
 
+  if (not trace_path.empty()) {
+#ifndef ENABLE_TRACE
+    LOG(WARNING) << "Built without ENABLE_TRACE, " << trace_path
+                 << " will hold no control steps";
+#endif
+    trace::enable(trace_path);
+  }
+
   /* assign flow_id */
   if (not id.empty()) {
     global_flow_id = stoi(id);
@@ -266,40 +481,73 @@ int main(int argc, char** argv) {
   }
 
   std::chrono::milliseconds control_interval(20ms);
-  if (cong_ctl == "astraea" and not(pyhelper.empty() or model.empty())) {
-    // first check pyhelper and model
-    if (not fs::exists(pyhelper)) {
-      throw runtime_error("Pyhelper does not exist");
+  if (cong_ctl == "astraea" and not graph.empty()) {
+#ifdef INPROCESS_INFERENCE
+    if (not fs::exists(graph)) {
+      throw runtime_error("Model graph does not exist");
     }
-    if (not fs::exists(model)) {
-      throw runtime_error("Trained model does not exist");
+    helper_requested = clock_type::now();
+    graphPath = graph;
+    checkpointPath = checkpoint;
+    /* loads the model once for the whole process */
+    TFInference::Get();
+    flow_context = make_unique<FlowContext>(global_flow_id);
+    if (not interval.empty()) {
+      control_interval = std::move(std::chrono::milliseconds(stoi(interval)));
+    }
+    LOG(INFO) << "Client " << global_flow_id
+              << " runs the model in process, control interval is "
+              << control_interval.count() << "ms";
+    use_RL = true;
+#else
+    throw runtime_error(
+        "--graph needs client_eval built with COMPILE_INFERENCE_SERVICE");
+#endif
+  } else if (cong_ctl == "astraea" and
+             not(helper_pool.empty() and (pyhelper.empty() or model.empty()))) {
+    helper_requested = clock_type::now();
+    if (not helper_pool.empty()) {
+      /* the pool's helpers have loaded their model already */
+      ipc = make_unique<IPCSocket>(HelperPool::checkout(helper_pool));
+      LOG(INFO) << "Client: got a Python helper from the pool at "
+                << helper_pool;
+    } else {
+      // first check pyhelper and model
+      if (not fs::exists(pyhelper)) {
+        throw runtime_error("Pyhelper does not exist");
+      }
+      if (not fs::exists(model)) {
+        throw runtime_error("Trained model does not exist");
+      }
+      /* IPC and control interval */
+      string ipc_dir = "astraea_ipc";
+      // return true if created or dir exists
+      fs::create_directory(ipc_dir);
+      string ipc_file = fs::path(ipc_dir) / ("astraea" + to_string(pid()));
+      IPCSocket ipcsock;
+      ipcsock.set_reuseaddr();
+      ipcsock.bind(ipc_file);
+      ipcsock.listen();
+
+      fs::path ipc_path = fs::current_path() / ipc_file;
+
+      LOG(INFO) << "Client: IPC listen at " << ipc_path;
+
+      // start child process of Python helper for inference
+      vector<string> prog_args{pyhelper, "--ipc-path", ipc_path,
+                               "--model-path", model};
+      astraea_pyhelper = std::make_unique<ChildProcess>(
+          pyhelper,
+          [&pyhelper, &prog_args]() { return ezexec(pyhelper, prog_args); });
+
+      LOG(INFO) << "Client: started subprocess of Python helper";
+      ipc = make_unique<IPCSocket>(ipcsock.accept());
     }
-    /* IPC and control interval */
-    string ipc_dir = "astraea_ipc";
-    // return true if created or dir exists
-    fs::create_directory(ipc_dir);
-    string ipc_file = fs::path(ipc_dir) / ("astraea" + to_string(pid()));
-    IPCSocket ipcsock;
-    ipcsock.set_reuseaddr();
-    ipcsock.bind(ipc_file);
-    ipcsock.listen();
-
-    fs::path ipc_path = fs::current_path() / ipc_file;
-
-    LOG(INFO) << "Client: IPC listen at " << ipc_path;
-
-    // start child process of Python helper for inference
-    vector<string> prog_args{pyhelper, "--ipc-path", ipc_path, "--model-path",
-                             model};
-    astraea_pyhelper = std::make_unique<ChildProcess>(
-        pyhelper,
-        [&pyhelper, &prog_args]() { return ezexec(pyhelper, prog_args); });
 
     if (not interval.empty()) {
       control_interval = std::move(std::chrono::milliseconds(stoi(interval)));
     }
-    LOG(INFO) << "Client: started subprocess of Python helper";
-    ipc = make_unique<IPCSocket>(ipcsock.accept());
+    ipc_frames = make_unique<FrameReader>(*ipc);
     LOG(INFO) << "Client " << global_flow_id
               << " IPC with env has been established, control interval is "
               << control_interval.count() << "ms";
@@ -321,6 +569,13 @@ int main(int argc, char** argv) {
   Address address(ip, port);
   /* set reuse_addr */
   DeepCCSocket client;
+  client.set_state_provider(PacedStateProvider::with_actuation(
+      actuation, TCPStateProvider::make(tcp_state, time_scale, actions_log)));
+  client.set_max_tput_window(max_tput_window * 1000);
+  if (observe_us > 0 and client.state_provider().name() == "replay") {
+    /* a replayed state stands for a whole control step */
+    throw runtime_error("--observe-us needs states that are not replayed");
+  }
   client.set_reuseaddr();
   client.connect(address);
 
@@ -336,35 +591,24 @@ int main(int argc, char** argv) {
 
   /* setup performance log */
   if (not perf_log_path.empty()) {
-    perf_log.reset(new std::ofstream(perf_log_path));
-    if (not perf_log->good()) {
-      throw runtime_error(perf_log_path + ": error opening for writing");
-    }
-    // write header
-    *perf_log << "min_rtt\t"
-              << "avg_urtt\t"
-              << "cnt\t"
-              << "srtt_us\t"
-              << "avg_thr\t"
-              << "thr_cnt\t"
-              << "pacing_rate\t"
-              << "loss_bytes\t"
-              << "packets_out\t"
-              << "retrans_out\t"
-              << "max_packets_out\t"
-              << "CWND in Kernel\t"
-              << "CWND to Assign" << endl;
+    perf_log = std::make_unique<PerfLog>(perf_log_path,
+                                         ControlSample::perf_log_columns());
+  }
+  if (buffer_headroom > 0) {
+    buffer_sizer = std::make_unique<SendBufferSizer>(client, buffer_headroom);
   }
   /* start data thread and control thread */
   thread ct;
-  if (use_RL and ipc != nullptr) {
+  if (use_RL) {
     ct = std::move(thread(control_thread, std::ref(client), std::ref(ipc),
-                          control_interval));
+                          true, control_interval,
+                          std::chrono::microseconds(observe_us)));
     LOG(DEBUG) << "Client " << global_flow_id << " Started control thread ... ";
-  } else if (cong_ctl != "astraea" and perf_log != nullptr) {
+  } else if (cong_ctl != "astraea" and (perf_log or buffer_sizer)) {
     // launch control threads
     LOG(INFO) << "Launch monitor thread for " << cong_ctl << " ...";
-    ct = thread(do_monitor, std::ref(client));
+    ct = thread(control_thread, std::ref(client), std::ref(ipc), false,
+                control_interval, std::chrono::microseconds(0));
   }
   thread dt(data_thread, std::ref(client));
   LOG(INFO) << "Client " << global_flow_id << " is sending data ... ";
@@ -15,23 +15,30 @@
 #include "address.hh"
 #include "child_process.hh"
 #include "common.hh"
+#include "control_sample.hh"
 #include "current_time.hh"
 #include "deepcc_socket.hh"
 #include "exception.hh"
 #include "filesystem.hh"
+#include "frame_codec.hh"
+#include "histogram.hh"
 #include "ipc_socket.hh"
 #include "json.hpp"
 #include "logging.hh"
 #include "pid.hh"
 #include "poller.hh"
 #include "serialization.hh"
+#include "signalfd.hh"
 #include "socket.hh"
 #include "system_runner.hh"
 #include "tcp_info.hh"
+#include "tcp_state_provider.hh"
+#include "timestamp.hh"
+#include "trace.hh"
 
 using namespace std;
 using namespace std::literals;
-using clock_type = std::chrono::high_resolution_clock;
+using clock_type = SteadyClock;
 using namespace PollerShortNames;
 typedef DeepCCSocket::TCPInfoRequestType RequestType;
 
@@ -42,10 +49,18 @@ using json = nlohmann::json;
 std::atomic<bool> send_traffic(true);
 int global_flow_id = 0;
 std::unique_ptr<IPCSocket> inference_server = nullptr;
+/* replies from the inference server */
+std::unique_ptr<FrameReader> inference_frames = nullptr;
 
 Address inference_server_addr;
-std::chrono::_V2::system_clock::time_point ts_now = clock_type::now();
+clock_type::time_point ts_now = clock_type::now();
 std::unique_ptr<std::ofstream> perf_log;
+/* id of the next control step, used by --trace */
+uint64_t control_step = 0;
+/* from sampling the socket to setting the cwnd, for every control step */
+Histogram step_latency_us;
+/* the signal thread reports step_latency_us while the control thread adds */
+std::mutex step_latency_mutex;
 
 /* define message type */
 enum class MessageType { INIT = 0, START = 1, END = 2, ALIVE = 3, OBSERVE = 4 };
@@ -60,7 +75,8 @@ const char* ALG = "Astraea";
 
 void unix_send_message(std::unique_ptr<IPCSocket>& ipc_sock,
                        const MessageType& type, const json& state,
-                       const int observer_id = -1, const int step = -1) {
+                       const int observer_id = -1, const int step = -1,
+                       const int64_t seq = -1) {
   json message;
   if (!state.empty()) {
     message["state"] = state;
@@ -75,23 +91,39 @@ void unix_send_message(std::unique_ptr<IPCSocket>& ipc_sock,
     // we just need to copy the type
     message["type"] = to_underlying(type);
   }
+  if (seq >= 0) {
+    // echoed back by the inference service to match the reply
+    message["seq"] = seq;
+  }
 
-  uint16_t len = message.dump().length();
+  const std::string payload = message.dump();
   if (ipc_sock) {
-    ipc_sock->write(put_field(len) + message.dump());
+    ipc_sock->writev({put_field(payload.size()), payload});
   }
 }
 
-std::string unix_recv_message(std::unique_ptr<IPCSocket>& ipc) {
-  auto header = ipc->read_exactly(2);
-  auto data_len = get_uint16(header.data());
-  auto data = ipc->read_exactly(data_len);
-  return data;
+/* payload of the next message; valid until the next call */
+std::string_view unix_recv_message(FrameReader& frames) {
+  const auto data = frames.next();
+  if (not data) {
+    throw runtime_error("IPC closed by the inference server");
+  }
+  return *data;
+}
+
+void report_step_latency(void) {
+  std::lock_guard<std::mutex> lock(step_latency_mutex);
+  if (step_latency_us.count() > 0) {
+    LOG(INFO) << "Client " << global_flow_id
+              << " control step latency (us, unix): "
+              << step_latency_us.summary();
+  }
 }
 
 void signal_handler(int sig) {
   if (sig == SIGINT or sig == SIGKILL or sig == SIGTERM) {
     LOG(INFO) << "Caught signal, Client " << global_flow_id << " exiting...";
+    report_step_latency();
     // first disable read from fd
     // disable write to IPC
     send_traffic = false;
@@ -110,22 +142,35 @@ void signal_handler(int sig) {
 
 void do_congestion_control(DeepCCSocket& sock,
                            std::unique_ptr<IPCSocket>& ipc_sock) {
-  auto state = sock.get_tcp_deepcc_info_json(RequestType::REQUEST_ACTION);
+  const uint64_t step = control_step++;
+  const auto step_start = clock_type::now();
+  TRACE_STEP(ClientSample, global_flow_id, step);
+  const auto sample = sock.get_control_sample(RequestType::REQUEST_ACTION);
+  const json state = sample.to_json();
   LOG(TRACE) << "Client " << global_flow_id << " send state: " << state.dump();
-  unix_send_message(ipc_sock, MessageType::ALIVE, state);
+  TRACE_STEP(ClientSend, global_flow_id, step);
+  unix_send_message(ipc_sock, MessageType::ALIVE, state, -1, -1,
+                    trace::enabled() ? int64_t(step) : -1);
   // set timestamp
   ts_now = clock_type::now();
   // wait for action
-  auto data = unix_recv_message(ipc_sock);
+  auto data = unix_recv_message(*inference_frames);
   int cwnd = 0;
   try {
-    cwnd = json::parse(data).at("cwnd");
+    cwnd = json::parse(data.begin(), data.end()).at("cwnd");
   } catch (const std::exception& e) {
     LOG(WARNING) << "Client " << global_flow_id
                  << " failed to parse action: " << data;
     return;
   }
   sock.set_tcp_cwnd(cwnd);
+  TRACE_STEP(ClientSetCwnd, global_flow_id, step);
+  {
+    std::lock_guard<std::mutex> lock(step_latency_mutex);
+    step_latency_us.add(std::chrono::duration_cast<std::chrono::microseconds>(
+                            clock_type::now() - step_start)
+                            .count());
+  }
   auto elapsed = clock_type::now() - ts_now;
   LOG(DEBUG)
       << "Client " << global_flow_id << " GET cwnd: " << cwnd
@@ -133,29 +178,26 @@ void do_congestion_control(DeepCCSocket& sock,
       << std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()
       << "us";
   if (perf_log) {
-    unsigned int srtt = state["srtt_us"];
-    // change srtt to us
-    srtt = srtt >> 3;
-    *perf_log << state["min_rtt"] << "\t" << state["avg_urtt"] << "\t"
-              << state["cnt"] << "\t" << srtt << "\t" << state["avg_thr"]
-              << "\t" << state["thr_cnt"] << "\t" << state["pacing_rate"]
-              << "\t" << state["loss_bytes"] << "\t" << state["packets_out"]
-              << "\t" << state["retrans_out"] << "\t"
-              << state["max_packets_out"] << "\t" << state["cwnd"] << "\t"
-              << cwnd << endl;
+    sample.write_tsv(*perf_log, cwnd);
   }
 }
 
 void control_thread(DeepCCSocket& sock, std::unique_ptr<IPCSocket>& ipc,
                     const std::chrono::milliseconds interval) {
+  // replayed and synthetic states go by time_scale times faster
+  const auto period = std::chrono::duration_cast<clock_type::duration>(
+      interval / sock.state_provider().time_scale());
   // start regular congestion control parttern
   auto when_started = clock_type::now();
-  auto target_time = when_started + interval;
-  while (send_traffic.load()) {
+  auto target_time = when_started + period;
+  while (send_traffic.load() and not sock.state_provider().finished()) {
     do_congestion_control(sock, ipc);
     std::this_thread::sleep_until(target_time);
-    target_time += interval;
+    target_time += period;
   }
+  // out of states: stop the data thread too
+  send_traffic = false;
+  report_step_latency();
 }
 
 void data_thread(TCPSocket& sock) {
@@ -170,22 +212,32 @@ void usage_error(const string& program_name) {
   cerr << "Usage: " << program_name << " [OPTION]... [COMMAND]" << endl;
   cerr << endl;
   cerr << "Options = --ip=IP_ADDR --port=PORT --cong=ALGORITHM"
-          "--interval=INTERVAL (Milliseconds) --id=None --perf-log=None"
+          "--interval=INTERVAL (Milliseconds) --id=None --perf-log=None "
+          "--trace=None --tcp-state=deepcc "
+          "--time-scale=1 --actions-log=None --max-tput-window=0"
        << endl;
   cerr << endl;
   cerr << "Default congestion control algorithms for incoming TCP is CUBIC; "
        << endl
        << "Default control interval is 10ms; " << endl
-       << "Default flow id is None; " << endl;
+       << "Default flow id is None; " << endl
+       << "tcp-state is deepcc (the patched kernel), tcp_info (any kernel), "
+          "replay:PERF_LOG or synthetic[:MBPS[:RTT_MS[:SECONDS]]] (no kernel); "
+       << endl
+       << "time-scale runs replay and synthetic states that many times "
+          "faster, and actions-log records the windows set on them; "
+       << endl
+       << "max-tput-window takes max_tput over that many milliseconds "
+          "instead of the whole flow"
+       << endl;
 
   throw runtime_error("invalid arguments");
 }
 
 int main(int argc, char** argv) {
-  /* register signal handler */
-  signal(SIGTERM, signal_handler);
-  signal(SIGKILL, signal_handler);
-  signal(SIGINT, signal_handler);
+  /* handle SIGINT and SIGTERM on a thread, where the handler may log; a
+     signal handler could interrupt the logger holding the lock it needs */
+  handle_signals_on_thread({SIGINT, SIGTERM}, signal_handler);
   /* ignore SIGPIPE generated by Socket write */
   if (signal(SIGPIPE, SIG_IGN) == SIG_ERR) {
     throw runtime_error("signal: failed to ignore SIGPIPE");
@@ -201,11 +253,24 @@ int main(int argc, char** argv) {
       {"interval", optional_argument, nullptr, 't'},
       {"id", optional_argument, nullptr, 'f'},
       {"perf-log", optional_argument, nullptr, 'l'},
+      {"trace", required_argument, nullptr, 'r'},
+      {"tcp-state", required_argument, nullptr, 'e'},
+      {"time-scale", required_argument, nullptr, 'x'},
+      {"actions-log", required_argument, nullptr, 'j'},
+      {"max-tput-window", required_argument, nullptr, 'w'},
       {0, 0, nullptr, 0}};
 
   /* use RL inference or not */
   bool use_RL = false;
-  string ip, service, pyhelper, model, cong_ctl, interval, id, perf_log_path;
+  string ip, service, pyhelper, model, cong_ctl, interval, id, perf_log_path,
+      trace_path;
+  /* patched kernel, or TCP_INFO on any kernel */
+  string tcp_state = "deepcc";
+  /* for replay and synthetic states only */
+  double time_scale = 1;
+  string actions_log;
+  /* max_tput over the whole flow unless given, in ms */
+  uint64_t max_tput_window = 0;
   while (true) {
     const int opt = getopt_long(argc, argv, "", command_line_options, nullptr);
     if (opt == -1) { /* end of options */
@@ -218,6 +283,9 @@ int main(int argc, char** argv) {
     case 'c':
       cong_ctl = optarg;
       break;
+    case 'e':
+      tcp_state = optarg;
+      break;
     case 'f':
       id = optarg;
       break;
@@ -227,9 +295,21 @@ int main(int argc, char** argv) {
     case 'p':
       service = optarg;
       break;
+    case 'r':
+      trace_path = optarg;
+      break;
     case 't':
       interval = optarg;
       break;
+    case 'x':
+      time_scale = stod(optarg);
+      break;
+    case 'j':
+      actions_log = optarg;
+      break;
+    case 'w':
+      max_tput_window = stoull(optarg);
+      break;
     case '?':
       usage_error(argv[0]);
       break;
@@ -243,6 +323,14 @@ int main(int argc, char** argv) {
     usage_error(argv[0]);
   }
 
+  if (not trace_path.empty()) {
+#ifndef ENABLE_TRACE
+    LOG(WARNING) << "Built without ENABLE_TRACE, " << trace_path
+                 << " will hold no control steps";
+#endif
+    trace::enable(trace_path);
+  }
+
   /* assign flow_id */
   if (not id.empty()) {
     global_flow_id = stoi(id);
@@ -260,12 +348,13 @@ int main(int argc, char** argv) {
     }
     inference_server = make_unique<IPCSocket>(std::move(ipcsock));
     inference_server->connect("/tmp/astraea.sock");
+    inference_frames = make_unique<FrameReader>(*inference_server);
     // send initial message
     json init_message;
     unix_send_message(inference_server, MessageType::START, init_message);
     LOG(INFO) << "Sent init message to inference server ...";
-    auto data = unix_recv_message(inference_server);
-    json reply = json::parse(data);
+    auto data = unix_recv_message(*inference_frames);
+    json reply = json::parse(data.begin(), data.end());
     global_flow_id = reply["flow_id"];
     LOG(INFO) << "Client " << global_flow_id
               << " IPC with env has been established, control interval is "
@@ -285,6 +374,9 @@ int main(int argc, char** argv) {
   Address address(ip, port);
   /* set reuse_addr */
   DeepCCSocket client;
+  client.set_state_provider(
+      TCPStateProvider::make(tcp_state, time_scale, actions_log));
+  client.set_max_tput_window(max_tput_window * 1000);
   client.set_reuseaddr();
   client.connect(address);
 
@@ -305,19 +397,7 @@ int main(int argc, char** argv) {
       throw runtime_error(perf_log_path + ": error opening for writing");
     }
     // write header
-    *perf_log << "min_rtt\t"
-              << "avg_urtt\t"
-              << "cnt\t"
-              << "srtt_us\t"
-              << "avg_thr\t"
-              << "thr_cnt\t"
-              << "pacing_rate\t"
-              << "loss_bytes\t"
-              << "packets_out\t"
-              << "retrans_out\t"
-              << "max_packets_out\t"
-              << "CWND in Kernel\t"
-              << "CWND to Assign" << endl;
+    *perf_log << ControlSample::perf_log_header() << endl;
   }
   /* start data thread and control thread */
   thread ct;
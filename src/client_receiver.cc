@@ -11,17 +11,18 @@
 #include <thread>
 
 #include "address.hh"
+#include "bulk_receiver.hh"
 #include "common.hh"
 #include "logging.hh"
 #include "socket.hh"
-
-#define BUFFER 1024
+#include "timestamp.hh"
 
 using namespace std;
-using clock_type = std::chrono::high_resolution_clock;
+using clock_type = SteadyClock;
 
 std::atomic<bool> recv_traffic(true);
-std::atomic<size_t> recv_cnt = 0;
+/* bytes received, one shard per data thread */
+ShardedCounter recv_cnt;
 static size_t last_observed_recv_cnt = 0;
 std::unique_ptr<std::ofstream> perf_log;
 
@@ -42,7 +43,7 @@ void perf_log_thread(const std::chrono::milliseconds interval) {
   size_t tmp = 0;
   while (recv_traffic.load()) {
     // log the current throughput in Mbps
-    tmp = recv_cnt;
+    tmp = recv_cnt.total();
     unsigned long long current_thr =
         (tmp - last_observed_recv_cnt) * 8 / interval.count() * 1000 / 1000000;
     last_observed_recv_cnt = tmp;
@@ -54,14 +55,11 @@ void perf_log_thread(const std::chrono::milliseconds interval) {
   }
 }
 
-void data_thread(TCPSocket& sock) {
-  char buffer[BUFFER];
+void data_thread(TCPSocket& sock, const BulkReceiver::Mode recv_mode) {
+  BulkReceiver receiver(sock, recv_mode, recv_cnt);
   while (recv_traffic.load()) {
     try {
-      size_t bytes_received = sock.read(BUFFER).length();
-      if (bytes_received > 0) {
-        recv_cnt += bytes_received;
-      } else {
+      if (receiver.receive() == 0) {
         // Connection closed by server
         LOG(INFO) << "Server closed connection";
         break;
@@ -71,16 +69,18 @@ void data_thread(TCPSocket& sock) {
       break;
     }
   }
-  LOG(INFO) << "Data thread exits";
+  LOG(INFO) << "Data thread exits: " << receiver.summary();
 }
 
 void usage_error(const string& program_name) {
   cerr << "Usage: " << program_name << " [OPTION]... [COMMAND]" << endl;
   cerr << endl;
   cerr << "Options = --ip=IP_ADDR --port=PORT --cong=ALGORITHM (default: "
-          "CUBIC) --perf-log=PATH(default is None) --perf-interval=MS"
+          "CUBIC) --perf-log=PATH(default is None) --perf-interval=MS "
+          "--recv-mode=MODE"
        << endl
-       << "If perf_log is specified, the default log interval is 500ms" << endl;
+       << "If perf_log is specified, the default log interval is 500ms; "
+       << "recv-mode is copy (default), trunc or splice" << endl;
   cerr << endl;
 
   throw runtime_error("invalid arguments");
@@ -105,9 +105,11 @@ int main(int argc, char** argv) {
       {"cong", optional_argument, nullptr, 'c'},
       {"perf-log", optional_argument, nullptr, 'l'},
       {"perf-interval", optional_argument, nullptr, 'i'},
+      {"recv-mode", required_argument, nullptr, 'r'},
       {0, 0, nullptr, 0}};
 
   string ip, service, cong_ctl, perf_log_path, interval;
+  BulkReceiver::Mode recv_mode = BulkReceiver::Mode::COPY;
   while (true) {
     const int opt = getopt_long(argc, argv, "", command_line_options, nullptr);
     if (opt == -1) { /* end of options */
@@ -129,6 +131,9 @@ int main(int argc, char** argv) {
     case 'p':
       service = optarg;
       break;
+    case 'r':
+      recv_mode = BulkReceiver::parse_mode(optarg);
+      break;
     case '?':
       usage_error(argv[0]);
       break;
@@ -183,7 +188,7 @@ int main(int argc, char** argv) {
   }
 
   // start data receiving thread
-  thread dt(data_thread, std::ref(client));
+  thread dt(data_thread, std::ref(client), recv_mode);
   LOG(INFO) << "Client is receiving data from server...";
 
   /* wait for finish */
@@ -0,0 +1,95 @@
+#include <getopt.h>
+
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "timestamp.hh"
+
+using namespace std;
+
+void usage_error(const string& program_name) {
+  cerr << "Usage: " << program_name << " [OPTION]..." << endl;
+  cerr << endl;
+  cerr << "Options = --iterations=N" << endl;
+  cerr << endl;
+  cerr << "Prints the cost per call of every clock the tools read; run with "
+          "MONOTONIC_CLOCK=tsc to measure the TSC path of steady_nsecs()"
+       << endl;
+
+  throw runtime_error("invalid arguments");
+}
+
+/* keeps the compiler from dropping the calls being timed */
+volatile uint64_t sink;
+
+template <typename Clock>
+void bench(const string& name, const uint64_t iterations, Clock&& read) {
+  uint64_t sum = 0;
+  const uint64_t start = monotonic_nsecs();
+  for (uint64_t i = 0; i < iterations; i++) {
+    sum += read();
+  }
+  const uint64_t elapsed = monotonic_nsecs() - start;
+  sink = sum;
+  cout << name << "\t" << fixed << setprecision(1)
+       << double(elapsed) / iterations << endl;
+}
+
+uint64_t posix_clock(const clockid_t clock) {
+  timespec ts;
+  clock_gettime(clock, &ts);
+  return ts.tv_nsec;
+}
+
+int main(int argc, char** argv) {
+  const option command_line_options[] = {
+      {"iterations", required_argument, nullptr, 'n'}, {0, 0, nullptr, 0}};
+
+  uint64_t iterations = 10000000;
+  while (true) {
+    const int opt = getopt_long(argc, argv, "", command_line_options, nullptr);
+    if (opt == -1) { /* end of options */
+      break;
+    }
+    switch (opt) {
+    case 'n':
+      iterations = stoull(optarg);
+      break;
+    case '?':
+      usage_error(argv[0]);
+      break;
+    default:
+      throw runtime_error("getopt_long: unexpected return value " +
+                          to_string(opt));
+    }
+  }
+  if (optind != argc or iterations == 0) {
+    usage_error(argv[0]);
+  }
+
+  /* calibrate the TSC, if chosen, before timing anything */
+  const string source = steady_clock_source();
+
+  cout << "clock\tns_per_call" << endl;
+  bench("steady_nsecs (" + source + ")", iterations, steady_nsecs);
+  bench("monotonic_nsecs", iterations, monotonic_nsecs);
+  bench("timestamp_usecs", iterations, timestamp_usecs);
+  bench("SteadyClock::now", iterations,
+        [] { return SteadyClock::now().time_since_epoch().count(); });
+  bench("CLOCK_MONOTONIC", iterations,
+        [] { return posix_clock(CLOCK_MONOTONIC); });
+  bench("CLOCK_MONOTONIC_COARSE", iterations,
+        [] { return posix_clock(CLOCK_MONOTONIC_COARSE); });
+  bench("CLOCK_REALTIME", iterations,
+        [] { return posix_clock(CLOCK_REALTIME); });
+  bench("std::chrono::steady_clock::now", iterations, [] {
+    return chrono::steady_clock::now().time_since_epoch().count();
+  });
+  bench("std::chrono::high_resolution_clock::now", iterations, [] {
+    return chrono::high_resolution_clock::now().time_since_epoch().count();
+  });
+}
@@ -0,0 +1,125 @@
+#include <getopt.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include "histogram.hh"
+#include "sock_diag.hh"
+#include "timestamp.hh"
+
+using namespace std;
+
+void usage_error(const string& program_name) {
+  cerr << "Usage: " << program_name << " [OPTION]..." << endl;
+  cerr << endl;
+  cerr << "Options = --family=4|6 --sport=PORT --dport=PORT "
+          "--cgroup=CGROUP_PATH --interval=MS --count=N"
+       << endl;
+  cerr << endl;
+  cerr << "Prints one line per interval (default 100 ms) summarizing all "
+          "established TCP flows that match, read with one sock_diag dump"
+       << endl;
+
+  throw runtime_error("invalid arguments");
+}
+
+int main(int argc, char** argv) {
+  const option command_line_options[] = {
+      {"family", required_argument, nullptr, 'f'},
+      {"sport", required_argument, nullptr, 's'},
+      {"dport", required_argument, nullptr, 'd'},
+      {"cgroup", required_argument, nullptr, 'c'},
+      {"interval", required_argument, nullptr, 'i'},
+      {"count", required_argument, nullptr, 'n'},
+      {0, 0, nullptr, 0}};
+
+  SockDiagCollector::Filter filter;
+  uint64_t interval_ms = 100, count = 0;
+  while (true) {
+    const int opt = getopt_long(argc, argv, "", command_line_options, nullptr);
+    if (opt == -1) { /* end of options */
+      break;
+    }
+    switch (opt) {
+    case 'c':
+      filter.cgroup = SockDiagCollector::cgroup_id(optarg);
+      break;
+    case 'd':
+      filter.dport = stoul(optarg);
+      break;
+    case 'f':
+      if (optarg == string("4")) {
+        filter.family = AF_INET;
+      } else if (optarg == string("6")) {
+        filter.family = AF_INET6;
+      } else {
+        usage_error(argv[0]);
+      }
+      break;
+    case 'i':
+      interval_ms = stoull(optarg);
+      break;
+    case 'n':
+      count = stoull(optarg);
+      break;
+    case 's':
+      filter.sport = stoul(optarg);
+      break;
+    case '?':
+      usage_error(argv[0]);
+      break;
+    default:
+      throw runtime_error("getopt_long: unexpected return value " +
+                          to_string(opt));
+    }
+  }
+  if (optind != argc or interval_ms == 0) {
+    usage_error(argv[0]);
+  }
+
+  SockDiagCollector collector(filter);
+  /* bytes acked and retransmitted by each flow at the previous tick */
+  unordered_map<uint64_t, pair<uint64_t, uint64_t>> last, current;
+  uint64_t last_us = monotonic_usecs();
+  const uint64_t start_us = last_us;
+
+  cout << "time_ms\tflows\tthroughput_mbps\tretrans_mbps\trtt_ms_p50\t"
+          "rtt_ms_p99\tcwnd_mean"
+       << endl;
+  for (uint64_t tick = 0; count == 0 or tick < count; tick++) {
+    usleep(interval_ms * 1000);
+
+    const TCPStateTable& flows = collector.collect();
+    const uint64_t now_us = monotonic_usecs();
+
+    /* flows seen for the first time count from their next tick */
+    uint64_t acked = 0, retrans = 0, cwnd = 0;
+    Histogram rtt_us;
+    current.clear();
+    for (size_t i = 0; i < flows.size(); i++) {
+      const auto it = last.find(flows.cookie[i]);
+      if (it != last.end()) {
+        acked += flows.bytes_acked[i] - it->second.first;
+        retrans += flows.bytes_retrans[i] - it->second.second;
+      }
+      current[flows.cookie[i]] = {flows.bytes_acked[i], flows.bytes_retrans[i]};
+      rtt_us.add(flows.rtt_us[i]);
+      cwnd += flows.snd_cwnd[i];
+    }
+    swap(last, current);
+
+    const double elapsed_us = now_us - last_us;
+    last_us = now_us;
+    cout << fixed << setprecision(3) << (now_us - start_us) / 1000 << "\t"
+         << flows.size() << "\t" << acked * 8 / elapsed_us << "\t"
+         << retrans * 8 / elapsed_us << "\t" << rtt_us.percentile(50) / 1000.0
+         << "\t" << rtt_us.percentile(99) / 1000.0 << "\t"
+         << (flows.size() ? double(cwnd) / flows.size() : 0) << endl;
+  }
+  return 0;
+}
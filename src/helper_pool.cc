@@ -0,0 +1,86 @@
+#include <getopt.h>
+#include <signal.h>
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "filesystem.hh"
+#include "helper_pool.hh"
+#include "logging.hh"
+
+using namespace std;
+
+void usage_error(const string& program_name) {
+  cerr << "Usage: " << program_name << " [OPTION]..." << endl;
+  cerr << endl;
+  cerr << "Options = --path=IPC_PATH --pyhelper=PYTHON_PATH "
+          "--model=MODEL_PATH --size=N"
+       << endl;
+  cerr << endl;
+  cerr << "Keeps N Python helpers (default 2) with the model loaded, and "
+          "hands one to every flow started with --helper-pool=IPC_PATH"
+       << endl;
+
+  throw runtime_error("invalid arguments");
+}
+
+int main(int argc, char** argv) {
+  /* a flow that goes away while being handed a helper must not kill us */
+  if (signal(SIGPIPE, SIG_IGN) == SIG_ERR) {
+    throw runtime_error("signal: failed to ignore SIGPIPE");
+  }
+
+  const option command_line_options[] = {
+      {"path", required_argument, nullptr, 'p'},
+      {"pyhelper", required_argument, nullptr, 'h'},
+      {"model", required_argument, nullptr, 'm'},
+      {"size", required_argument, nullptr, 'n'},
+      {0, 0, nullptr, 0}};
+
+  string path, pyhelper, model;
+  size_t size = 2;
+  while (true) {
+    const int opt = getopt_long(argc, argv, "", command_line_options, nullptr);
+    if (opt == -1) { /* end of options */
+      break;
+    }
+    switch (opt) {
+    case 'h':
+      pyhelper = optarg;
+      break;
+    case 'm':
+      model = optarg;
+      break;
+    case 'n':
+      size = stoul(optarg);
+      break;
+    case 'p':
+      path = optarg;
+      break;
+    case '?':
+      usage_error(argv[0]);
+      break;
+    default:
+      throw runtime_error("getopt_long: unexpected return value " +
+                          to_string(opt));
+    }
+  }
+  if (optind != argc or path.empty() or pyhelper.empty() or model.empty() or
+      size == 0) {
+    usage_error(argv[0]);
+  }
+
+  if (not fs::exists(pyhelper)) {
+    throw runtime_error("Pyhelper does not exist");
+  }
+  if (not fs::exists(model)) {
+    throw runtime_error("Trained model does not exist");
+  }
+
+  /* the helpers connect to a path derived from this one */
+  HelperPool pool(fs::absolute(path), pyhelper, {"--model-path", model}, size);
+  LOG(INFO) << "Helper pool of " << size << " listening at " << path;
+  return pool.loop();
+}
@@ -0,0 +1,578 @@
+#include <getopt.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "address.hh"
+#include "exception.hh"
+#include "histogram.hh"
+#include "io_uring.hh"
+#include "ipc_socket.hh"
+#include "json.hpp"
+#include "offline_state_provider.hh"
+#include "serialization.hh"
+#include "socket.hh"
+#include "tcp_info.hh"
+#include "timer_wheel.hh"
+#include "timerfd.hh"
+#include "timestamp.hh"
+
+using namespace std;
+
+// short name
+using json = nlohmann::json;
+
+/* define message type */
+enum class MessageType { INIT = 0, START = 1, END = 2, ALIVE = 3, OBSERVE = 4 };
+
+template <typename E>
+constexpr typename std::underlying_type<E>::type to_underlying(E e) noexcept {
+  return static_cast<typename std::underlying_type<E>::type>(e);
+}
+
+struct Config {
+  string channel = "unix";
+  string ip = "127.0.0.1";
+  uint16_t port = 8888;
+  string socket_path = "/tmp/astraea.sock";
+  unsigned int flows = 100;
+  unsigned int threads = 1;
+  uint64_t interval_us = 30000;
+  uint64_t duration_us = 10000000;
+  uint64_t warmup_us = 1000000;
+  /* how long to wait for outstanding replies after the last request */
+  uint64_t drain_us = 1000000;
+  unsigned int seed = 0;
+  /* rows of a perf-log to replay; synthesize states if empty */
+  vector<TCPDeepCCInfo> replay{};
+};
+
+Config config;
+std::atomic<bool> interrupted(false);
+
+struct Flow {
+  int flow_id = 0;
+  unique_ptr<FileDescriptor> sock{};
+  /* bytes of a partially received reply (UNIX stream channel) */
+  string pending{};
+
+  /* control steps are due at first_step_us + step * interval */
+  uint64_t first_step_us = 0;
+  uint64_t next_step = 0;
+  TimerWheel::TimerId timer = 0;
+
+  struct Request {
+    uint64_t step;
+    uint64_t due_us;
+    uint64_t sent_us;
+  };
+  /* requests without a reply yet, oldest first */
+  deque<Request> outstanding{};
+
+  /* state source */
+  TCPDeepCCInfo info{};
+  u64 max_tput = 0;
+  size_t replay_row = 0;
+  u32 base_rtt_us = 0;
+  u64 bandwidth = 0; /* bytes per second */
+  int cwnd = 10;
+};
+
+/* measurements of one worker thread; merged for the report */
+struct Stats {
+  /* from the scheduled send time, so a stalled server or generator cannot
+   * hide latency (no coordinated omission) */
+  Histogram latency_us{};
+  /* from the moment the request was actually written */
+  Histogram service_us{};
+  /* how late the generator sent requests against their schedule */
+  Histogram send_lag_us{};
+  Histogram batch_size{};
+  uint64_t sent = 0;
+  uint64_t received = 0;
+  uint64_t lost = 0;
+  uint64_t errors = 0;
+
+  void merge(const Stats& other) {
+    latency_us.merge(other.latency_us);
+    service_us.merge(other.service_us);
+    send_lag_us.merge(other.send_lag_us);
+    batch_size.merge(other.batch_size);
+    sent += other.sent;
+    received += other.received;
+    lost += other.lost;
+    errors += other.errors;
+  }
+};
+
+string frame(const json& message) {
+  const string payload = message.dump();
+  return put_field(uint16_t(payload.length())) + payload;
+}
+
+/* blocking receive of one reply, used during the handshake */
+json recv_reply(Flow& flow) {
+  string payload;
+  if (config.channel == "unix") {
+    const string header = flow.sock->read_exactly(2);
+    payload = flow.sock->read_exactly(get_uint16(header.data()));
+  } else {
+    const string datagram = flow.sock->read();
+    if (datagram.length() < 2 or
+        get_uint16(datagram.data()) != datagram.length() - 2) {
+      throw runtime_error("Incomplete message received");
+    }
+    payload = datagram.substr(2);
+  }
+  return json::parse(payload);
+}
+
+unique_ptr<FileDescriptor> connect_to_server(void) {
+  if (config.channel == "unix") {
+    auto sock = make_unique<IPCSocket>();
+    sock->connect(config.socket_path);
+    return sock;
+  }
+  /* connected, so that read() only returns the replies of this flow */
+  auto sock = make_unique<UDPSocket>();
+  sock->connect(Address(config.ip, config.port));
+  return sock;
+}
+
+/* fill flow.info with the next monitor-interval sample */
+void next_state(Flow& flow, mt19937& rng) {
+  if (not config.replay.empty()) {
+    flow.info = config.replay[flow.replay_row];
+    flow.replay_row = (flow.replay_row + 1) % config.replay.size();
+    /* close the loop on the window the service assigned */
+    flow.info.cwnd = flow.cwnd;
+    flow.max_tput = max(flow.max_tput, flow.info.avg_thr);
+    return;
+  }
+
+  flow.info = synthesize_state({flow.bandwidth, flow.base_rtt_us}, flow.cwnd,
+                               config.interval_us, rng);
+  flow.max_tput = max(flow.max_tput, flow.info.avg_thr);
+}
+
+json state_json(Flow& flow) {
+  json state = flow.info.to_json();
+  state["max_tput"] = flow.max_tput;
+  state["loss_ratio"] =
+      double(flow.info.lost_bytes) * 1000000 / config.interval_us;
+  state["time_delta"] = config.interval_us;
+  return state;
+}
+
+void send_alive(Flow& flow, Stats& stats, mt19937& rng,
+                const uint64_t measure_start_us,
+                const uint64_t measure_end_us) {
+  const uint64_t step = flow.next_step++;
+  const uint64_t due_us = flow.first_step_us + step * config.interval_us;
+
+  next_state(flow, rng);
+  json message;
+  message["type"] = to_underlying(MessageType::ALIVE);
+  message["flow_id"] = flow.flow_id;
+  message["seq"] = step;
+  message["state"] = state_json(flow);
+  flow.sock->write(frame(message));
+
+  const uint64_t now = monotonic_usecs();
+  flow.outstanding.push_back({step, due_us, now});
+  if (due_us >= measure_start_us and due_us < measure_end_us) {
+    stats.sent++;
+    stats.send_lag_us.add(now > due_us ? now - due_us : 0);
+  }
+}
+
+void handle_reply(Flow& flow, const string& payload, Stats& stats,
+                  const uint64_t measure_start_us,
+                  const uint64_t measure_end_us) {
+  const uint64_t now = monotonic_usecs();
+  json reply;
+  try {
+    reply = json::parse(payload);
+  } catch (json::exception& e) {
+    stats.errors++;
+    return;
+  }
+
+  /* replies of one flow come back in order; without a step id, assume the
+   * oldest request was answered */
+  uint64_t step = flow.outstanding.empty() ? 0 : flow.outstanding.front().step;
+  if (reply.contains("seq")) {
+    step = reply["seq"];
+  }
+  /* the service answers only the latest of several queued requests of a
+   * flow, so anything older is lost */
+  while (not flow.outstanding.empty() and flow.outstanding.front().step < step) {
+    if (flow.outstanding.front().due_us >= measure_start_us) {
+      stats.lost++;
+    }
+    flow.outstanding.pop_front();
+  }
+  if (flow.outstanding.empty() or flow.outstanding.front().step != step) {
+    stats.errors++;
+    return;
+  }
+  const Flow::Request request = flow.outstanding.front();
+  flow.outstanding.pop_front();
+
+  if (reply.contains("cwnd")) {
+    flow.cwnd = max(4, reply["cwnd"].get<int>());
+  }
+  if (request.due_us < measure_start_us or request.due_us >= measure_end_us) {
+    return;
+  }
+  stats.received++;
+  stats.latency_us.add(now - request.due_us);
+  stats.service_us.add(now - request.sent_us);
+  if (reply.contains("batch")) {
+    stats.batch_size.add(reply["batch"].get<uint64_t>());
+  }
+}
+
+/* `length` bytes received on the socket of `flow` */
+void on_data(Flow& flow, const char* data, const size_t length, Stats& stats,
+             const uint64_t measure_start_us, const uint64_t measure_end_us) {
+  if (config.channel == "udp") {
+    /* one datagram per receive */
+    if (length < 2 or get_uint16(data) != length - 2) {
+      stats.errors++;
+      return;
+    }
+    handle_reply(flow, string(data + 2, length - 2), stats, measure_start_us,
+                 measure_end_us);
+    return;
+  }
+
+  flow.pending.append(data, length);
+  size_t offset = 0;
+  while (flow.pending.length() - offset >= 2) {
+    const uint16_t length = get_uint16(flow.pending.data() + offset);
+    if (flow.pending.length() - offset - 2 < length) {
+      break;
+    }
+    handle_reply(flow, flow.pending.substr(offset + 2, length), stats,
+                 measure_start_us, measure_end_us);
+    offset += 2 + length;
+  }
+  flow.pending.erase(0, offset);
+}
+
+/* drive a share of the flows from one thread; all workers share `start_us`
+ * so that the measurement windows line up.
+ *
+ * Replies arrive through multishot receives on an io_uring and requests are
+ * scheduled on a timing wheel behind one timerfd, so the cost of a request
+ * does not grow with the number of flows the way a poll() over every socket
+ * would. */
+void worker(vector<unique_ptr<Flow>>& flows, Stats& stats,
+            const unsigned int id, const uint64_t start_us) {
+  mt19937 rng(config.seed + id);
+  const uint64_t measure_start_us = start_us + config.warmup_us;
+  const uint64_t measure_end_us = start_us + config.duration_us;
+
+  /* user_data of the timerfd read; flows use their index */
+  const uint64_t TIMER_EVENT = UINT64_MAX;
+
+  IOUring ring(1024);
+  ring.setup_buffer_ring(1024, 4096);
+  TimerWheel timers(monotonic_usecs());
+  TimerFD timer_fd;
+  uint64_t expirations = 0;
+
+  for (size_t i = 0; i < flows.size(); i++) {
+    Flow& flow = *flows[i];
+    ring.prep_multishot_recv(flow.sock->fd_num(), i);
+
+    /* spread the flows over one interval so that they do not arrive in
+     * lockstep, as independent connections would not */
+    const uint64_t phase_us =
+        uniform_int_distribution<uint64_t>(0, config.interval_us - 1)(rng);
+    flow.first_step_us = start_us + phase_us;
+    const uint64_t now = monotonic_usecs();
+    flow.timer = timers.add(
+        now, flow.first_step_us > now ? flow.first_step_us - now : 0,
+        [&flow, &stats, &rng, measure_start_us, measure_end_us]() {
+          send_alive(flow, stats, rng, measure_start_us, measure_end_us);
+        },
+        config.interval_us);
+  }
+
+  bool done = false;
+  const uint64_t now = monotonic_usecs();
+  timers.add(now, measure_end_us > now ? measure_end_us - now : 0, [&]() {
+    /* stop offering load, then give the replies in flight time to arrive */
+    for (auto& flow : flows) {
+      timers.cancel(flow->timer);
+    }
+    timers.add(monotonic_usecs(), config.drain_us, [&done]() { done = true; });
+  });
+
+  auto arm_timer = [&]() {
+    const uint64_t next_us = timers.next_expiry_us();
+    if (next_us == UINT64_MAX) {
+      timer_fd.disarm();
+    } else {
+      timer_fd.arm(next_us);
+    }
+    ring.prep_read(timer_fd, reinterpret_cast<char*>(&expirations),
+                   sizeof(expirations), TIMER_EVENT);
+  };
+  arm_timer();
+
+  while (not done and not interrupted) {
+    ring.submit_and_wait(1);
+    ring.for_each_completion([&](const IOUring::Completion& completion) {
+      if (completion.user_data == TIMER_EVENT) {
+        timers.advance(monotonic_usecs());
+        arm_timer();
+        return;
+      }
+
+      Flow& flow = *flows.at(completion.user_data);
+      if (completion.res > 0) {
+        on_data(flow, ring.buffer(completion.buffer_id()), completion.res,
+                stats, measure_start_us, measure_end_us);
+        ring.recycle_buffer(completion.buffer_id());
+      } else if (completion.res == 0) {
+        throw runtime_error("inference service closed flow " +
+                            to_string(flow.flow_id));
+      } else if (completion.res != -ENOBUFS) {
+        throw unix_error("recv", -completion.res);
+      }
+      if (not completion.more()) {
+        ring.prep_multishot_recv(flow.sock->fd_num(), completion.user_data);
+      }
+    });
+  }
+
+  for (auto& flow : flows) {
+    for (const auto& request : flow->outstanding) {
+      if (request.due_us >= measure_start_us and
+          request.due_us < measure_end_us) {
+        stats.lost++;
+      }
+    }
+  }
+}
+
+/* one socket per flow: lift the soft limit on open files if needed */
+void raise_fd_limit(const unsigned int needed) {
+  rlimit limit;
+  CheckSystemCall("getrlimit", getrlimit(RLIMIT_NOFILE, &limit));
+  if (limit.rlim_cur < needed + 64) {
+    limit.rlim_cur = min(limit.rlim_max, rlim_t(needed + 64));
+    CheckSystemCall("setrlimit", setrlimit(RLIMIT_NOFILE, &limit));
+  }
+}
+
+void print_distribution(const string& name, const Histogram& histogram) {
+  cout << name << ":";
+  histogram.for_each_bucket(
+      [](const uint64_t lowest, const uint64_t highest, const uint64_t count) {
+        cout << " ";
+        if (lowest == highest) {
+          cout << lowest;
+        } else {
+          cout << lowest << "-" << highest;
+        }
+        cout << "=" << count;
+      });
+  cout << endl;
+}
+
+void report(const Stats& stats) {
+  const double window_s =
+      double(config.duration_us - config.warmup_us) / 1000000;
+  const double offered = config.flows * 1000000.0 / config.interval_us;
+
+  cout << fixed << setprecision(1);
+  cout << "flows=" << config.flows << " interval=" << config.interval_us
+       << "us channel=" << config.channel
+       << " states=" << (config.replay.empty() ? "synthesized" : "replayed")
+       << endl;
+  cout << "offered QPS: " << offered << endl;
+  cout << "achieved QPS: " << stats.received / window_s << endl;
+  cout << "requests: sent=" << stats.sent << " answered=" << stats.received
+       << " lost=" << stats.lost << " errors=" << stats.errors << endl;
+  cout << "latency us (from schedule): " << stats.latency_us.summary() << endl;
+  cout << "latency us (from send): " << stats.service_us.summary() << endl;
+  cout << "send lag us: " << stats.send_lag_us.summary() << endl;
+  if (stats.batch_size.count() > 0) {
+    cout << "batch size: " << stats.batch_size.summary() << endl;
+    print_distribution("batch size distribution", stats.batch_size);
+  } else {
+    cout << "batch size: not reported by the service" << endl;
+  }
+}
+
+void signal_handler(int sig) {
+  if (sig == SIGINT or sig == SIGTERM) {
+    interrupted = true;
+  }
+}
+
+void usage_error(const string& program_name) {
+  cerr << "Usage: " << program_name << " [OPTION]..." << endl;
+  cerr << endl;
+  cerr << "Options = --channel=unix|udp --ip=IP_ADDR --port=PORT "
+          "--socket=PATH --flows=N --interval=INTERVAL (Milliseconds) "
+          "--duration=SECONDS --warmup=SECONDS --threads=N "
+          "--replay=PERF_LOG --seed=N"
+       << endl;
+  cerr << endl;
+  cerr << "Default channel is unix (" << config.socket_path << "); " << endl
+       << "Default UDP service is " << config.ip << ":" << config.port << "; "
+       << endl
+       << "Default load is " << config.flows << " flows every "
+       << config.interval_us / 1000 << "ms for "
+       << config.duration_us / 1000000 << "s; " << endl
+       << "States are synthesized unless a perf log is replayed; " << endl;
+
+  throw runtime_error("invalid arguments");
+}
+
+int main(int argc, char** argv) {
+  signal(SIGTERM, signal_handler);
+  signal(SIGINT, signal_handler);
+  /* ignore SIGPIPE generated by Socket write */
+  if (signal(SIGPIPE, SIG_IGN) == SIG_ERR) {
+    throw runtime_error("signal: failed to ignore SIGPIPE");
+  }
+
+  const option command_line_options[] = {
+      {"channel", required_argument, nullptr, 'c'},
+      {"ip", required_argument, nullptr, 'a'},
+      {"port", required_argument, nullptr, 'p'},
+      {"socket", required_argument, nullptr, 's'},
+      {"flows", required_argument, nullptr, 'n'},
+      {"interval", required_argument, nullptr, 't'},
+      {"duration", required_argument, nullptr, 'd'},
+      {"warmup", required_argument, nullptr, 'w'},
+      {"threads", required_argument, nullptr, 'j'},
+      {"replay", required_argument, nullptr, 'r'},
+      {"seed", required_argument, nullptr, 'e'},
+      {0, 0, nullptr, 0}};
+
+  string replay_path;
+  while (true) {
+    const int opt = getopt_long(argc, argv, "", command_line_options, nullptr);
+    if (opt == -1) { /* end of options */
+      break;
+    }
+    switch (opt) {
+    case 'c':
+      config.channel = optarg;
+      break;
+    case 'a':
+      config.ip = optarg;
+      break;
+    case 'p':
+      config.port = stoi(optarg);
+      break;
+    case 's':
+      config.socket_path = optarg;
+      break;
+    case 'n':
+      config.flows = stoul(optarg);
+      break;
+    case 't':
+      config.interval_us = stod(optarg) * 1000;
+      break;
+    case 'd':
+      config.duration_us = stod(optarg) * 1000000;
+      break;
+    case 'w':
+      config.warmup_us = stod(optarg) * 1000000;
+      break;
+    case 'j':
+      config.threads = stoul(optarg);
+      break;
+    case 'r':
+      replay_path = optarg;
+      break;
+    case 'e':
+      config.seed = stoul(optarg);
+      break;
+    case '?':
+      usage_error(argv[0]);
+      break;
+    default:
+      throw runtime_error("getopt_long: unexpected return value " +
+                          to_string(opt));
+    }
+  }
+
+  if (optind != argc or (config.channel != "unix" and config.channel != "udp") or
+      config.flows == 0 or config.threads == 0 or config.interval_us == 0 or
+      config.warmup_us >= config.duration_us) {
+    usage_error(argv[0]);
+  }
+  config.threads = min(config.threads, config.flows);
+  if (not replay_path.empty()) {
+    config.replay = load_perf_log_states(replay_path);
+  }
+  raise_fd_limit(config.flows);
+
+  /* register every flow before offering load */
+  mt19937 rng(config.seed);
+  vector<vector<unique_ptr<Flow>>> shards(config.threads);
+  for (unsigned int i = 0; i < config.flows; i++) {
+    auto flow = make_unique<Flow>();
+    flow->sock = connect_to_server();
+    flow->flow_id = int(getpid() % 10000) * 100000 + i;
+    flow->replay_row =
+        config.replay.empty() ? 0 : rng() % config.replay.size();
+    flow->base_rtt_us = uniform_int_distribution<u32>(10000, 100000)(rng);
+    flow->bandwidth = uniform_int_distribution<u64>(125000, 12500000)(rng);
+
+    json message;
+    message["type"] = to_underlying(MessageType::START);
+    message["flow_id"] = flow->flow_id;
+    flow->sock->write(frame(message));
+    /* the service may hand out another id if ours is taken */
+    flow->flow_id = recv_reply(*flow).at("flow_id");
+
+    shards[i % config.threads].push_back(move(flow));
+  }
+
+  const uint64_t start_us = monotonic_usecs();
+  vector<Stats> stats(config.threads);
+  vector<thread> workers;
+  for (unsigned int i = 0; i < config.threads; i++) {
+    workers.emplace_back(worker, ref(shards[i]), ref(stats[i]), i, start_us);
+  }
+  for (auto& t : workers) {
+    t.join();
+  }
+
+  for (auto& shard : shards) {
+    for (auto& flow : shard) {
+      json message;
+      message["type"] = to_underlying(MessageType::END);
+      message["flow_id"] = flow->flow_id;
+      flow->sock->write(frame(message));
+    }
+  }
+
+  Stats total;
+  for (const auto& s : stats) {
+    total.merge(s);
+  }
+  report(total);
+  return 0;
+}
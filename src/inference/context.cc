@@ -13,6 +13,22 @@ int map_action(float action, float cwnd) {
   return out;
 }
 
+void tag_reply(const json& request, json& reply) {
+  if (request.contains("seq")) {
+    reply["seq"] = request["seq"];
+    reply["batch"] = TFInference::Get()->reply_batch_size();
+  }
+}
+
+uint64_t request_step(const json& request) {
+#ifdef ENABLE_TRACE
+  return request.value("seq", uint64_t(0));
+#else
+  (void)request;
+  return 0;
+#endif
+}
+
 FlowContext::FlowContext(int flow_id) : flow_id_(flow_id) {
   state_.resize(kStateSize * kRecurrentNum);
   std::fill(state_.begin(), state_.end(), 0);
@@ -21,8 +37,23 @@ FlowContext::FlowContext(int flow_id) : flow_id_(flow_id) {
 }
 
 std::vector<float> FlowContext::format_state(json& data) {
-  // store latest in current_
-  transform_state(data);
+  transform_state({data["avg_thr"], data["avg_urtt"], data["srtt_us"],
+                   data["min_rtt"], data["max_tput"], data["cwnd"],
+                   data["packets_out"], data["pacing_rate"],
+                   data["retrans_out"], data["loss_ratio"]});
+  return slide_window();
+}
+
+std::vector<float> FlowContext::format_state(const ControlSample& sample) {
+  const TCPDeepCCInfo& info = sample.info;
+  transform_state({uint32_t(info.avg_thr), info.avg_urtt, info.srtt_us,
+                   info.min_rtt, uint32_t(sample.max_tput), info.cwnd,
+                   info.packets_out, info.pacing_rate, info.retrans_out,
+                   sample.loss_ratio});
+  return slide_window();
+}
+
+std::vector<float> FlowContext::slide_window() {
   std::vector<float> tmp;
   tmp.resize(state_.size());
   // first copy state [10:]
@@ -36,22 +67,22 @@ std::vector<float> FlowContext::format_state(json& data) {
   return tmp;
 }
 
-void FlowContext::transform_state(json& state_dict) {
+void FlowContext::transform_state(const StateFields& fields) {
   current_.clear();
-  uint32_t avg_thr = state_dict["avg_thr"];
-  uint32_t avg_urtt = state_dict["avg_urtt"];
-  uint32_t srtt_us = state_dict["srtt_us"];
-  uint32_t min_rtt = state_dict["min_rtt"];
-  uint32_t max_tput = state_dict["max_tput"];
-  uint32_t cwnd = state_dict["cwnd"];
-  uint32_t packets_out = state_dict["packets_out"];
-  uint32_t pacing_rate = state_dict["pacing_rate"];
-  uint32_t retrans_out = state_dict["retrans_out"];
-  double loss_ratio = state_dict["loss_ratio"];
+  const uint32_t avg_thr = fields.avg_thr;
+  const uint32_t avg_urtt = fields.avg_urtt;
+  const uint32_t srtt_us = fields.srtt_us;
+  const uint32_t min_rtt = fields.min_rtt;
+  const uint32_t max_tput = fields.max_tput;
+  const uint32_t cwnd = fields.cwnd;
+  const uint32_t packets_out = fields.packets_out;
+  const uint32_t pacing_rate = fields.pacing_rate;
+  const uint32_t retrans_out = fields.retrans_out;
+  const double loss_ratio = fields.loss_ratio;
   if (avg_thr == 0) {
     current_.push_back(0.5);
   } else {
-    current_.push_back(max_tput > 0 ? (float)avg_thr / avg_thr : 0);
+    current_.push_back(max_tput > 0 ? (float)avg_thr / max_tput : 0);
   }
   if (avg_urtt == 0) {
     current_.push_back(2);
@@ -1,20 +1,46 @@
 #ifndef CONTEXT_HH
 #define CONTEXT_HH
 
+#include "control_sample.hh"
 #include "define.hh"
 #include "tf_inference.hh"
 
 int map_action(float action, float cwnd);
 
+// echo the step id of a request (used by the load generator) into its reply,
+// together with the size of the batch the request was served in
+void tag_reply(const json& request, json& reply);
+
+// control step of a request for TRACE_STEP(); 0 when built without tracing
+uint64_t request_step(const json& request);
+
 class FlowContext {
  public:
   FlowContext(int flow_id);
 
   // get new cwnd from model
   std::vector<float> format_state(json& data);
+  // the same for a sample taken in this process, with no JSON in between
+  std::vector<float> format_state(const ControlSample& sample);
 
  private:
-  void transform_state(json& state_dict);
+  // the fields of a state the model reads, narrowed as the JSON path does
+  struct StateFields {
+    uint32_t avg_thr;
+    uint32_t avg_urtt;
+    uint32_t srtt_us;
+    uint32_t min_rtt;
+    uint32_t max_tput;
+    uint32_t cwnd;
+    uint32_t packets_out;
+    uint32_t pacing_rate;
+    uint32_t retrans_out;
+    double loss_ratio;
+  };
+
+  void transform_state(const StateFields& fields);
+  // append current_ to the window of the last kRecurrentNum states
+  std::vector<float> slide_window();
 
  private:
   int flow_id_;
@@ -4,6 +4,7 @@ std::string graphPath = "models/my-model.meta";
 std::string checkpointPath = "models/my-model";
 int batchMode = false;
 std::string channel = "unix";
+std::string ioEngine = "asio";
 
 std::string print_state(const std::vector<float>& state) {
   std::string str = "[";
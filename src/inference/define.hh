@@ -28,6 +28,9 @@ extern std::string checkpointPath;
 // use UDP or UNIX socket
 extern std::string channel;
 
+// socket I/O engine: asio or uring
+extern std::string ioEngine;
+
 extern int batchMode;
 std::string print_state(const std::vector<float>& state);
 
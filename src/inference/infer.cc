@@ -8,10 +8,14 @@
 #include <boost/asio.hpp>
 
 #include "define.hh"
+#include "io_uring.hh"
+#include "metrics.hh"
 #include "server.hh"
 #include "tf_inference.hh"
+#include "trace.hh"
 #include "udp_server.hh"
 #include "unix_socket_server.hh"
+#include "uring_server.hh"
 
 void signal_handler(int sig) {
   std::cout << "Signal " << sig << " received" << std::endl;
@@ -21,7 +25,10 @@ void signal_handler(int sig) {
 
 void usage_error(char** argv) {
   std::cerr << "Usage: " << argv[0] << " [-g|--graph] <graph-file> "
-            << "[-c|--checkpoint] <checkpoint-path> [-b|--batch] BATCH_MODE\n";
+            << "[-c|--checkpoint] <checkpoint-path> [-b|--batch] BATCH_MODE "
+            << "[-h|--channel] udp|unix [-i|--io] asio|uring "
+            << "[-t|--trace] <trace-file> "
+            << "[-m|--metrics] <socket-path>|<host:port>\n";
   exit(1);
 }
 
@@ -34,10 +41,16 @@ int main(int argc, char** argv) {
                          {"checkpoint", required_argument, nullptr, 'c'},
                          {"batch", optional_argument, nullptr, 'b'},
                          {"channel", optional_argument, nullptr, 'h'},
+                         {"io", required_argument, nullptr, 'i'},
+                         {"trace", required_argument, nullptr, 't'},
+                         {"metrics", required_argument, nullptr, 'm'},
                          {0, 0, nullptr, 0}};
 
+  std::string trace_path;
+  std::string metrics_address;
   int opt;
-  while ((opt = getopt_long(argc, argv, "b:g:c:h:", opts, nullptr)) != -1) {
+  while ((opt = getopt_long(argc, argv, "b:g:c:h:i:t:m:", opts, nullptr)) !=
+         -1) {
     switch (opt) {
     case 'b':
       batchMode = atoi(optarg);
@@ -51,6 +64,15 @@ int main(int argc, char** argv) {
     case 'h':
       channel = optarg;
       break;
+    case 'i':
+      ioEngine = optarg;
+      break;
+    case 't':
+      trace_path = optarg;
+      break;
+    case 'm':
+      metrics_address = optarg;
+      break;
     case '?':
       usage_error(argv);
       return 1;
@@ -66,6 +88,14 @@ int main(int argc, char** argv) {
     std::cout << "Batch mode enabled" << std::endl;
   }
   std::cout << "Communication Channel: " << channel << std::endl;
+  if (ioEngine == "uring" && !IOUring::available()) {
+    std::cerr << "io_uring is not available, falling back to asio"
+              << std::endl;
+    ioEngine = "asio";
+  } else if (ioEngine != "asio" && ioEngine != "uring") {
+    usage_error(argv);
+  }
+  std::cout << "I/O Engine: " << ioEngine << std::endl;
   signal(SIGTERM, signal_handler);
   signal(SIGINT, signal_handler);
 
@@ -75,10 +105,27 @@ int main(int argc, char** argv) {
     auto state = input;
     TFInference::Get()->inference_imdt(0, std::move(state), [](float, const std::string&) {});
   }
+  // start tracing after the warm-up, which is not part of any control step
+  if (!trace_path.empty()) {
+#ifndef ENABLE_TRACE
+    std::cerr << "Built without ENABLE_TRACE, " << trace_path
+              << " will hold no control steps" << std::endl;
+#endif
+    trace::enable(trace_path);
+  }
   // launch UDP server
   try {
+    // scraped from its own thread for as long as the server runs
+    std::unique_ptr<MetricsServer> metrics_server;
+    if (!metrics_address.empty()) {
+      metrics_server = std::make_unique<MetricsServer>(metrics_address);
+      std::cout << "Metrics: " << metrics_address << std::endl;
+    }
     boost::asio::io_service io_service;
-    if (channel == "udp") {
+    if (ioEngine == "uring") {
+      UringServer server(channel);
+      server.start();
+    } else if (channel == "udp") {
       UdpServer server(io_service);
       server.start();
       io_service.run();
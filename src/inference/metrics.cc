@@ -0,0 +1,158 @@
+#include "metrics.hh"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+
+#include "address.hh"
+#include "ipc_socket.hh"
+#include "socket.hh"
+
+void MetricHistogram::observe(uint64_t value) {
+  buckets_[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+}
+
+size_t MetricHistogram::bucket_index(uint64_t value) {
+  if (value < kSubCount) {
+    return value;
+  }
+  // value >> shift lies in [kSubCount, 2 * kSubCount)
+  const unsigned int shift = 63 - __builtin_clzll(value) - kSubBits;
+  const size_t index = (shift + 1) * kSubCount + ((value >> shift) - kSubCount);
+  return std::min(index, kBuckets);
+}
+
+uint64_t MetricHistogram::bucket_highest(size_t index) {
+  if (index < kSubCount) {
+    return index;
+  }
+  const unsigned int shift = index / kSubCount - 1;
+  return ((kSubCount + index % kSubCount + 1) << shift) - 1;
+}
+
+void MetricHistogram::render(const std::string& name, const std::string& help,
+                             std::string& out) const {
+  out += "# HELP " + name + " " + help + "\n";
+  out += "# TYPE " + name + " histogram\n";
+  // the buckets are read one by one while others keep updating them, so the
+  // count is derived from the same reads to keep +Inf and _count equal
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i < kBuckets; ++i) {
+    cumulative += buckets_[i].load(std::memory_order_relaxed);
+    out += name + "_bucket{le=\"" + std::to_string(bucket_highest(i)) +
+           "\"} " + std::to_string(cumulative) + "\n";
+  }
+  cumulative += buckets_[kBuckets].load(std::memory_order_relaxed);
+  out += name + "_bucket{le=\"+Inf\"} " + std::to_string(cumulative) + "\n";
+  out += name + "_sum " +
+         std::to_string(sum_.load(std::memory_order_relaxed)) + "\n";
+  out += name + "_count " + std::to_string(cumulative) + "\n";
+}
+
+namespace {
+
+void render_counter(const std::string& name, const std::string& help,
+                    const Counter& counter, std::string& out) {
+  out += "# HELP " + name + " " + help + "\n";
+  out += "# TYPE " + name + " counter\n";
+  out += name + " " + std::to_string(counter.value()) + "\n";
+}
+
+void render_gauge(const std::string& name, const std::string& help,
+                  const Gauge& gauge, std::string& out) {
+  out += "# HELP " + name + " " + help + "\n";
+  out += "# TYPE " + name + " gauge\n";
+  out += name + " " + std::to_string(gauge.value()) + "\n";
+}
+
+// answer one scrape, whatever was asked for
+template <typename Connection>
+void respond(Connection&& connection) {
+  connection.read();
+  const std::string body = Metrics::Get()->render();
+  connection.write(
+      "HTTP/1.1 200 OK\r\n"
+      "Content-Type: text/plain; version=0.0.4\r\n"
+      "Content-Length: " +
+      std::to_string(body.size()) +
+      "\r\n"
+      "Connection: close\r\n\r\n" +
+      body);
+}
+
+}  // namespace
+
+std::string Metrics::render() const {
+  std::string out;
+  render_counter("astraea_requests_total", "Inference requests received.",
+                 requests, out);
+  render_counter("astraea_replies_total", "Actions sent back to flows.",
+                 replies, out);
+  render_counter("astraea_reply_errors_total", "Actions that failed to send.",
+                 reply_errors, out);
+  render_counter("astraea_flow_starts_total", "Flows registered.", flow_starts,
+                 out);
+  render_counter("astraea_flow_ends_total", "Flows removed.", flow_ends, out);
+  render_gauge("astraea_active_flows", "Flows currently registered.",
+               active_flows, out);
+  batch_size.render("astraea_batch_size", "Requests per inference batch.",
+                    out);
+  queue_wait_us.render("astraea_queue_wait_us",
+                       "Time from submission to the start of the batch.",
+                       out);
+  inference_time_us.render("astraea_inference_time_us",
+                           "Model run time of one batch.", out);
+  reply_time_us.render("astraea_reply_time_us",
+                       "Time to hand one reply to the socket.", out);
+  action_latency_us.render(
+      "astraea_action_latency_us",
+      "Time from submission until the reply is handed to the socket.", out);
+  return out;
+}
+
+MetricsServer::MetricsServer(const std::string& address) {
+  const auto colon = address.rfind(':');
+  if (colon == std::string::npos) {
+    ::unlink(address.c_str());
+    unix_listener_ = std::make_unique<IPCSocket>();
+    unix_listener_->bind(address);
+    unix_listener_->listen();
+  } else {
+    tcp_listener_ = std::make_unique<TCPSocket>();
+    tcp_listener_->set_reuseaddr();
+    tcp_listener_->bind(Address(address.substr(0, colon),
+                                std::stoi(address.substr(colon + 1))));
+    tcp_listener_->listen();
+  }
+  thread_ = std::thread(&MetricsServer::serve, this);
+}
+
+MetricsServer::~MetricsServer() {
+  keep_running_ = false;
+  // wakes up the blocked accept()
+  if (unix_listener_) {
+    ::shutdown(unix_listener_->fd_num(), SHUT_RDWR);
+  } else {
+    ::shutdown(tcp_listener_->fd_num(), SHUT_RDWR);
+  }
+  thread_.join();
+}
+
+void MetricsServer::serve() {
+  while (keep_running_.load()) {
+    try {
+      if (unix_listener_) {
+        respond(unix_listener_->accept());
+      } else {
+        respond(tcp_listener_->accept());
+      }
+    } catch (const std::exception& e) {
+      if (keep_running_.load()) {
+        std::cerr << "Metrics: " << e.what() << std::endl;
+      }
+    }
+  }
+}
@@ -0,0 +1,114 @@
+#ifndef METRICS_HH
+#define METRICS_HH
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+// net sockets pull in <linux/tcp.h>, which clashes with boost::asio
+class IPCSocket;
+class TCPSocket;
+
+// monotonically increasing count, e.g. of requests
+class Counter {
+ public:
+  void add(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+  uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<uint64_t> value_{0};
+};
+
+// value that goes up and down, e.g. active flows
+class Gauge {
+ public:
+  void add(int64_t n) { value_.fetch_add(n, std::memory_order_relaxed); }
+  int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<int64_t> value_{0};
+};
+
+// log-linear histogram that any thread can update without a lock. Values
+// below 4 are counted exactly; above that, every power of two is split into
+// 4 buckets, so a bucket is at most 25% wide. Values from 2^26 on are only
+// counted in the +Inf bucket.
+class MetricHistogram {
+ public:
+  void observe(uint64_t value);
+
+  // append the histogram in Prometheus text format
+  void render(const std::string& name, const std::string& help,
+              std::string& out) const;
+
+ private:
+  static constexpr unsigned int kSubBits = 2;
+  static constexpr uint64_t kSubCount = uint64_t(1) << kSubBits;
+  static constexpr unsigned int kMaxValueBits = 26;
+  static constexpr size_t kBuckets = (kMaxValueBits - kSubBits + 1) * kSubCount;
+
+  static size_t bucket_index(uint64_t value);
+  static uint64_t bucket_highest(size_t index);
+
+  // the last bucket counts values beyond the highest bound
+  std::array<std::atomic<uint64_t>, kBuckets + 1> buckets_{};
+  std::atomic<uint64_t> sum_{0};
+};
+
+// everything the inference service exports. Updates are relaxed atomic
+// operations, so a scrape never blocks the batch inference thread.
+class Metrics {
+ public:
+  static Metrics* Get() {
+    static Metrics metrics;
+    return &metrics;
+  }
+
+  // all metrics in Prometheus text format
+  std::string render() const;
+
+  Counter requests{};
+  Counter replies{};
+  Counter reply_errors{};
+  Counter flow_starts{};
+  Counter flow_ends{};
+  Gauge active_flows{};
+
+  MetricHistogram batch_size{};
+  // from submission to the start of the batch
+  MetricHistogram queue_wait_us{};
+  // model run of one batch
+  MetricHistogram inference_time_us{};
+  // handing one reply to the socket
+  MetricHistogram reply_time_us{};
+  // from submission until the reply is handed to the socket
+  MetricHistogram action_latency_us{};
+
+ private:
+  Metrics() = default;
+  Metrics(const Metrics&) = delete;
+  Metrics& operator=(const Metrics&) = delete;
+};
+
+// Serves Metrics::render() over HTTP on a background thread, so that
+// Prometheus (or curl --unix-socket) can scrape it. Each connection gets
+// one response and is closed.
+class MetricsServer {
+ public:
+  // address is either a UNIX socket path or host:port
+  explicit MetricsServer(const std::string& address);
+  ~MetricsServer();
+
+ private:
+  void serve();
+
+  std::unique_ptr<IPCSocket> unix_listener_{};
+  std::unique_ptr<TCPSocket> tcp_listener_{};
+  std::atomic<bool> keep_running_{true};
+  std::thread thread_{};
+};
+
+#endif  // METRICS_HH
@@ -5,6 +5,8 @@
 
 #include "context.hh"
 #include "define.hh"
+#include "metrics.hh"
+#include "trace.hh"
 
 class FlowContext;
 class Server {
@@ -26,6 +28,8 @@ class Server {
     }
     delete flow_contexts[flow_id];
     flow_contexts.erase(flow_id);
+    Metrics::Get()->flow_ends.add();
+    Metrics::Get()->active_flows.add(-1);
   }
 
  protected:
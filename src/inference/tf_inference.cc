@@ -1,7 +1,11 @@
+#include <algorithm>
 #include <thread>
 
 #include "define.hh"
+#include "metrics.hh"
 #include "tf_inference.hh"
+#include "timestamp.hh"
+#include "trace.hh"
 // TFInference* tf_infer_session = nullptr;
 
 TFInference::TFInference(const std::string& graph_path,
@@ -35,48 +39,64 @@ void TFInference::inference_loop() {
       // inference_req_queue_.clear();
     }
     if (requests.size() > 0) {
+      auto metrics = Metrics::Get();
       std::vector<std::vector<float>> states;
-      std::vector<int> flow_ids;
+      const uint64_t batch_start_us = monotonic_usecs();
       for (auto& req : requests) {
-        flow_ids.push_back(req.first);
-        states.push_back(req.second);
+        states.push_back(req.state);
+        metrics->queue_wait_us.observe(batch_start_us - req.submit_us);
+        TRACE_STEP(BatchStart, req.flow_id, req.step);
       }
       std::vector<float> actions = batch_inference(states);
-      for (size_t i = 0; i < flow_ids.size(); ++i) {
-        send_reply(flow_ids[i], actions[i]);
+      metrics->inference_time_us.observe(monotonic_usecs() - batch_start_us);
+      metrics->batch_size.observe(requests.size());
+      for (auto& req : requests) {
+        TRACE_STEP(InferenceEnd, req.flow_id, req.step);
+      }
+      reply_batch_size_ = requests.size();
+      for (size_t i = 0; i < requests.size(); ++i) {
+        send_reply(requests[i].flow_id, actions[i], requests[i].submit_us);
       }
     }
     std::this_thread::sleep_for(std::chrono::microseconds(kBatchInterval));
   }
 }
 
-void TFInference::send_reply(int flow_id, float action) {
+void TFInference::send_reply(int flow_id, float action, uint64_t submit_us) {
+  auto metrics = Metrics::Get();
   std::lock_guard<std::mutex> lock(mutex_);
   auto& send_response = flow_callbacks_[flow_id];
+  const uint64_t reply_start_us = monotonic_usecs();
   try{
     send_response(action, "");
+    metrics->replies.add();
   } catch (const std::exception& e) {
+    metrics->reply_errors.add();
     std::cerr << "Error sending response: " << e.what() << std::endl;
   }
+  const uint64_t reply_end_us = monotonic_usecs();
+  metrics->reply_time_us.observe(reply_end_us - reply_start_us);
+  metrics->action_latency_us.observe(reply_end_us - submit_us);
   flow_callbacks_.erase(flow_id);
 }
 
 float TFInference::inference_imdt(int flow_id, std::vector<float>&& state,
-                                  ResponseCallback&& send_response) {
+                                  ResponseCallback&& send_response,
+                                  uint64_t step) {
+  auto metrics = Metrics::Get();
+  const uint64_t submit_us = monotonic_usecs();
+  metrics->requests.add();
   register_flow_callback(flow_id, send_response);
-#ifdef PROFILE
-  auto start = std::chrono::high_resolution_clock::now();
-#endif
   std::vector<std::vector<float>> states = {state};
   tensorflow::Tensor input = prepare_batch_input(states);
   std::vector<tensorflow::Tensor> output;
-  auto start = std::chrono::high_resolution_clock::now();
+  const uint64_t start_us = monotonic_usecs();
+  TRACE_STEP(BatchStart, flow_id, step);
   internal_inference(input, output);
-  auto end = std::chrono::high_resolution_clock::now();
-  auto duration =
-      std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-// std::cout << "Inference time: " << duration.count() << " microseconds"
-          // << std::endl;
+  TRACE_STEP(InferenceEnd, flow_id, step);
+  metrics->queue_wait_us.observe(start_us - submit_us);
+  metrics->inference_time_us.observe(monotonic_usecs() - start_us);
+  metrics->batch_size.observe(1);
   float action = output[0].flat<float>().data()[0];
 #ifdef DEBUG
   std::cout << "Inference: "
@@ -84,24 +104,31 @@ float TFInference::inference_imdt(int flow_id, std::vector<float>&& state,
             << ", action: " << action << std::endl;
 #endif
 
-  send_reply(flow_id, action);
-#ifdef PROFILE
-  auto end = std::chrono::high_resolution_clock::now();
-  auto duration =
-      std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-  std::cout << "Inference time: " << duration.count() << " microseconds"
-            << std::endl;
-#endif
+  reply_batch_size_ = 1;
+  send_reply(flow_id, action, submit_us);
   return action;
 }
 
+float TFInference::inference_sync(const std::vector<float>& state) {
+  tensorflow::Tensor input(tensorflow::DT_FLOAT,
+                           tensorflow::TensorShape({1, kNNInputSize}));
+  std::copy_n(state.begin(), kNNInputSize, input.flat<float>().data());
+  std::vector<tensorflow::Tensor> output;
+  internal_inference(input, output);
+  return output[0].flat<float>()(0);
+}
+
 void TFInference::submit_inference_request(int flow_id,
                                            std::vector<float>&& state,
-                                           ResponseCallback&& send_response) {
+                                           ResponseCallback&& send_response,
+                                           uint64_t step) {
+  const uint64_t submit_us = monotonic_usecs();
+  Metrics::Get()->requests.add();
   // store the inference request
   std::lock_guard<std::mutex> lock(mutex_);
   register_flow_callback(flow_id, std::move(send_response));
-  inference_req_queue_.push_back({flow_id, state});
+  inference_req_queue_.push_back({flow_id, step, submit_us, state});
+  TRACE_STEP(Enqueue, flow_id, step);
   cv_.notify_all();
 }
 
@@ -37,8 +37,10 @@ class TFInference {
   ~TFInference() { delete session_; }
 
  public:
+  // step is the control step of the request, only used for tracing
   void submit_inference_request(int flow_id, std::vector<float>&& state,
-                                ResponseCallback&& send_response);
+                                ResponseCallback&& send_response,
+                                uint64_t step = 0);
   /**
    * @brief Perform the inference immediately and send the response back
    *
@@ -47,7 +49,16 @@ class TFInference {
    * @return float
    */
   float inference_imdt(int flow_id, std::vector<float>&& state,
-                       ResponseCallback&& send_response);
+                       ResponseCallback&& send_response, uint64_t step = 0);
+  /**
+   * @brief Perform the inference on the caller's thread and return the action
+   * Nothing is queued or replied, so flows sharing the model may call it
+   * concurrently (used by client_eval's in-process mode).
+   *
+   * @param state
+   * @return float
+   */
+  float inference_sync(const std::vector<float>& state);
 
  private:
   /**
@@ -73,20 +84,29 @@ class TFInference {
   int internal_inference(const tensorflow::Tensor& data,
                          std::vector<tensorflow::Tensor>& output);
 
-  void send_reply(int flow_id, float action);
+  // submit_us is when the request was submitted, for the latency metrics
+  void send_reply(int flow_id, float action, uint64_t submit_us);
 
   int create_session();
 
   tensorflow::Status LoadModel(tensorflow::Session* sess, std::string graph_fn,
                                std::string checkpoint_fn = "");
 
+  // size of the batch whose replies are being sent, 1 outside batch mode
+  size_t reply_batch_size() const { return reply_batch_size_.load(); }
+
   inline void register_flow_callback(int flow_id,
                                      ResponseCallback send_response) {
     flow_callbacks_[flow_id] = send_response;
   }
 
  private:
-  using InferenceRequest = std::pair<int, std::vector<float>>;
+  struct InferenceRequest {
+    int flow_id;
+    uint64_t step;
+    uint64_t submit_us;
+    std::vector<float> state;
+  };
   tensorflow::Session* session_;
   // for batch inference
   std::vector<InferenceRequest> inference_req_queue_;
@@ -98,6 +118,7 @@ class TFInference {
   std::thread* inference_thread_;
   // flag to indicate whether stop 
   std::atomic<bool> keep_running_ = true;
+  std::atomic<size_t> reply_batch_size_ = 1;
 };
 
 #endif  // TF_INFERENCE_HH
\ No newline at end of file
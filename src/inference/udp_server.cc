@@ -25,6 +25,8 @@ void UdpServer::handle_flow_init(int& flow_id,
     //           << std::endl;
   }
   flow_contexts[flow_id] = new FlowContext(flow_id);
+  Metrics::Get()->flow_starts.add();
+  Metrics::Get()->active_flows.add(1);
   json reply;
   reply["flow_id"] = flow_id;
   response = reply.dump();
@@ -38,13 +40,15 @@ void UdpServer::handle_congestion_control(int flow_id, json& data,
     return;
   }
   auto context = flow_contexts[flow_id];
+  const uint64_t step = request_step(data);
+  TRACE_STEP(ServerReceive, flow_id, step);
   auto state = context->format_state(data["state"]);
   if (!batchMode) {
     TFInference::Get()->inference_imdt(flow_id, std::move(state),
-                                       std::move(send_response));
+                                       std::move(send_response), step);
   } else {
-    TFInference::Get()->submit_inference_request(flow_id, std::move(state),
-                                                 std::move(send_response));
+    TFInference::Get()->submit_inference_request(
+        flow_id, std::move(state), std::move(send_response), step);
   }
 }
 
@@ -108,7 +112,9 @@ void UdpServer::send_response(boost::asio::ip::udp::endpoint remote_endpoint,
     json reply;
     reply["cwnd"] = new_cwnd;
     reply["flow_id"] = data["flow_id"];
+    tag_reply(data, reply);
     response = put_field(reply.dump().length()) + reply.dump();
+    TRACE_STEP(ReplySend, data["flow_id"].get<int>(), request_step(data));
   }
 #ifdef DEBUG
   std::cout << "Original cwnd: " << cwnd << ", action: " << action
@@ -35,72 +35,61 @@ boost::asio::local::stream_protocol::socket& Session::socket() {
 }
 
 void Session::start() {
-  boost::asio::async_read(
-      socket_,
-      boost::asio::buffer(message_length_buffer_.data(),
-                          sizeof(message_length_)),
-      boost::bind(&Session::handle_read_length, shared_from_this(),
-                  boost::asio::placeholders::error));
+  socket_.async_read_some(
+      boost::asio::buffer(frames_.write_area(), frames_.writable()),
+      boost::bind(&Session::handle_read, shared_from_this(),
+                  boost::asio::placeholders::error,
+                  boost::asio::placeholders::bytes_transferred));
 }
 
-void Session::handle_read_length(const boost::system::error_code& error) {
-  message_length_ = get_uint16(message_length_buffer_.data());
-  if (!error) {
-    boost::asio::async_read(
-        socket_, boost::asio::buffer(recv_buffer_.data(), message_length_),
-        boost::bind(&Session::handle_read_message, shared_from_this(),
-                    boost::asio::placeholders::error, message_length_));
-  } else {
-    std::cerr << "Error reading message length: " << error.message()
-              << std::endl;
+void Session::handle_read(const boost::system::error_code& error,
+                          std::size_t bytes_transferred) {
+  if (error) {
+    std::cerr << "Error reading message: " << error.message() << std::endl;
+    return;
+  }
+  frames_.commit(bytes_transferred);
+  while (const auto message = frames_.pop()) {
+    if (!handle_message(*message)) {
+      // close this socket
+      socket_.close();
+      return;
+    }
   }
+  start();
 }
 
-void Session::handle_read_message(const boost::system::error_code& error,
-                                  std::size_t expected_length) {
-  bool stop = false;
-  if (!error) {
-    std::string message(recv_buffer_.data(), expected_length);
-    // std::cout << "Received message: " << message << std::endl;
-    std::string response;
-    json data = json::parse(message);
+bool Session::handle_message(std::string_view message) {
+  // std::cout << "Received message: " << message << std::endl;
+  json data = json::parse(message.begin(), message.end());
 #ifdef DEBUG
-    std::cout << "Received message: " << std::endl;
-    std::cout << data.dump(4) << std::endl;
+  std::cout << "Received message: " << std::endl;
+  std::cout << data.dump(4) << std::endl;
 #endif
-    MessageType type = data.at("type");
-    int flow_id = data.at("flow_id");
-    ResponseCallback send_response =
-        std::bind(&Session::send_response, this, data, std::placeholders::_1,
-                  std::placeholders::_2);
-    switch (type) {
-    case MessageType::START: {
-      std::cout << "Register flow " << flow_id << std::endl;
-      handle_flow_init(flow_id, std::move(send_response));
-      break;
-    }
-    case MessageType::ALIVE: {
-      handle_congestion_control(flow_id, data, std::move(send_response));
-      break;
-    }
-    case MessageType::END: {
-      std::cout << "Remove flow " << flow_id << std::endl;
-      handle_flow_removal(flow_id);
-      stop = true;
-      break;
-    }
-    default:
-      break;
-    }
-    if (!stop) {
-      start();
-    } else {
-      // close this socket
-      socket_.close();
-    }
-  } else {
-    std::cerr << "Error reading message: " << error.message() << std::endl;
+  MessageType type = data.at("type");
+  int flow_id = data.at("flow_id");
+  ResponseCallback send_response =
+      std::bind(&Session::send_response, this, data, std::placeholders::_1,
+                std::placeholders::_2);
+  switch (type) {
+  case MessageType::START: {
+    std::cout << "Register flow " << flow_id << std::endl;
+    handle_flow_init(flow_id, std::move(send_response));
+    break;
+  }
+  case MessageType::ALIVE: {
+    handle_congestion_control(flow_id, data, std::move(send_response));
+    break;
+  }
+  case MessageType::END: {
+    std::cout << "Remove flow " << flow_id << std::endl;
+    handle_flow_removal(flow_id);
+    return false;
+  }
+  default:
+    break;
   }
+  return true;
 }
 
 void Session::handle_flow_init(int& flow_id, ResponseCallback&& send_response) {
@@ -110,6 +99,8 @@ void Session::handle_flow_init(int& flow_id, ResponseCallback&& send_response) {
     flow_id = rand();
   }
   flow_contexts[flow_id] = new FlowContext(flow_id);
+  Metrics::Get()->flow_starts.add();
+  Metrics::Get()->active_flows.add(1);
   json reply;
   reply["flow_id"] = flow_id;
   std::string response = reply.dump();
@@ -124,13 +115,15 @@ void Session::handle_congestion_control(int flow_id, json& data,
     return;
   }
   auto context = flow_contexts[flow_id];
+  const uint64_t step = request_step(data);
+  TRACE_STEP(ServerReceive, flow_id, step);
   auto state = context->format_state(data["state"]);
   if (!batchMode) {
     TFInference::Get()->inference_imdt(flow_id, std::move(state),
-                                       std::move(send_response));
+                                       std::move(send_response), step);
   } else {
-    TFInference::Get()->submit_inference_request(flow_id, std::move(state),
-                                                 std::move(send_response));
+    TFInference::Get()->submit_inference_request(
+        flow_id, std::move(state), std::move(send_response), step);
   }
 }
 
@@ -149,7 +142,9 @@ void Session::send_response(const json data, float action,
     json reply;
     reply["cwnd"] = new_cwnd;
     reply["flow_id"] = data["flow_id"];
+    tag_reply(data, reply);
     response = put_field(reply.dump().length()) + reply.dump();
+    TRACE_STEP(ReplySend, data["flow_id"].get<int>(), request_step(data));
   }
 #ifdef DEBUG
   std::cout << "Original cwnd: " << cwnd << ", action: " << action
@@ -2,10 +2,12 @@
 #define UNIX_SOCKET_SERVER_HH
 
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
 
+#include "frame_codec.hh"
 #include "server.hh"
 
 class UnixSocketServer;
@@ -28,16 +30,16 @@ class Session : public std::enable_shared_from_this<Session>, Server {
   virtual void handle_flow_removal(int flow_id) override;
 
  private:
-  void handle_read_length(const boost::system::error_code& error);
-  void handle_read_message(const boost::system::error_code& error,
-                           std::size_t expected_length);
+  void handle_read(const boost::system::error_code& error,
+                   std::size_t bytes_transferred);
+  // returns false once the flow has ended
+  bool handle_message(std::string_view message);
   void send_response(const json data, float action, const std::string& info);
 
  private:
   boost::asio::local::stream_protocol::socket socket_;
-  std::array<char, 1024> recv_buffer_;
-  std::array<char, 2> message_length_buffer_;
-  uint16_t message_length_;
+  // received bytes; one read may bring in several messages
+  FrameBuffer frames_;
   // per flow inference context
   UnixSocketServer* server_;
 };
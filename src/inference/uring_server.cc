@@ -0,0 +1,363 @@
+#include "uring_server.hh"
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "exception.hh"
+#include "ipc_socket.hh"
+#include "serialization.hh"
+#include "socket.hh"
+
+UringServer::UringServer(const std::string& channel,
+                         const std::string& socket_path)
+    : Server(),
+      use_udp_(channel == "udp"),
+      ring_(kRingEntries),
+      recv_header_(),
+      wakeup_fd_(CheckSystemCall("eventfd", eventfd(0, EFD_CLOEXEC))) {
+  if (channel != "udp" && channel != "unix") {
+    throw std::runtime_error("Unknown communication channel: " + channel);
+  }
+  ring_.setup_buffer_ring(kBufferCount, kBufferSize);
+
+  if (use_udp_) {
+    udp_socket_ = std::make_unique<UDPSocket>();
+    udp_socket_->bind(Address("0.0.0.0", PORT));
+    recv_header_.msg_namelen = sizeof(sockaddr_storage);
+  } else {
+    ::unlink(socket_path.c_str());
+    listener_ = std::make_unique<IPCSocket>();
+    listener_->bind(socket_path);
+    listener_->listen();
+  }
+}
+
+UringServer::~UringServer() {}
+
+void UringServer::start() {
+  loop_thread_ = std::this_thread::get_id();
+  if (use_udp_) {
+    ring_.prep_multishot_recvmsg(udp_socket_->fd_num(), &recv_header_,
+                                 make_user_data(Operation::RECVMSG, 0));
+  } else {
+    ring_.prep_multishot_accept(listener_->fd_num(),
+                                make_user_data(Operation::ACCEPT, 0));
+  }
+  arm_wakeup();
+
+  while (true) {
+    // one syscall submits every queued send and re-arm, then waits
+    ring_.submit_and_wait(1);
+    // the kernel holds its own reference to the sockets of what it was
+    // handed, so the closed ones can go now
+    closed_fds_.clear();
+    ring_.for_each_completion([this](const IOUring::Completion& completion) {
+      handle_completion(completion);
+    });
+  }
+}
+
+void UringServer::handle_completion(const IOUring::Completion& completion) {
+  const Operation op = Operation(completion.user_data >> 56);
+  const uint32_t value = completion.user_data & UINT32_MAX;
+  switch (op) {
+  case Operation::ACCEPT:
+    handle_accept(completion);
+    break;
+  case Operation::RECV:
+    handle_stream(value, completion);
+    break;
+  case Operation::RECVMSG:
+    handle_datagram(completion);
+    break;
+  case Operation::SEND: {
+    auto it = sends_in_flight_.find(value);
+    if (unlikely(completion.res < 0 ||
+                 std::size_t(completion.res) != it->second.data.length())) {
+      std::cerr << "io_uring Send Error: "
+                << (completion.res < 0 ? strerror(-completion.res)
+                                       : std::to_string(completion.res) +
+                                             " bytes sent")
+                << std::endl;
+    }
+    sends_in_flight_.erase(it);
+    break;
+  }
+  case Operation::WAKE:
+    handle_wakeup(completion);
+    break;
+  default:
+    break;
+  }
+}
+
+void UringServer::handle_accept(const IOUring::Completion& completion) {
+  if (completion.res >= 0) {
+    const uint32_t connection_id = next_connection_id_++;
+    connections_.emplace(connection_id,
+                         Connection{FileDescriptor(completion.res), "", false});
+    arm_receive(connection_id);
+  } else {
+    std::cerr << "Accept error: " << strerror(-completion.res) << std::endl;
+  }
+  if (!completion.more()) {
+    ring_.prep_multishot_accept(listener_->fd_num(),
+                                make_user_data(Operation::ACCEPT, 0));
+  }
+}
+
+void UringServer::handle_stream(uint32_t connection_id,
+                                const IOUring::Completion& completion) {
+  auto it = connections_.find(connection_id);
+  if (unlikely(it == connections_.end())) {
+    if (completion.has_buffer()) {
+      ring_.recycle_buffer(completion.buffer_id());
+    }
+    return;
+  }
+  Connection& connection = it->second;
+
+  if (completion.res > 0) {
+    connection.pending.append(ring_.buffer(completion.buffer_id()),
+                              completion.res);
+    ring_.recycle_buffer(completion.buffer_id());
+
+    // a receive may carry several messages, or only part of one
+    std::size_t offset = 0;
+    while (!connection.closing &&
+           connection.pending.size() - offset >= 2) {
+      const uint16_t length = get_uint16(connection.pending.data() + offset);
+      if (connection.pending.size() - offset - 2 < length) {
+        break;
+      }
+      Destination destination{connection_id, {}, 0};
+      if (!handle_message(connection.pending.data() + offset + 2, length,
+                          destination)) {
+        // END: stop receiving and close once the receive is cancelled
+        connection.closing = true;
+        ring_.prep_cancel(make_user_data(Operation::RECV, connection_id),
+                          make_user_data(Operation::CANCEL, connection_id));
+      }
+      offset += 2 + length;
+    }
+    connection.pending.erase(0, offset);
+  } else if (completion.res < 0 && completion.res != -ENOBUFS &&
+             completion.res != -ECANCELED) {
+    std::cerr << "Error reading message: " << strerror(-completion.res)
+              << std::endl;
+  }
+
+  if (!completion.more()) {
+    // EOF, error or cancellation close the connection. The buffer ring
+    // running dry, or the kernel ending a multishot receive that still
+    // carried data (e.g. when the CQ overflows), only need a new receive.
+    if ((completion.res == -ENOBUFS || completion.res > 0) &&
+        !connection.closing) {
+      arm_receive(connection_id);
+    } else {
+      close_connection(connection_id);
+    }
+  }
+}
+
+void UringServer::handle_datagram(const IOUring::Completion& completion) {
+  if (completion.res >= 0) {
+    const IOUring::Datagram datagram = IOUring::parse_datagram(
+        recv_header_, ring_.buffer(completion.buffer_id()), completion.res);
+    // check if the message is complete
+    if (datagram.truncated || datagram.payload_length < 2 ||
+        get_uint16(datagram.payload) != datagram.payload_length - 2) {
+      std::cout << "Incomplete message received" << std::endl;
+    } else {
+      Destination destination{0, {}, datagram.name_length};
+      std::memcpy(&destination.address, datagram.name, datagram.name_length);
+      handle_message(datagram.payload + 2, datagram.payload_length - 2,
+                     destination);
+    }
+    ring_.recycle_buffer(completion.buffer_id());
+  } else if (completion.res != -ENOBUFS) {
+    std::cerr << "UDP Receive Error: " << strerror(-completion.res)
+              << std::endl;
+  }
+
+  if (!completion.more()) {
+    ring_.prep_multishot_recvmsg(udp_socket_->fd_num(), &recv_header_,
+                                 make_user_data(Operation::RECVMSG, 0));
+  }
+}
+
+void UringServer::handle_wakeup(const IOUring::Completion&) {
+  std::vector<std::pair<Destination, std::string>> replies;
+  {
+    std::lock_guard<std::mutex> lock(outbox_mutex_);
+    replies.swap(outbox_);
+  }
+  for (auto& reply : replies) {
+    prep_send(OutgoingMessage{reply.first, std::move(reply.second), {}, {}});
+  }
+  arm_wakeup();
+}
+
+bool UringServer::handle_message(const char* data, std::size_t length,
+                                 const Destination& destination) {
+  json message = json::parse(data, data + length);
+#ifdef DEBUG
+  std::cout << "Received message: " << std::endl;
+  std::cout << message.dump(4) << std::endl;
+#endif
+  MessageType type = message.at("type");
+  int flow_id = message.at("flow_id");
+  ResponseCallback send_response =
+      std::bind(&UringServer::send_response, this, destination, message,
+                std::placeholders::_1, std::placeholders::_2);
+  switch (type) {
+  case MessageType::START: {
+    std::cout << "Register flow " << flow_id << std::endl;
+    handle_flow_init(flow_id, std::move(send_response));
+    break;
+  }
+  case MessageType::ALIVE: {
+    handle_congestion_control(flow_id, message, std::move(send_response));
+    break;
+  }
+  case MessageType::END: {
+    std::cout << "Remove flow " << flow_id << std::endl;
+    handle_flow_removal(flow_id);
+    return false;
+  }
+  default:
+    break;
+  }
+  return true;
+}
+
+void UringServer::handle_flow_init(int& flow_id,
+                                   ResponseCallback&& send_response) {
+  if (flow_contexts.find(flow_id) != flow_contexts.end()) {
+    std::cerr << "Flow " << flow_id << " already exists" << std::endl;
+    flow_id = rand();
+  }
+  flow_contexts[flow_id] = new FlowContext(flow_id);
+  Metrics::Get()->flow_starts.add();
+  Metrics::Get()->active_flows.add(1);
+  json reply;
+  reply["flow_id"] = flow_id;
+  std::string response = reply.dump();
+  send_response(-1, response);
+}
+
+void UringServer::handle_congestion_control(int flow_id, json& data,
+                                            ResponseCallback&& send_response) {
+  if (unlikely(flow_contexts.find(flow_id) == flow_contexts.end())) {
+    std::cerr << "Flow " << flow_id << " does not exist" << std::endl;
+    return;
+  }
+  auto context = flow_contexts[flow_id];
+  const uint64_t step = request_step(data);
+  TRACE_STEP(ServerReceive, flow_id, step);
+  auto state = context->format_state(data["state"]);
+  if (!batchMode) {
+    TFInference::Get()->inference_imdt(flow_id, std::move(state),
+                                       std::move(send_response), step);
+  } else {
+    TFInference::Get()->submit_inference_request(
+        flow_id, std::move(state), std::move(send_response), step);
+  }
+}
+
+void UringServer::send_response(const Destination destination,
+                                const json data, float action,
+                                const std::string& info) {
+  std::string response;
+  if (info != "") {
+    response = put_field(info.length()) + info;
+  } else {
+    int cwnd = data["state"]["cwnd"];
+    auto new_cwnd = map_action(action, cwnd);
+    json reply;
+    reply["cwnd"] = new_cwnd;
+    reply["flow_id"] = data["flow_id"];
+    tag_reply(data, reply);
+    response = put_field(reply.dump().length()) + reply.dump();
+    TRACE_STEP(ReplySend, data["flow_id"].get<int>(), request_step(data));
+  }
+  enqueue_send(destination, std::move(response));
+}
+
+void UringServer::enqueue_send(const Destination& destination,
+                               std::string&& response) {
+  if (std::this_thread::get_id() == loop_thread_) {
+    // goes out with the next io_uring_enter()
+    prep_send(OutgoingMessage{destination, std::move(response), {}, {}});
+    return;
+  }
+
+  bool was_empty;
+  {
+    std::lock_guard<std::mutex> lock(outbox_mutex_);
+    was_empty = outbox_.empty();
+    outbox_.emplace_back(destination, std::move(response));
+  }
+  // one wakeup per drained outbox
+  if (was_empty) {
+    const uint64_t one = 1;
+    SystemCall("eventfd write", ::write(wakeup_fd_.fd_num(), &one, sizeof(one)));
+  }
+}
+
+void UringServer::prep_send(OutgoingMessage&& message) {
+  int fd;
+  if (use_udp_) {
+    fd = udp_socket_->fd_num();
+  } else {
+    auto it = connections_.find(message.destination.connection_id);
+    if (it == connections_.end() || it->second.closing) {
+      // the flow ended before its reply was ready
+      return;
+    }
+    fd = it->second.fd.fd_num();
+  }
+
+  const uint32_t send_id = next_send_id_++;
+  // unordered_map never moves its elements, so the pointers stay valid
+  OutgoingMessage& outgoing =
+      sends_in_flight_.emplace(send_id, std::move(message)).first->second;
+  const uint64_t user_data = make_user_data(Operation::SEND, send_id);
+  if (use_udp_) {
+    outgoing.iov = {outgoing.data.data(), outgoing.data.length()};
+    outgoing.header = {};
+    outgoing.header.msg_name = &outgoing.destination.address;
+    outgoing.header.msg_namelen = outgoing.destination.address_length;
+    outgoing.header.msg_iov = &outgoing.iov;
+    outgoing.header.msg_iovlen = 1;
+    ring_.prep_sendmsg(fd, &outgoing.header, user_data);
+  } else {
+    ring_.prep_send(fd, outgoing.data.data(), outgoing.data.length(),
+                    user_data);
+  }
+}
+
+void UringServer::arm_receive(uint32_t connection_id) {
+  ring_.prep_multishot_recv(connections_.at(connection_id).fd.fd_num(),
+                            make_user_data(Operation::RECV, connection_id));
+}
+
+void UringServer::arm_wakeup() {
+  ring_.prep_read(wakeup_fd_, reinterpret_cast<char*>(&wakeup_count_),
+                  sizeof(wakeup_count_), make_user_data(Operation::WAKE, 0));
+}
+
+void UringServer::close_connection(uint32_t connection_id) {
+  // sends prepped earlier in this batch are still in the SQ and name the
+  // socket by number: closing it now would fail them with EBADF, or send
+  // them to a connection accepted meanwhile on the same number
+  auto it = connections_.find(connection_id);
+  if (it == connections_.end()) {
+    return;
+  }
+  closed_fds_.push_back(std::move(it->second.fd));
+  connections_.erase(it);
+}
@@ -0,0 +1,122 @@
+#ifndef URING_SERVER_HH
+#define URING_SERVER_HH
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "file_descriptor.hh"
+#include "io_uring.hh"
+#include "server.hh"
+
+// net sockets pull in <linux/tcp.h>, which clashes with boost::asio
+class IPCSocket;
+class UDPSocket;
+
+// Inference server on io_uring, serving either the UDP or the UNIX socket
+// channel. Requests arrive through multishot accept/recv/recvmsg on a
+// provided buffer ring, so a busy server makes one io_uring_enter() per
+// batch of messages instead of one syscall per message. Replies produced by
+// the batch inference thread are handed over through an eventfd read armed
+// on the same ring.
+class UringServer : public Server {
+ public:
+  UringServer(const std::string& channel,
+              const std::string& socket_path = "/tmp/astraea.sock");
+  virtual ~UringServer();
+
+  virtual void start() override;
+
+ protected:
+  virtual void handle_flow_init(int& flow_id,
+                                ResponseCallback&& send_response) override;
+  virtual void handle_congestion_control(
+      int flow_id, json& data, ResponseCallback&& send_response) override;
+
+ private:
+  // where a reply goes: a UNIX connection or a UDP peer
+  struct Destination {
+    uint32_t connection_id;
+    sockaddr_storage address;
+    socklen_t address_length;
+  };
+
+  struct Connection {
+    FileDescriptor fd;
+    // bytes of a message split across receives
+    std::string pending;
+    bool closing;
+  };
+
+  // a send in flight; the kernel reads from it until the completion
+  struct OutgoingMessage {
+    Destination destination;
+    std::string data;
+    iovec iov;
+    msghdr header;
+  };
+
+  enum class Operation : uint8_t { ACCEPT = 1, RECV, RECVMSG, SEND, WAKE, CANCEL };
+
+  static uint64_t make_user_data(Operation op, uint32_t value) {
+    return (uint64_t(op) << 56) | value;
+  }
+
+  void handle_completion(const IOUring::Completion& completion);
+  void handle_accept(const IOUring::Completion& completion);
+  void handle_stream(uint32_t connection_id,
+                     const IOUring::Completion& completion);
+  void handle_datagram(const IOUring::Completion& completion);
+  void handle_wakeup(const IOUring::Completion&);
+
+  // parse and dispatch one message; returns false after END
+  bool handle_message(const char* data, std::size_t length,
+                      const Destination& destination);
+
+  void send_response(const Destination destination, const json data,
+                     float action, const std::string& info);
+  // safe to call from any thread
+  void enqueue_send(const Destination& destination, std::string&& response);
+  void prep_send(OutgoingMessage&& message);
+
+  void arm_receive(uint32_t connection_id);
+  void arm_wakeup();
+  void close_connection(uint32_t connection_id);
+
+ private:
+  static const unsigned int kRingEntries = 256;
+  static const uint16_t kBufferCount = 256;
+  static const std::size_t kBufferSize = 2048;
+
+  bool use_udp_;
+  IOUring ring_;
+  std::unique_ptr<UDPSocket> udp_socket_{};
+  std::unique_ptr<IPCSocket> listener_{};
+  // only msg_namelen is read by the kernel for multishot recvmsg
+  msghdr recv_header_;
+
+  std::unordered_map<uint32_t, Connection> connections_{};
+  uint32_t next_connection_id_ = 0;
+  // sockets of closed connections, kept open until the sends queued for
+  // them in the same batch are submitted
+  std::vector<FileDescriptor> closed_fds_{};
+
+  std::unordered_map<uint32_t, OutgoingMessage> sends_in_flight_{};
+  uint32_t next_send_id_ = 0;
+
+  // replies from other threads
+  std::thread::id loop_thread_{};
+  std::mutex outbox_mutex_{};
+  std::vector<std::pair<Destination, std::string>> outbox_{};
+  FileDescriptor wakeup_fd_;
+  uint64_t wakeup_count_ = 0;
+};
+
+#endif  // URING_SERVER_HH
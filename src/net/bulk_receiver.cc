@@ -0,0 +1,118 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "bulk_receiver.hh"
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#include "exception.hh"
+#include "pipe.hh"
+
+using namespace std;
+
+BulkReceiver::Mode BulkReceiver::parse_mode(const string& name) {
+  if (name == "copy") {
+    return Mode::COPY;
+  } else if (name == "trunc") {
+    return Mode::TRUNC;
+  } else if (name == "splice") {
+    return Mode::SPLICE;
+  }
+  throw runtime_error("unknown receive mode: " + name);
+}
+
+string BulkReceiver::mode_name(const Mode mode) {
+  switch (mode) {
+  case Mode::COPY:
+    return "copy";
+  case Mode::TRUNC:
+    return "trunc";
+  case Mode::SPLICE:
+    return "splice";
+  }
+  return "unknown";
+}
+
+BulkReceiver::BulkReceiver(TCPSocket& sock, const Mode mode,
+                           ShardedCounter& counter, const size_t chunk_size)
+    : sock_(sock),
+      mode_(mode),
+      chunk_size_(chunk_size),
+      shard_(counter.shard()) {
+  if (chunk_size_ == 0) {
+    throw runtime_error("BulkReceiver: chunk size must be positive");
+  }
+
+  switch (mode_) {
+  case Mode::COPY:
+    buffer_.resize(chunk_size_);
+    break;
+  case Mode::TRUNC:
+    break;
+  case Mode::SPLICE: {
+    auto pipe = make_pipe();
+    pipe_read_ = make_unique<FileDescriptor>(move(pipe.first));
+    pipe_write_ = make_unique<FileDescriptor>(move(pipe.second));
+    /* as in BulkSender, the default pipe size stays if this is refused */
+    fcntl(pipe_write_->fd_num(), F_SETPIPE_SZ, int(chunk_size_));
+    null_ = make_unique<FileDescriptor>(
+        SystemCall("open /dev/null", open("/dev/null", O_WRONLY | O_CLOEXEC)));
+    break;
+  }
+  }
+}
+
+size_t BulkReceiver::receive(const uint64_t limit) {
+  const size_t length = min<uint64_t>(limit, chunk_size_);
+  if (length == 0) {
+    return 0;
+  }
+
+  size_t received = 0;
+  switch (mode_) {
+  case Mode::COPY:
+    received = SystemCall(
+        "recv", ::recv(sock_.fd_num(), buffer_.data(), length, 0));
+    break;
+  case Mode::TRUNC:
+    /* for TCP, the buffer may be null: the data is dropped, not copied */
+    received = SystemCall(
+        "recv", ::recv(sock_.fd_num(), nullptr, length, MSG_TRUNC));
+    break;
+  case Mode::SPLICE:
+    received = receive_splice(length);
+    break;
+  }
+  bytes_received_ += received;
+  shard_.add(received);
+  return received;
+}
+
+size_t BulkReceiver::receive_splice(const size_t length) {
+  const size_t received = SystemCall(
+      "splice from socket",
+      splice(sock_.fd_num(), nullptr, pipe_write_->fd_num(), nullptr, length,
+             SPLICE_F_MOVE));
+
+  /* drain the pipe so that it is empty for the next call */
+  size_t drained = 0;
+  while (drained < received) {
+    drained += SystemCall(
+        "splice to /dev/null",
+        splice(pipe_read_->fd_num(), nullptr, null_->fd_num(), nullptr,
+               received - drained, SPLICE_F_MOVE));
+  }
+  return received;
+}
+
+string BulkReceiver::summary(void) {
+  ostringstream out;
+  out << "received " << bytes_received_ << " bytes (" << mode_name(mode_)
+      << "), " << cost_.per_byte(bytes_received_);
+  return out.str();
+}
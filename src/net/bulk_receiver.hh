@@ -0,0 +1,73 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef BULK_RECEIVER_HH
+#define BULK_RECEIVER_HH
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "file_descriptor.hh"
+#include "sharded_counter.hh"
+#include "socket.hh"
+#include "thread_cost.hh"
+
+/* receives and discards a stream of bytes from a TCP socket, counting them.
+ *
+ * Modes:
+ *   copy:   recv() into one large buffer that is reused for every call
+ *   trunc:  recv() with MSG_TRUNC, which frees the data in the kernel
+ *           without copying it out
+ *   splice: splice() from the socket into a pipe and on into /dev/null
+ *
+ * Construct and use a BulkReceiver on one thread: it adds to that thread's
+ * shard of the counter, and summary() reports the cost of that thread (see
+ * ThreadCost). */
+class BulkReceiver {
+ public:
+  enum class Mode { COPY, TRUNC, SPLICE };
+
+  /* "copy", "trunc" or "splice" */
+  static Mode parse_mode(const std::string& name);
+  static std::string mode_name(const Mode mode);
+
+  BulkReceiver(TCPSocket& sock, const Mode mode, ShardedCounter& counter,
+               const size_t chunk_size = DEFAULT_CHUNK_SIZE);
+
+  /* receive at most min(limit, chunk size) bytes, blocking until some
+   * arrive; returns the number of bytes received, 0 at end of stream */
+  size_t receive(const uint64_t limit = UINT64_MAX);
+
+  uint64_t bytes_received(void) const { return bytes_received_; }
+
+  /* bytes received and CPU time and cycles per byte */
+  std::string summary(void);
+
+  /* forbid copying BulkReceiver objects or assigning them */
+  BulkReceiver(const BulkReceiver& other) = delete;
+  const BulkReceiver& operator=(const BulkReceiver& other) = delete;
+
+ private:
+  static constexpr size_t DEFAULT_CHUNK_SIZE = 256 * 1024;
+
+  TCPSocket& sock_;
+  const Mode mode_;
+  const size_t chunk_size_;
+  ShardedCounter::Shard& shard_;
+
+  /* copy */
+  std::vector<char> buffer_{};
+
+  /* splice: the pipe, and /dev/null to drain it into */
+  std::unique_ptr<FileDescriptor> pipe_read_{};
+  std::unique_ptr<FileDescriptor> pipe_write_{};
+  std::unique_ptr<FileDescriptor> null_{};
+
+  uint64_t bytes_received_{0};
+  ThreadCost cost_{};
+
+  size_t receive_splice(const size_t length);
+};
+
+#endif /* BULK_RECEIVER_HH */
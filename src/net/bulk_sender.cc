@@ -0,0 +1,241 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "bulk_sender.hh"
+
+#include <fcntl.h>
+#include <linux/errqueue.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <sstream>
+#include <stdexcept>
+
+#include "exception.hh"
+#include "pipe.hh"
+
+using namespace std;
+
+/* reap zero-copy completions once this many sends are outstanding */
+static constexpr uint32_t ZEROCOPY_BATCH = 32;
+
+BulkSender::Mode BulkSender::parse_mode(const string& name) {
+  if (name == "buffer") {
+    return Mode::BUFFER;
+  } else if (name == "zerocopy") {
+    return Mode::ZEROCOPY;
+  } else if (name == "sendfile") {
+    return Mode::SENDFILE;
+  } else if (name == "splice") {
+    return Mode::SPLICE;
+  }
+  throw runtime_error("unknown send mode: " + name);
+}
+
+string BulkSender::mode_name(const Mode mode) {
+  switch (mode) {
+  case Mode::BUFFER:
+    return "buffer";
+  case Mode::ZEROCOPY:
+    return "zerocopy";
+  case Mode::SENDFILE:
+    return "sendfile";
+  case Mode::SPLICE:
+    return "splice";
+  }
+  return "unknown";
+}
+
+BulkSender::BulkSender(TCPSocket& sock, const Mode mode,
+                       const size_t chunk_size, const string& source_path)
+    : sock_(sock),
+      mode_(mode),
+      chunk_size_(chunk_size) {
+  if (chunk_size_ == 0) {
+    throw runtime_error("BulkSender: chunk size must be positive");
+  }
+
+  switch (mode_) {
+  case Mode::BUFFER:
+    buffer_ = string(chunk_size_, 'a');
+    break;
+  case Mode::ZEROCOPY:
+    sock_.set_zerocopy();
+    buffer_ = string(chunk_size_, 'a');
+    break;
+  case Mode::SPLICE: {
+    auto pipe = make_pipe();
+    pipe_read_ = make_unique<FileDescriptor>(move(pipe.first));
+    pipe_write_ = make_unique<FileDescriptor>(move(pipe.second));
+    /* the default 64 KiB pipe would cap every splice; larger sizes may
+     * exceed fs.pipe-max-size, in which case the default stays */
+    fcntl(pipe_write_->fd_num(), F_SETPIPE_SZ, int(chunk_size_));
+    open_source(source_path);
+    break;
+  }
+  case Mode::SENDFILE:
+    open_source(source_path);
+    break;
+  }
+}
+
+void BulkSender::open_source(const string& source_path) {
+  if (source_path.empty()) {
+    source_ = make_unique<FileDescriptor>(
+        SystemCall("memfd_create", memfd_create("bulk_sender", MFD_CLOEXEC)));
+    source_->write(string(chunk_size_, 'a'));
+    source_size_ = chunk_size_;
+    return;
+  }
+
+  source_ = make_unique<FileDescriptor>(SystemCall(
+      "open " + source_path, open(source_path.c_str(), O_RDONLY | O_CLOEXEC)));
+  struct stat st;
+  SystemCall("fstat " + source_path, fstat(source_->fd_num(), &st));
+  if (st.st_size == 0) {
+    throw runtime_error(source_path + ": empty source file");
+  }
+  source_size_ = st.st_size;
+}
+
+size_t BulkSender::send(const uint64_t limit) {
+  const size_t length = min<uint64_t>(limit, chunk_size_);
+  if (length == 0) {
+    return 0;
+  }
+
+  size_t sent = 0;
+  switch (mode_) {
+  case Mode::BUFFER:
+    sent = send_buffer(length, 0);
+    break;
+  case Mode::ZEROCOPY:
+    sent = send_buffer(length, MSG_ZEROCOPY);
+    break;
+  case Mode::SENDFILE:
+    sent = send_file(length);
+    break;
+  case Mode::SPLICE:
+    sent = send_splice(length);
+    break;
+  }
+  bytes_sent_ += sent;
+  return sent;
+}
+
+size_t BulkSender::send_buffer(const size_t length, const int flags) {
+  while (true) {
+    const ssize_t sent = ::send(sock_.fd_num(), buffer_.data(), length, flags);
+    if (sent > 0) {
+      if (flags & MSG_ZEROCOPY) {
+        zerocopy_sends_++;
+        if (zerocopy_sends_ - zerocopy_completed_ >= ZEROCOPY_BATCH) {
+          reap_completions(false);
+        }
+      }
+      return sent;
+    } else if (sent == 0) {
+      throw runtime_error("send returned 0");
+    } else if (errno == ENOBUFS and (flags & MSG_ZEROCOPY)) {
+      /* too many pinned pages outstanding: wait for the kernel to let go */
+      reap_completions(true);
+    } else if (errno != EINTR) {
+      throw unix_error("send");
+    }
+  }
+}
+
+size_t BulkSender::send_file(const size_t length) {
+  const size_t count = min(length, source_size_ - size_t(source_offset_));
+  const ssize_t sent = SystemCall(
+      "sendfile",
+      sendfile(sock_.fd_num(), source_->fd_num(), &source_offset_, count));
+  if (sent == 0) {
+    throw runtime_error("sendfile returned 0");
+  }
+  if (size_t(source_offset_) == source_size_) {
+    source_offset_ = 0;
+  }
+  return sent;
+}
+
+size_t BulkSender::send_splice(const size_t length) {
+  if (piped_ == 0) {
+    const size_t count = min(chunk_size_, source_size_ - size_t(source_offset_));
+    piped_ = SystemCall("splice from source",
+                        splice(source_->fd_num(), &source_offset_,
+                               pipe_write_->fd_num(), nullptr, count,
+                               SPLICE_F_MOVE));
+    if (piped_ == 0) {
+      throw runtime_error("splice from source returned 0");
+    }
+    if (size_t(source_offset_) == source_size_) {
+      source_offset_ = 0;
+    }
+  }
+
+  const ssize_t sent = SystemCall(
+      "splice to socket",
+      splice(pipe_read_->fd_num(), nullptr, sock_.fd_num(), nullptr,
+             min(length, piped_), SPLICE_F_MOVE | SPLICE_F_MORE));
+  if (sent == 0) {
+    throw runtime_error("splice to socket returned 0");
+  }
+  piped_ -= sent;
+  return sent;
+}
+
+void BulkSender::reap_completions(const bool block) {
+  if (block) {
+    /* POLLERR is reported whether asked for or not */
+    pollfd pfd{sock_.fd_num(), 0, 0};
+    SystemCall("poll", poll(&pfd, 1, -1));
+  }
+
+  while (true) {
+    char control[128];
+    msghdr msg{};
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(sock_.fd_num(), &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+      if (errno == EAGAIN or errno == EINTR) {
+        return;
+      }
+      throw unix_error("recvmsg MSG_ERRQUEUE");
+    }
+
+    for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+      const auto* err =
+          reinterpret_cast<const sock_extended_err*>(CMSG_DATA(cm));
+      if (err->ee_origin != SO_EE_ORIGIN_ZEROCOPY or err->ee_errno != 0) {
+        continue;
+      }
+      /* sends [ee_info, ee_data] completed */
+      const uint64_t completed = err->ee_data - err->ee_info + 1;
+      zerocopy_completed_ += completed;
+      if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+        zerocopy_copied_ += completed;
+      }
+    }
+  }
+}
+
+string BulkSender::summary(void) {
+  if (mode_ == Mode::ZEROCOPY) {
+    reap_completions(false);
+  }
+
+  ostringstream out;
+  out << "sent " << bytes_sent_ << " bytes (" << mode_name(mode_) << "), "
+      << cost_.per_byte(bytes_sent_);
+  if (mode_ == Mode::ZEROCOPY) {
+    out << ", " << zerocopy_completed_ << "/" << zerocopy_sends_
+        << " zero-copy sends completed, " << zerocopy_copied_ << " copied";
+  }
+  return out.str();
+}
@@ -0,0 +1,93 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef BULK_SENDER_HH
+#define BULK_SENDER_HH
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "file_descriptor.hh"
+#include "socket.hh"
+#include "thread_cost.hh"
+
+/* sends an endless stream of filler bytes over a TCP socket.
+ *
+ * Modes:
+ *   buffer:   send() from one large buffer that is reused for every call
+ *   zerocopy: the same buffer with MSG_ZEROCOPY, reaping the completions
+ *             from the socket error queue; the buffer is never written
+ *             after construction, so it is safe to reuse before completion
+ *   sendfile: sendfile() from the source file
+ *   splice:   splice() from the source file into a pipe and on into the
+ *             socket
+ * The source of sendfile and splice is a file of filler bytes kept in memory
+ * (memfd) unless a path is given, in which case that file is sent over and
+ * over.
+ *
+ * Construct and use a BulkSender on one thread: summary() reports the cost
+ * of that thread (see ThreadCost). */
+class BulkSender {
+ public:
+  enum class Mode { BUFFER, ZEROCOPY, SENDFILE, SPLICE };
+
+  /* "buffer", "zerocopy", "sendfile" or "splice" */
+  static Mode parse_mode(const std::string& name);
+  static std::string mode_name(const Mode mode);
+
+  BulkSender(TCPSocket& sock, const Mode mode,
+             const size_t chunk_size = DEFAULT_CHUNK_SIZE,
+             const std::string& source_path = "");
+
+  /* send at most min(limit, chunk size) bytes, blocking until the socket
+   * takes some; returns the number of bytes sent */
+  size_t send(const uint64_t limit = UINT64_MAX);
+
+  uint64_t bytes_sent(void) const { return bytes_sent_; }
+
+  /* bytes sent, CPU time and cycles per byte, and zero-copy completions */
+  std::string summary(void);
+
+  /* forbid copying BulkSender objects or assigning them */
+  BulkSender(const BulkSender& other) = delete;
+  const BulkSender& operator=(const BulkSender& other) = delete;
+
+ private:
+  static constexpr size_t DEFAULT_CHUNK_SIZE = 256 * 1024;
+
+  TCPSocket& sock_;
+  const Mode mode_;
+  const size_t chunk_size_;
+
+  /* buffer and zerocopy */
+  std::string buffer_{};
+
+  /* sendfile and splice: the source and the offset to send from next */
+  std::unique_ptr<FileDescriptor> source_{};
+  size_t source_size_{0};
+  off_t source_offset_{0};
+
+  /* splice: the pipe, and the bytes sitting in it */
+  std::unique_ptr<FileDescriptor> pipe_read_{};
+  std::unique_ptr<FileDescriptor> pipe_write_{};
+  size_t piped_{0};
+
+  /* zerocopy: sends issued, sends completed, and completions for which the
+   * kernel copied the data after all */
+  uint64_t zerocopy_sends_{0};
+  uint64_t zerocopy_completed_{0};
+  uint64_t zerocopy_copied_{0};
+
+  uint64_t bytes_sent_{0};
+
+  ThreadCost cost_{};
+
+  void open_source(const std::string& source_path);
+  size_t send_buffer(const size_t length, const int flags);
+  size_t send_file(const size_t length);
+  size_t send_splice(const size_t length);
+  /* collect zero-copy completions; wait for at least one if `block` */
+  void reap_completions(const bool block);
+};
+
+#endif /* BULK_SENDER_HH */
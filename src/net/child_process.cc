@@ -15,6 +15,7 @@
 #include <string>
 
 #include "exception.hh"
+#include "logging.hh"
 #include "signalfd.hh"
 #include "system_runner.hh"
 
@@ -29,6 +30,9 @@ void zero(T& x) {
 int do_fork() {
   /* Verify that process is single-threaded before forking */
   {
+    /* the log's writer thread is the one we can stop */
+    StopLogThread();
+
     struct stat my_stat;
     CheckSystemCall("stat", stat("/proc/self/task", &my_stat));
 
@@ -0,0 +1,48 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "control_sample.hh"
+
+using namespace std;
+
+json ControlSample::to_json(void) const {
+  json data = info.to_json();
+  data["max_tput"] = max_tput;
+  data["max_tput_window"] = max_tput_window;
+  data["loss_ratio"] = loss_ratio;
+  data["time_delta"] = time_delta;
+  return data;
+}
+
+const vector<string>& ControlSample::perf_log_columns(void) {
+  static const vector<string> columns = {
+      "min_rtt",     "avg_urtt",        "cnt",
+      "srtt_us",     "avg_thr",         "thr_cnt",
+      "pacing_rate", "loss_bytes",      "packets_out",
+      "retrans_out", "max_packets_out", "CWND in Kernel",
+      "CWND to Assign"};
+  return columns;
+}
+
+string ControlSample::perf_log_header(void) {
+  string header;
+  for (const auto& column : perf_log_columns()) {
+    header += (header.empty() ? "" : "\t") + column;
+  }
+  return header;
+}
+
+void ControlSample::append_to(PerfLog& log, const u32 assigned_cwnd) const {
+  log.append(info.min_rtt, info.avg_urtt, info.cnt, info.srtt_us >> 3,
+             info.avg_thr, info.thr_cnt, info.pacing_rate, info.lost_bytes,
+             info.packets_out, info.retrans_out, info.max_packets_out,
+             info.cwnd, assigned_cwnd);
+}
+
+void ControlSample::write_tsv(ostream& out, const u32 assigned_cwnd) const {
+  out << info.min_rtt << "\t" << info.avg_urtt << "\t" << info.cnt << "\t"
+      << (info.srtt_us >> 3) << "\t" << info.avg_thr << "\t" << info.thr_cnt
+      << "\t" << info.pacing_rate << "\t" << info.lost_bytes << "\t"
+      << info.packets_out << "\t" << info.retrans_out << "\t"
+      << info.max_packets_out << "\t" << info.cwnd << "\t" << assigned_cwnd
+      << "\n";
+}
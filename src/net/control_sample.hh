@@ -0,0 +1,43 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef CONTROL_SAMPLE_HH
+#define CONTROL_SAMPLE_HH
+
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "json.hpp"
+#include "perf_log.hh"
+#include "tcp_info.hh"
+
+/* what a flow's controller sees at one step: the TCP state and what
+ * DeepCCSocket derives from it.
+ *
+ * Plain data, returned by value. Each consumer encodes the fields it needs
+ * in its own form: JSON for the Python helper and the inference service,
+ * a record for the perf log. Nothing is encoded on the way. */
+struct ControlSample {
+  TCPDeepCCInfo info;
+  u64 max_tput;        /* highest avg_thr over the window, bytes per second */
+  u64 max_tput_window; /* that window in us, 0 for the whole flow */
+  double loss_ratio;   /* lost bytes per second over time_delta */
+  u64 time_delta;      /* us since the previous sample of the same type */
+
+  /* the state as the Python helper and the inference service read it */
+  json to_json(void) const;
+
+  /* the columns of a perf log of control steps: the state (srtt in us),
+   * then the window assigned at this step, 0 if none */
+  static const std::vector<std::string>& perf_log_columns(void);
+  /* the tab-separated column names, which the TSV logs start with */
+  static std::string perf_log_header(void);
+  void append_to(PerfLog& log, const u32 assigned_cwnd) const;
+  void write_tsv(std::ostream& out, const u32 assigned_cwnd) const;
+};
+
+static_assert(std::is_trivially_copyable<ControlSample>::value,
+              "ControlSample must stay plain data");
+
+#endif /* CONTROL_SAMPLE_HH */
@@ -1,25 +1,15 @@
 #ifndef CURRENT_TIME_HH
 #define CURRENT_TIME_HH
 
-#include <chrono>
 #include <cstdint>
 
-inline uint64_t currentTime_milliseconds() {
-  return std::chrono::duration_cast<std::chrono::milliseconds>(
-             std::chrono::high_resolution_clock::now().time_since_epoch())
-      .count();
-}
+#include "timestamp.hh"
 
-inline uint64_t currentTime_microseconds() {
-  return std::chrono::duration_cast<std::chrono::microseconds>(
-             std::chrono::high_resolution_clock::now().time_since_epoch())
-      .count();
-}
+// monotonic, like every clock in timestamp.hh; not time since the epoch
+inline uint64_t currentTime_milliseconds() { return steady_nsecs() / 1000000; }
 
-inline uint64_t currentTime_nanoseconds() {
-  return std::chrono::duration_cast<std::chrono::nanoseconds>(
-             std::chrono::high_resolution_clock::now().time_since_epoch())
-      .count();
-}
+inline uint64_t currentTime_microseconds() { return steady_nsecs() / 1000; }
 
-#endif /* CURRENT_TIME_HH */
\ No newline at end of file
+inline uint64_t currentTime_nanoseconds() { return steady_nsecs(); }
+
+#endif /* CURRENT_TIME_HH */
@@ -16,12 +16,13 @@ DeepCCSocket::DeepCCSocket(FileDescriptor&& fd) : TCPSocket(std::move(fd)) {
 
 void DeepCCSocket::init() {
   tcp_deepcc_enable = true;
-  max_tput_ = 0;
   last_observe_ts_ = 0;
   last_request_ts_ = 0;
   last_observe_info_.init();
   last_request_info_.init();
   has_observe_ = false;
+  observations_.reserve(OBSERVATION_CAPACITY);
+  provider_ = std::make_unique<DeepCCStateProvider>();
 
   // init timestamp
   initial_timestamp();
@@ -34,33 +35,49 @@ DeepCCSocket DeepCCSocket::accept(void) {
       SystemCall("accept", ::accept(fd_num(), nullptr, nullptr))));
 }
 
+void DeepCCSocket::set_state_provider(
+    std::unique_ptr<TCPStateProvider>&& provider) {
+  provider_ = std::move(provider);
+}
+
+void DeepCCSocket::set_congestion_control(const std::string& cc) {
+  TCPSocket::set_congestion_control(provider_->congestion_control(cc));
+}
+
 void DeepCCSocket::enable_deepcc(int val) {
-  setsockopt(IPPROTO_TCP, TCP_DEEPCC_ENABLE, val);
+  provider_->enable(fd_num(), val);
   tcp_deepcc_enable = true;
 }
 
 TCPDeepCCInfo DeepCCSocket::get_tcp_deepcc_info(TCPInfoRequestType type) {
+  // held across the merge too: an observation published or recorded in
+  // between would be discarded by the reset of the interval below
   const std::lock_guard<std::mutex> lock(mutex_);
 
   if (not tcp_deepcc_enable) {
     throw runtime_error("DeepCC hasn't been activated");
   }
-  struct TCPDeepCCInfo info;
-  getsockopt(IPPROTO_TCP, TCP_DEEPCC_INFO, info);
-  // record max throughput
-  max_tput_ = std::max(max_tput_, info.avg_thr);
+  struct TCPDeepCCInfo info = provider_->sample(fd_num());
   switch (type) {
-  case TCPInfoRequestType::REQUEST_ACTION:
-    LOG(TRACE) << "Empty queue, queue size is " << queue_.size();
+  case TCPInfoRequestType::REQUEST_ACTION: {
+    LOG(TRACE) << "Merging " << observations_.size() << " observations";
+    const TCPDeepCCInfo sample = info;
     prepare_request_info(info);
+    // record max throughput, over the whole interval; the only update, so
+    // that a single short sample never sets it
+    update_max_tput(info);
     last_request_info_ = info;
     has_observe_ = false;
+    publish(sample, &info);
     break;
+  }
 
   case TCPInfoRequestType::OBSERVE:
     LOG(TRACE) << "Intermediate observation, push to queue and return";
+    // max_tput waits for the request that merges this observation
+    publish(info, nullptr);
     // first enqueue temp observation for preparing next Request
-    queue_.emplace(info);
+    push_observation(info);
     // merge current observed info with last observed info
     const auto& last_observed =
         has_observe_ ? last_observe_info_ : last_request_info_;
@@ -71,7 +88,42 @@ TCPDeepCCInfo DeepCCSocket::get_tcp_deepcc_info(TCPInfoRequestType type) {
   return info;
 }
 
-json DeepCCSocket::get_tcp_deepcc_info_json(TCPInfoRequestType type) {
+void DeepCCSocket::observe() {
+  const std::lock_guard<std::mutex> lock(mutex_);
+
+  if (not tcp_deepcc_enable) {
+    throw runtime_error("DeepCC hasn't been activated");
+  }
+  // with no room, leave the state to accumulate where it is
+  if (observations_.size() >= OBSERVATION_CAPACITY) {
+    observations_dropped_++;
+    return;
+  }
+  const TCPDeepCCInfo info = provider_->sample(fd_num());
+  push_observation(info);
+  publish(info, nullptr);
+}
+
+void DeepCCSocket::watch() {
+  const std::lock_guard<std::mutex> lock(mutex_);
+
+  if (not tcp_deepcc_enable) {
+    throw runtime_error("DeepCC hasn't been activated");
+  }
+  const TCPDeepCCInfo info = provider_->sample(fd_num());
+  update_max_tput(info);
+  publish(info, &info);
+}
+
+void DeepCCSocket::push_observation(const TCPDeepCCInfo& info) {
+  if (observations_.size() >= OBSERVATION_CAPACITY) {
+    observations_dropped_++;
+    return;
+  }
+  observations_.push_back(info);
+}
+
+ControlSample DeepCCSocket::get_control_sample(TCPInfoRequestType type) {
   uint64_t time_delta = 0;
   auto now = timestamp_usecs();
   switch (type) {
@@ -85,26 +137,78 @@ json DeepCCSocket::get_tcp_deepcc_info_json(TCPInfoRequestType type) {
     last_observe_ts_ = now;
     break;
   }
-  // timedelta in us
-  time_delta = std::max(time_delta, u64(1));
-  auto info = get_tcp_deepcc_info(type);
+  // timedelta in us, as long as it was for the states
+  time_delta = std::max(u64(time_delta * provider_->time_scale()), u64(1));
+  ControlSample sample;
+  sample.info = get_tcp_deepcc_info(type);
   // loss ratio in bytes per second
-  auto loss_ratio = double(info.lost_bytes * SECOND_TO_US) / time_delta;
-  auto data = std::move(info.to_json());
+  sample.loss_ratio =
+      double(sample.info.lost_bytes * SECOND_TO_US) / time_delta;
   // we also want to know the observed max throughput
-  data["max_tput"] = max_tput_;
-  data["loss_ratio"] = loss_ratio;
-  data["time_delta"] = time_delta;
-  return data;
+  sample.max_tput = max_tput_.get();
+  sample.max_tput_window = max_tput_.window();
+  sample.time_delta = time_delta;
+  return sample;
+}
+
+ControlSample DeepCCSocket::control_sample(
+    const StateSnapshot& snapshot, const StateSnapshot& previous) const {
+  const u64 time_delta =
+      std::max(u64((snapshot.time_us - previous.time_us) *
+                   provider_->time_scale()),
+               u64(1));
+  ControlSample sample;
+  sample.info = snapshot.step;
+  sample.loss_ratio =
+      double(sample.info.lost_bytes * SECOND_TO_US) / time_delta;
+  sample.max_tput = snapshot.max_tput;
+  sample.max_tput_window = max_tput_.window();
+  sample.time_delta = time_delta;
+  return sample;
+}
+
+json DeepCCSocket::get_tcp_deepcc_info_json(TCPInfoRequestType type) {
+  return get_control_sample(type).to_json();
 }
 
 void DeepCCSocket::prepare_request_info(TCPDeepCCInfo& info) {
-  if (queue_.size() == 0) return;
-  while (not queue_.empty()) {
-    auto inter_observation = queue_.front();
+  for (const auto& inter_observation : observations_) {
     info.merge_info(inter_observation);
-    queue_.pop();
   }
+  observations_.clear();
+}
+
+void DeepCCSocket::set_max_tput_window(uint64_t window_us) {
+  const std::lock_guard<std::mutex> lock(mutex_);
+  max_tput_.reset(window_us);
+}
+
+void DeepCCSocket::update_max_tput(const TCPDeepCCInfo& info) {
+  // the window goes by as fast as the states do
+  const uint64_t now = timestamp_usecs() * provider_->time_scale();
+  max_tput_.update(now, info.avg_thr);
+}
+
+void DeepCCSocket::publish(const TCPDeepCCInfo& sample,
+                           const TCPDeepCCInfo* step) {
+  StateSnapshot& next = pending_snapshot_;
+  next.latest = sample;
+  if (step) {
+    next.step = *step;
+    next.interval_samples = 0;
+  } else {
+    // the newest sample's instant values, averages over all of them
+    TCPDeepCCInfo merged = sample;
+    if (next.interval_samples > 0) {
+      merged.merge_info(next.interval);
+    }
+    next.interval = merged;
+    next.interval_samples++;
+  }
+  next.max_tput = max_tput_.get();
+  next.time_us = timestamp_usecs();
+  next.samples++;
+  snapshot_.store(next);
 }
 
 inline void DeepCCSocket::prepare_observe_info(TCPDeepCCInfo& dst,
@@ -113,10 +217,12 @@ inline void DeepCCSocket::prepare_observe_info(TCPDeepCCInfo& dst,
 }
 
 void DeepCCSocket::set_tcp_cwnd(int cwnd) {
+  const std::lock_guard<std::mutex> lock(mutex_);
+
   if (not tcp_deepcc_enable) {
     throw runtime_error("DeepCC hasn't been activated");
   }
-  setsockopt(IPPROTO_TCP, TCP_CWND, cwnd);
+  provider_->set_cwnd(fd_num(), cwnd);
 }
 
 /* get socket option */
@@ -4,17 +4,39 @@
 #include <linux/tcp.h>
 #include <sys/socket.h>
 
+#include <atomic>
+#include <memory>
 #include <mutex>
-#include <queue>
+#include <string>
+#include <vector>
 
 #include "address.hh"
+#include "control_sample.hh"
 #include "exception.hh"
 #include "file_descriptor.hh"
+#include "seqlock.hh"
 #include "socket.hh"
 #include "tcp_info.hh"
+#include "tcp_state_provider.hh"
+#include "windowed_filter.hh"
 
 using namespace std;
 
+/* what a DeepCCSocket last learned about its flow */
+struct StateSnapshot {
+  /* the last sample taken, of either type, as the provider reported it */
+  TCPDeepCCInfo latest;
+  /* the samples since the last control step, merged; interval_samples of
+   * them, and nothing if 0 */
+  TCPDeepCCInfo interval;
+  /* the state the last control step saw */
+  TCPDeepCCInfo step;
+  u64 max_tput;
+  u64 time_us;  /* timestamp_usecs() of `latest` */
+  u64 samples;  /* samples taken so far */
+  u32 interval_samples;
+};
+
 class DeepCCSocket : public TCPSocket {
  public:
   enum class TCPInfoRequestType : int { REQUEST_ACTION = 0, OBSERVE = 1 };
@@ -24,8 +46,36 @@ class DeepCCSocket : public TCPSocket {
 
  public:
   DeepCCSocket();
+  /* where TCP state comes from and actions go to; the patched kernel
+   * (DeepCCStateProvider) unless set before enable_deepcc() */
+  void set_state_provider(std::unique_ptr<TCPStateProvider>&& provider);
+  const TCPStateProvider& state_provider() const { return *provider_; }
+  /* runs the kernel congestion control the provider asks for in place of
+   * `cc` (e.g. CUBIC for astraea on a stock kernel) */
+  void set_congestion_control(const std::string& cc);
   void enable_deepcc(int val);
   TCPDeepCCInfo get_tcp_deepcc_info(TCPInfoRequestType type);
+  /* an intermediate observation with nothing returned, for a sampler
+   * running next to the control loop: it is kept for the next
+   * REQUEST_ACTION to merge */
+  void observe();
+  /* a sample that is a control step of its own and only goes into the
+   * snapshot, for tools that watch a flow without controlling it */
+  void watch();
+  /* observations not taken because OBSERVATION_CAPACITY were waiting */
+  uint64_t observations_dropped() const { return observations_dropped_; }
+  /* a copy of what the samples taken so far have published, for readers
+   * at any cadence (loggers, dashboards) that should neither take a lock
+   * nor make a syscall; with an ObservationSampler running it is at most
+   * one period old */
+  StateSnapshot snapshot() const { return snapshot_.load(); }
+  /* the last step of `snapshot` as the control loop would have sampled it,
+   * with the loss ratio over the time since `previous` */
+  ControlSample control_sample(const StateSnapshot& snapshot,
+                               const StateSnapshot& previous) const;
+  /* the state for one control step; encode it where it is consumed */
+  ControlSample get_control_sample(TCPInfoRequestType type);
+  /* get_control_sample() as JSON */
   json get_tcp_deepcc_info_json(TCPInfoRequestType type);
   void set_tcp_cwnd(int cwnd);
   DeepCCSocket accept();
@@ -39,18 +89,32 @@ class DeepCCSocket : public TCPSocket {
                   const option_type& option_value);
 
   /* get max throughput */
-  uint64_t get_max_tput() const { return max_tput_; }
+  uint64_t get_max_tput() const { return max_tput_.get(); }
+  /* take max throughput over the last `window_us` of (scaled) time
+   * instead of the whole flow, which 0 stands for; a path whose capacity
+   * drops is then normalized against its new capacity */
+  void set_max_tput_window(uint64_t window_us);
+  uint64_t max_tput_window() const { return max_tput_.window(); }
 
  private:
   void init();
   void prepare_request_info(TCPDeepCCInfo& info);
+  void push_observation(const TCPDeepCCInfo& info);
   void prepare_observe_info(TCPDeepCCInfo& dst, const TCPDeepCCInfo& src);
+  void update_max_tput(const TCPDeepCCInfo& info);
+  /* publish `sample`, merged into the interval or ending it with `step` */
+  void publish(const TCPDeepCCInfo& sample, const TCPDeepCCInfo* step);
 
  private:
   bool tcp_deepcc_enable;
-  std::queue<TCPDeepCCInfo> queue_{};
-  /* maximal observed throughput */
-  uint64_t max_tput_;
+  std::unique_ptr<TCPStateProvider> provider_{};
+  /* observations since the last request, in order, at most
+   * OBSERVATION_CAPACITY of them */
+  static constexpr size_t OBSERVATION_CAPACITY = 256;
+  std::vector<TCPDeepCCInfo> observations_{};
+  std::atomic<uint64_t> observations_dropped_{0};
+  /* maximal throughput of the merged control steps */
+  WindowedMaxFilter max_tput_{};
   /* last observed time in us */
   uint64_t last_observe_ts_;
   /* last request time in us */
@@ -61,7 +125,11 @@ class DeepCCSocket : public TCPSocket {
   TCPDeepCCInfo last_observe_info_;
   /* has observe between two request or not */
   bool has_observe_;
-  /* mutex for avoiding concurrent get info */
+  /* the next snapshot, built under the mutex, and the published one */
+  StateSnapshot pending_snapshot_{};
+  Seqlock<StateSnapshot> snapshot_{};
+  /* serializes the provider, which keeps state between samples, and all of
+   * the bookkeeping above but the published snapshot */
   std::mutex mutex_;
 };
 
@@ -3,9 +3,11 @@
 #include "file_descriptor.hh"
 
 #include <fcntl.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <cassert>
+#include <cerrno>
 
 #include "exception.hh"
 
@@ -13,7 +15,13 @@ using namespace std;
 
 /* construct from fd number */
 FileDescriptor::FileDescriptor(const int fd)
-    : fd_(fd), eof_(false), read_count_(0), write_count_(0) {
+    : fd_(fd),
+      eof_(false),
+      read_count_(0),
+      write_count_(0),
+      output_(),
+      output_flushed_(0),
+      high_water_mark_(DEFAULT_HIGH_WATER_MARK) {
   if (fd_ <= 2) { /* make sure not overwriting stdout/stderr */
     throw unix_error("FileDescriptor: fd <= 2");
   }
@@ -28,7 +36,10 @@ FileDescriptor::FileDescriptor(FileDescriptor&& other)
     : fd_(other.fd_),
       eof_(other.eof_),
       read_count_(other.read_count_),
-      write_count_(other.write_count_) {
+      write_count_(other.write_count_),
+      output_(move(other.output_)),
+      output_flushed_(other.output_flushed_),
+      high_water_mark_(other.high_water_mark_) {
   /* mark other file descriptor as inactive */
   other.fd_ = -1;
 }
@@ -39,6 +50,9 @@ FileDescriptor& FileDescriptor::operator=(FileDescriptor&& other) {
   eof_ = other.eof_;
   read_count_ = other.read_count_;
   write_count_ = other.write_count_;
+  output_ = move(other.output_);
+  output_flushed_ = other.output_flushed_;
+  high_water_mark_ = other.high_water_mark_;
 
   /* mark other file descriptor as inactive */
   other.fd_ = -1;
@@ -92,27 +106,33 @@ string::const_iterator FileDescriptor::write(
 string FileDescriptor::read(const size_t limit) {
   char buffer[BUFFER_SIZE];
 
-  ssize_t bytes_read =
-      SystemCall("read", ::read(fd_, buffer, min(BUFFER_SIZE, limit)));
+  const size_t bytes_read = read_into(buffer, min(BUFFER_SIZE, limit));
+
+  return string(buffer, bytes_read);
+}
+
+/* read into the caller's buffer */
+size_t FileDescriptor::read_into(char* buffer, const size_t capacity) {
+  ssize_t bytes_read = SystemCall("read", ::read(fd_, buffer, capacity));
   if (bytes_read == 0) {
     set_eof();
   }
 
   register_read();
 
-  return string(buffer, bytes_read);
+  return bytes_read;
 }
 
-/* read exactly some bytes */
-string FileDescriptor::read_exactly(const size_t length,
-                                    const bool fail_silently) {
-  std::string ret;
+/* read exactly some bytes into the caller's buffer */
+size_t FileDescriptor::read_exactly_into(char* buffer, const size_t length,
+                                         const bool fail_silently) {
+  size_t bytes_read = 0;
 
-  while (ret.size() < length) {
-    ret.append(read(length - ret.size()));
+  while (bytes_read < length) {
+    bytes_read += read_into(buffer + bytes_read, length - bytes_read);
     if (eof()) {
       if (fail_silently) {
-        return ret;
+        return bytes_read;
       } else {
         throw std::runtime_error(
             "read_exactly: reached EOF before reaching target");
@@ -120,7 +140,17 @@ string FileDescriptor::read_exactly(const size_t length,
     }
   }
 
-  assert(ret.size() == length);
+  return bytes_read;
+}
+
+/* read exactly some bytes */
+string FileDescriptor::read_exactly(const size_t length,
+                                    const bool fail_silently) {
+  std::string ret(length, '\0');
+
+  ret.resize(read_exactly_into(ret.data(), length, fail_silently));
+
+  assert(fail_silently or ret.size() == length);
   return ret;
 }
 
@@ -136,6 +166,50 @@ string::const_iterator FileDescriptor::write(const std::string& buffer,
   return it;
 }
 
+/* gather write */
+size_t FileDescriptor::writev(initializer_list<string_view> buffers,
+                              const bool write_all) {
+  if (buffers.size() > MAX_IOV) {
+    throw runtime_error("writev: too many buffers");
+  }
+
+  iovec iov[MAX_IOV];
+  int count = 0;
+  for (const auto& buffer : buffers) {
+    if (not buffer.empty()) {
+      iov[count++] = {const_cast<char*>(buffer.data()), buffer.size()};
+    }
+  }
+
+  size_t bytes_written = 0;
+  iovec* next = iov;
+  while (count > 0) {
+    size_t n = SystemCall("writev", ::writev(fd_, next, count));
+    if (n == 0) {
+      throw runtime_error("writev returned 0");
+    }
+
+    register_write();
+    bytes_written += n;
+    if (not write_all) {
+      break;
+    }
+
+    /* skip what has been written, possibly part of a buffer */
+    while (count > 0 and n >= next->iov_len) {
+      n -= next->iov_len;
+      next++;
+      count--;
+    }
+    if (count > 0) {
+      next->iov_base = static_cast<char*>(next->iov_base) + n;
+      next->iov_len -= n;
+    }
+  }
+
+  return bytes_written;
+}
+
 void FileDescriptor::set_blocking(const bool block) {
   int flags = SystemCall("fcntl F_GETFL", fcntl(fd_, F_GETFL));
 
@@ -147,3 +221,76 @@ void FileDescriptor::set_blocking(const bool block) {
 
   SystemCall("fcntl F_SETFL", fcntl(fd_, F_SETFL, flags));
 }
+
+/* nonblocking read */
+FileDescriptor::IOResult FileDescriptor::try_read_into(char* buffer,
+                                                       const size_t capacity) {
+  while (true) {
+    const ssize_t bytes_read = ::read(fd_, buffer, capacity);
+    if (bytes_read >= 0) {
+      if (bytes_read == 0 and capacity > 0) {
+        set_eof();
+      }
+      register_read();
+      return {size_t(bytes_read), false};
+    } else if (errno == EAGAIN or errno == EWOULDBLOCK) {
+      return {0, true};
+    } else if (errno != EINTR) {
+      throw unix_error("read");
+    }
+  }
+}
+
+/* nonblocking write */
+FileDescriptor::IOResult FileDescriptor::try_write(const string_view buffer) {
+  IOResult result{0, false};
+
+  while (result.bytes < buffer.size()) {
+    const ssize_t bytes_written = ::write(fd_, buffer.data() + result.bytes,
+                                          buffer.size() - result.bytes);
+    if (bytes_written > 0) {
+      register_write();
+      result.bytes += bytes_written;
+    } else if (bytes_written == 0) { /* no progress; let the caller retry */
+      break;
+    } else if (errno == EAGAIN or errno == EWOULDBLOCK) {
+      result.would_block = true;
+      break;
+    } else if (errno != EINTR) {
+      throw unix_error("write");
+    }
+  }
+
+  return result;
+}
+
+/* write now what the fd takes, queue the rest */
+bool FileDescriptor::write_buffered(const string_view buffer) {
+  size_t written = 0;
+  if (pending_output() == 0) { /* keep the order of queued output */
+    written = try_write(buffer).bytes;
+  }
+  output_.append(buffer.data() + written, buffer.size() - written);
+
+  return not above_high_water();
+}
+
+/* write queued output */
+bool FileDescriptor::flush_output(void) {
+  output_flushed_ +=
+      try_write(string_view(output_).substr(output_flushed_)).bytes;
+
+  if (pending_output() > 0) {
+    /* drop what has been written once it is most of the queue */
+    if (output_flushed_ >= output_.size() / 2) {
+      output_.erase(0, output_flushed_);
+      output_flushed_ = 0;
+    }
+    return false;
+  }
+
+  /* keep the capacity for the next time output queues up */
+  output_.clear();
+  output_flushed_ = 0;
+  return true;
+}
@@ -3,7 +3,9 @@
 #ifndef FILE_DESCRIPTOR_HH
 #define FILE_DESCRIPTOR_HH
 
+#include <initializer_list>
 #include <string>
+#include <string_view>
 
 /* Unix file descriptors (sockets, files, etc.) */
 class FileDescriptor {
@@ -13,10 +15,23 @@ class FileDescriptor {
 
   unsigned int read_count_, write_count_;
 
+  /* output queued by write_buffered(); the first output_flushed_ bytes have
+   * been written already */
+  std::string output_;
+  size_t output_flushed_;
+  size_t high_water_mark_;
+
   /* maximum size of a read */
   static constexpr size_t BUFFER_SIZE = 1024 * 1024;
 
+ public:
+  /* default limit of queued output before write_buffered() pushes back */
+  static constexpr size_t DEFAULT_HIGH_WATER_MARK = 1024 * 1024;
+
  protected:
+  /* maximum number of buffers in one writev() */
+  static constexpr size_t MAX_IOV = 16;
+
   void register_read(void) { read_count_++; }
   void register_write(void) { write_count_++; }
   void set_eof(void) { eof_ = true; }
@@ -52,9 +67,45 @@ class FileDescriptor {
   std::string::const_iterator write(const std::string::const_iterator& begin,
                                     const std::string::const_iterator& end);
 
+  /* allocation-free read and write methods on the caller's memory */
+  /* read at most capacity bytes into buffer; returns the bytes read */
+  size_t read_into(char* buffer, const size_t capacity);
+  /* read exactly length bytes into buffer; returns the bytes read, which
+   * are fewer only at EOF with fail_silently */
+  size_t read_exactly_into(char* buffer, const size_t length,
+                           const bool fail_silently = false);
+  /* write the buffers back to back with writev(), e.g. a header and a
+   * payload; returns the bytes written */
+  virtual size_t writev(std::initializer_list<std::string_view> buffers,
+                        const bool write_all = true);
+
   /* set nonblocking/blocking behavior */
   void set_blocking(const bool block);
 
+  /* nonblocking I/O: progress so far and whether the fd would block, in
+   * place of exceptions; other errors still throw */
+  struct IOResult {
+    size_t bytes;
+    bool would_block;
+  };
+  /* one read() of at most capacity bytes; EOF sets eof() */
+  IOResult try_read_into(char* buffer, const size_t capacity);
+  /* write as much of buffer as the fd takes now */
+  IOResult try_write(const std::string_view buffer);
+
+  /* buffered output for event loops: write what the fd takes now and queue
+   * the rest, to be written by flush_output() once the fd is writable.
+   * Returns false once more than the high-water mark is queued; the data is
+   * still queued, but the caller should hold back until it drains. */
+  bool write_buffered(const std::string_view buffer);
+  /* write queued output; returns whether none is left */
+  bool flush_output(void);
+  size_t pending_output(void) const { return output_.size() - output_flushed_; }
+  bool above_high_water(void) const {
+    return pending_output() > high_water_mark_;
+  }
+  void set_high_water_mark(const size_t bytes) { high_water_mark_ = bytes; }
+
   /* forbid copying FileDescriptor objects or assigning them */
   FileDescriptor(const FileDescriptor& other) = delete;
   const FileDescriptor& operator=(const FileDescriptor& other) = delete;
@@ -0,0 +1,110 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "frame_codec.hh"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "exception.hh"
+#include "serialization.hh"
+
+using namespace std;
+
+size_t FrameBuffer::round_capacity(const size_t capacity) {
+  const size_t page = sysconf(_SC_PAGESIZE);
+  const size_t minimum = max(capacity, HEADER_SIZE + MAX_PAYLOAD + 1);
+  return (minimum + page - 1) / page * page;
+}
+
+FrameBuffer::FrameBuffer(const size_t capacity)
+    : capacity_(round_capacity(capacity)) {
+  /* reserve twice the capacity, then map the same memory into both halves */
+  FileDescriptor memory(
+      SystemCall("memfd_create", memfd_create("frame_buffer", MFD_CLOEXEC)));
+  SystemCall("ftruncate", ftruncate(memory.fd_num(), capacity_));
+  void* area = mmap(nullptr, 2 * capacity_, PROT_NONE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (area == MAP_FAILED) {
+    throw unix_error("mmap");
+  }
+  base_ = static_cast<char*>(area);
+  for (size_t offset : {size_t(0), capacity_}) {
+    if (mmap(base_ + offset, capacity_, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_FIXED, memory.fd_num(), 0) == MAP_FAILED) {
+      munmap(base_, 2 * capacity_);
+      throw unix_error("mmap FrameBuffer");
+    }
+  }
+}
+
+FrameBuffer::~FrameBuffer() { munmap(base_, 2 * capacity_); }
+
+void FrameBuffer::commit(const size_t length) {
+  if (length > writable()) {
+    throw runtime_error("FrameBuffer: commit past the free space");
+  }
+  head_ += length;
+}
+
+optional<string_view> FrameBuffer::pop(void) {
+  if (buffered() < HEADER_SIZE) {
+    return nullopt;
+  }
+  const char* frame = base_ + tail_ % capacity_;
+  const size_t length = get_uint16(frame);
+  if (buffered() < HEADER_SIZE + length) {
+    return nullopt;
+  }
+  tail_ += HEADER_SIZE + length;
+  return string_view(frame + HEADER_SIZE, length);
+}
+
+FrameReader::FrameReader(FileDescriptor& fd, const size_t capacity)
+    : fd_(fd), buffer_(capacity) {}
+
+size_t FrameReader::fill(void) {
+  const auto result = fd_.try_read_into(buffer_.write_area(), buffer_.writable());
+  buffer_.commit(result.bytes);
+  return result.bytes;
+}
+
+optional<string_view> FrameReader::next(void) {
+  while (true) {
+    if (const auto frame = buffer_.pop()) {
+      return frame;
+    }
+    if (fd_.eof()) {
+      if (buffer_.buffered() > 0) {
+        throw runtime_error("FrameReader: EOF inside a frame");
+      }
+      return nullopt;
+    }
+    if (fill() == 0 and not fd_.eof()) {
+      return nullopt;
+    }
+  }
+}
+
+void FrameWriter::push(const string_view payload) {
+  if (payload.size() > FrameBuffer::MAX_PAYLOAD) {
+    throw runtime_error("FrameWriter: frame of " + to_string(payload.size()) +
+                        " bytes is too long");
+  }
+  buffer_ += put_field(payload.size());
+  buffer_ += payload;
+}
+
+bool FrameWriter::flush(void) {
+  flushed_ += fd_.try_write(string_view(buffer_).substr(flushed_)).bytes;
+  if (pending() > 0) {
+    return false;
+  }
+
+  /* keep the capacity for the next burst */
+  buffer_.clear();
+  flushed_ = 0;
+  return true;
+}
@@ -0,0 +1,110 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef FRAME_CODEC_HH
+#define FRAME_CODEC_HH
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "file_descriptor.hh"
+
+/* Length-prefixed frames, as spoken between the clients and the inference
+ * side: a 16-bit big-endian length (see serialization.hh), then the
+ * payload. */
+
+/* a ring of received bytes that hands out whole frames in place.
+ *
+ * The ring is mapped twice back to back, so both the free space and every
+ * buffered frame are contiguous even where they wrap around: bytes can be
+ * read straight into it, and frames are returned as views without being
+ * copied out. It holds any frame, so a partial frame never stalls it. */
+class FrameBuffer {
+ public:
+  static constexpr size_t HEADER_SIZE = sizeof(uint16_t);
+  static constexpr size_t MAX_PAYLOAD = UINT16_MAX;
+  static constexpr size_t DEFAULT_CAPACITY = 256 * 1024;
+
+  /* capacity is rounded up to whole pages and to more than one frame */
+  explicit FrameBuffer(const size_t capacity = DEFAULT_CAPACITY);
+  ~FrameBuffer();
+
+  /* where to put received bytes, and how many fit */
+  char* write_area(void) { return base_ + head_ % capacity_; }
+  size_t writable(void) const { return capacity_ - buffered(); }
+  /* count `length` bytes put at write_area() as received */
+  void commit(const size_t length);
+
+  /* the payload of the next complete frame, if there is one; the view stays
+   * valid until bytes are next put into the ring */
+  std::optional<std::string_view> pop(void);
+
+  size_t buffered(void) const { return head_ - tail_; }
+
+  /* forbid copying FrameBuffer objects or assigning them */
+  FrameBuffer(const FrameBuffer& other) = delete;
+  const FrameBuffer& operator=(const FrameBuffer& other) = delete;
+
+ private:
+  /* whole pages, and more than one frame */
+  static size_t round_capacity(const size_t capacity);
+
+  size_t capacity_;
+  char* base_{nullptr};
+  /* bytes ever received and ever consumed */
+  uint64_t head_{0};
+  uint64_t tail_{0};
+};
+
+/* reads frames from a file descriptor, taking as many bytes per read() as
+ * are available; works on blocking and nonblocking descriptors */
+class FrameReader {
+ public:
+  explicit FrameReader(FileDescriptor& fd,
+                       const size_t capacity = FrameBuffer::DEFAULT_CAPACITY);
+
+  /* the next frame, reading only when none is buffered. On a blocking fd it
+   * waits for a whole frame; on a nonblocking fd it returns nothing once the
+   * fd has no more to read. It also returns nothing at EOF between frames,
+   * and throws at EOF inside one. The view is valid until the next call. */
+  std::optional<std::string_view> next(void);
+
+  /* the next frame already buffered; never reads */
+  std::optional<std::string_view> pop(void) { return buffer_.pop(); }
+
+  /* one read of whatever the fd has; returns the bytes read, which are 0 if
+   * it would block or at EOF */
+  size_t fill(void);
+
+  bool eof(void) const { return fd_.eof(); }
+  size_t buffered(void) const { return buffer_.buffered(); }
+
+ private:
+  FileDescriptor& fd_;
+  FrameBuffer buffer_;
+};
+
+/* queues frames and writes them out together, so that a burst of replies
+ * costs one write(); works on blocking and nonblocking descriptors */
+class FrameWriter {
+ public:
+  explicit FrameWriter(FileDescriptor& fd) : fd_(fd) {}
+
+  /* queue one frame; nothing is written until flush() */
+  void push(const std::string_view payload);
+
+  /* write the queued frames: all of them on a blocking fd, as many bytes as
+   * it takes on a nonblocking one; returns whether nothing is left */
+  bool flush(void);
+
+  size_t pending(void) const { return buffer_.size() - flushed_; }
+
+ private:
+  FileDescriptor& fd_;
+  /* the queued frames; the first `flushed_` bytes are written already */
+  std::string buffer_{};
+  size_t flushed_{0};
+};
+
+#endif /* FRAME_CODEC_HH */
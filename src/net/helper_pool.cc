@@ -0,0 +1,140 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "helper_pool.hh"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdexcept>
+
+#include "exception.hh"
+#include "logging.hh"
+
+using namespace std;
+using namespace PollerShortNames;
+
+/* remove a socket file left behind by an earlier run */
+static void unlink_socket(const string& path) {
+  struct stat st;
+  if (stat(path.c_str(), &st) == 0) {
+    if (not S_ISSOCK(st.st_mode)) {
+      throw runtime_error(path + " exists but it is not a socket file");
+    }
+    SystemCall("unlink " + path, unlink(path.c_str()));
+  }
+}
+
+HelperPool::HelperPool(const string& path, const string& helper,
+                       const vector<string>& helper_args, const size_t size)
+    : path_(path),
+      helper_path_(helper),
+      helpers_path_(path + ".helpers"),
+      helper_args_(helper_args),
+      size_(size) {
+  if (size_ == 0) {
+    throw runtime_error("HelperPool: size must be positive");
+  }
+
+  for (auto [socket, socket_path] :
+       {make_pair(&flows_, &path_), make_pair(&helpers_, &helpers_path_)}) {
+    unlink_socket(*socket_path);
+    socket->bind(*socket_path);
+    socket->listen();
+  }
+
+  helper_args_.insert(helper_args_.begin(), helper_path_);
+  helper_args_.push_back("--ipc-path");
+  helper_args_.push_back(helpers_path_);
+
+  auto& poller = processes_.poller();
+  poller.add_action(Poller::Action(helpers_, Direction::In, [this]() {
+    accept_helper();
+    return ResultType::Continue;
+  }));
+  poller.add_action(Poller::Action(flows_, Direction::In, [this]() {
+    accept_flow();
+    return ResultType::Continue;
+  }));
+
+  while (starting_.size() < size_) {
+    start_helper();
+  }
+}
+
+HelperPool::~HelperPool() {
+  unlink(path_.c_str());
+  unlink(helpers_path_.c_str());
+}
+
+void HelperPool::start_helper(void) {
+  const pid_t pid = processes_.run_as_child(
+      helper_path_, helper_args_,
+      [this](const pid_t& exited) { handle_helper_exit(exited, false); },
+      [this](const pid_t& exited) { handle_helper_exit(exited, true); });
+  starting_.insert(pid);
+}
+
+void HelperPool::handle_helper_exit(const pid_t pid, const bool failed) {
+  if (starting_.erase(pid)) {
+    /* died before its model was loaded */
+    LOG(ERROR) << "HelperPool: helper " << pid << " exited while loading";
+    if (++failed_starts_ >= MAX_FAILED_STARTS) {
+      throw runtime_error("HelperPool: " + to_string(failed_starts_) +
+                          " helpers in a row exited while loading");
+    }
+    dispatch();
+    return;
+  }
+
+  /* a ready helper that died is no use to a flow */
+  ready_.remove_if([pid](const Helper& helper) { return helper.pid == pid; });
+  LOG(DEBUG) << "HelperPool: helper " << pid << " exited"
+             << (failed ? " abnormally" : "");
+  dispatch();
+}
+
+void HelperPool::accept_helper(void) {
+  auto connection = make_unique<IPCSocket>(helpers_.accept());
+  const pid_t pid = connection->peer_pid();
+  if (not starting_.erase(pid)) {
+    LOG(WARNING) << "HelperPool: dropping connection from unknown process "
+                 << pid;
+    return;
+  }
+  failed_starts_ = 0;
+  ready_.push_back({pid, move(connection)});
+  LOG(INFO) << "HelperPool: helper " << pid << " is ready";
+  dispatch();
+}
+
+void HelperPool::accept_flow(void) {
+  waiting_.push_back(make_unique<IPCSocket>(flows_.accept()));
+  dispatch();
+}
+
+void HelperPool::dispatch(void) {
+  while (not waiting_.empty() and not ready_.empty()) {
+    auto flow = move(waiting_.front());
+    waiting_.pop_front();
+    Helper& helper = ready_.front();
+    try {
+      flow->send_fd(*helper.connection);
+    } catch (const unix_error& e) {
+      /* the flow gave up waiting; keep the helper for the next one */
+      print_exception("HelperPool", e);
+      continue;
+    }
+    LOG(INFO) << "HelperPool: handed helper " << helper.pid << " to a flow";
+    ready_.pop_front();
+  }
+
+  while (starting_.size() + ready_.size() < size_) {
+    start_helper();
+  }
+}
+
+IPCSocket HelperPool::checkout(const string& path) {
+  IPCSocket pool;
+  pool.connect(path);
+  return IPCSocket(pool.recv_fd(), AF_UNIX, SOCK_STREAM);
+}
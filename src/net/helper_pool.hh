@@ -0,0 +1,80 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef HELPER_POOL_HH
+#define HELPER_POOL_HH
+
+#include <sys/types.h>
+
+#include <deque>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "child_process.hh"
+#include "ipc_socket.hh"
+
+/* keeps inference helpers (python/infer.py) started and model-loaded ahead
+ * of the flows that need them.
+ *
+ * Every helper is started with --ipc-path pointing at a socket of the pool,
+ * which it connects to only once its model is loaded. A flow connects to the
+ * pool at `path` and receives that connection (see checkout()), and then
+ * talks to the helper exactly as if it had started the helper itself. The
+ * pool starts a replacement for every helper it hands out, and a flow that
+ * arrives while none is ready waits for the next. */
+class HelperPool {
+ public:
+  /* `helper_args` are the helper's arguments other than --ipc-path */
+  HelperPool(const std::string& path, const std::string& helper,
+             const std::vector<std::string>& helper_args, const size_t size);
+  ~HelperPool();
+
+  /* serve flows until interrupted; returns the exit status */
+  int loop(void) { return processes_.loop(); }
+
+  /* the connection to a ready helper, from the pool listening at `path` */
+  static IPCSocket checkout(const std::string& path);
+
+  /* forbid copying HelperPool objects or assigning them */
+  HelperPool(const HelperPool& other) = delete;
+  const HelperPool& operator=(const HelperPool& other) = delete;
+
+ private:
+  /* give up after this many helpers in a row die while loading */
+  static constexpr unsigned int MAX_FAILED_STARTS = 3;
+
+  struct Helper {
+    pid_t pid;
+    std::unique_ptr<IPCSocket> connection;
+  };
+
+  const std::string path_;
+  const std::string helper_path_;
+  const std::string helpers_path_;
+  std::vector<std::string> helper_args_;
+  const size_t size_;
+
+  ProcessManager processes_{};
+  IPCSocket flows_{};
+  IPCSocket helpers_{};
+
+  /* started and still loading */
+  std::unordered_set<pid_t> starting_{};
+  /* loaded and connected, oldest first */
+  std::list<Helper> ready_{};
+  /* flows waiting for a helper, oldest first */
+  std::deque<std::unique_ptr<IPCSocket>> waiting_{};
+
+  unsigned int failed_starts_{0};
+
+  void start_helper(void);
+  void handle_helper_exit(const pid_t pid, const bool failed);
+  void accept_helper(void);
+  void accept_flow(void);
+  /* hand ready helpers to waiting flows, then top the pool back up */
+  void dispatch(void);
+};
+
+#endif /* HELPER_POOL_HH */
@@ -0,0 +1,94 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "histogram.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+using namespace std;
+
+/* enough buckets for every 64-bit value */
+Histogram::Histogram() : buckets_((64 - SUB_BITS + 1) * SUB_COUNT, 0) {}
+
+size_t Histogram::bucket_index(const uint64_t value) {
+  if (value < SUB_COUNT) {
+    return value;
+  }
+  /* value >> shift lies in [SUB_COUNT, 2 * SUB_COUNT) */
+  const unsigned int shift = 63 - __builtin_clzll(value) - SUB_BITS;
+  return (shift + 1) * SUB_COUNT + ((value >> shift) - SUB_COUNT);
+}
+
+uint64_t Histogram::bucket_lowest(const size_t index) {
+  if (index < SUB_COUNT) {
+    return index;
+  }
+  const unsigned int shift = index / SUB_COUNT - 1;
+  return (SUB_COUNT + index % SUB_COUNT) << shift;
+}
+
+uint64_t Histogram::bucket_highest(const size_t index) {
+  if (index < SUB_COUNT) {
+    return index;
+  }
+  const unsigned int shift = index / SUB_COUNT - 1;
+  return bucket_lowest(index) + ((uint64_t(1) << shift) - 1);
+}
+
+void Histogram::add(const uint64_t value, const uint64_t count) {
+  buckets_[bucket_index(value)] += count;
+  count_ += count;
+  min_ = std::min(min_, value);
+  max_ = std::max(max_, value);
+  sum_ += (long double)value * count;
+}
+
+void Histogram::merge(const Histogram& other) {
+  for (size_t i = 0; i < buckets_.size(); i++) {
+    buckets_[i] += other.buckets_[i];
+  }
+  count_ += other.count_;
+  min_ = std::min(min_, other.min_);
+  max_ = std::max(max_, other.max_);
+  sum_ += other.sum_;
+}
+
+void Histogram::clear(void) {
+  fill(buckets_.begin(), buckets_.end(), 0);
+  count_ = 0;
+  min_ = UINT64_MAX;
+  max_ = 0;
+  sum_ = 0;
+}
+
+double Histogram::mean(void) const {
+  return count_ ? double(sum_ / count_) : 0.0;
+}
+
+uint64_t Histogram::percentile(const double percent) const {
+  if (count_ == 0) {
+    return 0;
+  }
+
+  const double clamped = std::min(std::max(percent, 0.0), 100.0);
+  const uint64_t rank =
+      std::max(uint64_t(1), uint64_t(ceil(clamped / 100.0 * count_)));
+
+  uint64_t seen = 0;
+  for (size_t i = 0; i < buckets_.size(); i++) {
+    seen += buckets_[i];
+    if (seen >= rank) {
+      return std::min(std::max(bucket_highest(i), min_), max_);
+    }
+  }
+  return max_;
+}
+
+string Histogram::summary(void) const {
+  ostringstream out;
+  out << "count=" << count() << " mean=" << mean() << " p50="
+      << percentile(50) << " p99=" << percentile(99)
+      << " p999=" << percentile(99.9) << " max=" << max();
+  return out.str();
+}
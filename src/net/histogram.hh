@@ -0,0 +1,66 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef HISTOGRAM_HH
+#define HISTOGRAM_HH
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* log-linear histogram of non-negative integers (e.g. latencies in us).
+ *
+ * Values below 2^SUB_BITS are counted exactly; above that, every power of
+ * two is split into 2^SUB_BITS equal buckets, which bounds the relative
+ * error of a reported percentile by 2^-SUB_BITS (about 3%). Recording is a
+ * couple of shifts and an increment. Not thread safe: keep one histogram
+ * per thread and merge() them when reporting. */
+class Histogram {
+ public:
+  Histogram();
+
+  void add(const uint64_t value, const uint64_t count = 1);
+  void merge(const Histogram& other);
+  void clear(void);
+
+  uint64_t count(void) const { return count_; }
+  uint64_t min(void) const { return count_ ? min_ : 0; }
+  uint64_t max(void) const { return max_; }
+  double mean(void) const;
+
+  /* smallest recorded value (up to bucket precision) that is greater than
+   * or equal to `percent` percent of all values, e.g. percentile(99.9) */
+  uint64_t percentile(const double percent) const;
+
+  /* call visitor(lowest, highest, count) for every non-empty bucket */
+  template <typename Visitor>
+  void for_each_bucket(Visitor&& visitor) const;
+
+  /* one-line summary: count, mean, p50/p99/p999 and max */
+  std::string summary(void) const;
+
+ private:
+  static constexpr unsigned int SUB_BITS = 5;
+  static constexpr uint64_t SUB_COUNT = uint64_t(1) << SUB_BITS;
+
+  std::vector<uint64_t> buckets_;
+  uint64_t count_{0};
+  uint64_t min_{UINT64_MAX};
+  uint64_t max_{0};
+  /* long double keeps sums of many large values exact enough */
+  long double sum_{0};
+
+  static size_t bucket_index(const uint64_t value);
+  static uint64_t bucket_lowest(const size_t index);
+  static uint64_t bucket_highest(const size_t index);
+};
+
+template <typename Visitor>
+void Histogram::for_each_bucket(Visitor&& visitor) const {
+  for (size_t i = 0; i < buckets_.size(); i++) {
+    if (buckets_[i] > 0) {
+      visitor(bucket_lowest(i), bucket_highest(i), buckets_[i]);
+    }
+  }
+}
+
+#endif /* HISTOGRAM_HH */
@@ -0,0 +1,311 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "io_uring.hh"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "exception.hh"
+
+using namespace std;
+
+static int io_uring_setup(const unsigned int entries, io_uring_params* params) {
+  return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_register(const int fd, const unsigned int opcode,
+                             void* arg, const unsigned int nr_args) {
+  return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static int create_ring(const unsigned int entries, io_uring_params& params) {
+  memset(&params, 0, sizeof(params));
+  /* we only submit from one thread and reap in the same thread */
+  params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN;
+
+  int fd = io_uring_setup(entries, &params);
+  if (fd < 0 and errno == EINVAL) {
+    /* older kernel without the optional setup flags */
+    memset(&params, 0, sizeof(params));
+    fd = io_uring_setup(entries, &params);
+  }
+
+  return CheckSystemCall("io_uring_setup", fd);
+}
+
+static void* map_ring(const int fd, const size_t size, const off_t offset) {
+  void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd, offset);
+  if (ptr == MAP_FAILED) {
+    throw unix_error("mmap io_uring");
+  }
+  return ptr;
+}
+
+IOUring::IOUring(const unsigned int entries)
+    : ring_fd_(create_ring(entries, params_)) {
+  if (not(params_.features & IORING_FEAT_SINGLE_MMAP)) {
+    throw runtime_error("io_uring: kernel lacks IORING_FEAT_SINGLE_MMAP");
+  }
+
+  /* the submission and completion rings share one mapping */
+  const size_t cq_ring_size =
+      params_.cq_off.cqes + params_.cq_entries * sizeof(io_uring_cqe);
+  sq_ring_size_ = max(
+      params_.sq_off.array + params_.sq_entries * sizeof(unsigned int),
+      cq_ring_size);
+  sq_ring_ = map_ring(ring_fd_.fd_num(), sq_ring_size_, IORING_OFF_SQ_RING);
+  cq_ring_ = sq_ring_;
+
+  sqes_size_ = params_.sq_entries * sizeof(io_uring_sqe);
+  sqes_ = static_cast<io_uring_sqe*>(
+      map_ring(ring_fd_.fd_num(), sqes_size_, IORING_OFF_SQES));
+
+  char* sq = static_cast<char*>(sq_ring_);
+  sq_head_ = reinterpret_cast<unsigned int*>(sq + params_.sq_off.head);
+  sq_tail_ = reinterpret_cast<unsigned int*>(sq + params_.sq_off.tail);
+  sq_mask_ = *reinterpret_cast<unsigned int*>(sq + params_.sq_off.ring_mask);
+  sq_array_ = reinterpret_cast<unsigned int*>(sq + params_.sq_off.array);
+  sq_local_tail_ = *sq_tail_;
+
+  char* cq = static_cast<char*>(cq_ring_);
+  cq_head_ = reinterpret_cast<unsigned int*>(cq + params_.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned int*>(cq + params_.cq_off.tail);
+  cq_mask_ = *reinterpret_cast<unsigned int*>(cq + params_.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params_.cq_off.cqes);
+}
+
+IOUring::~IOUring() {
+  if (buffer_ring_) {
+    io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.bgid = BUFFER_GROUP;
+    io_uring_register(ring_fd_.fd_num(), IORING_UNREGISTER_PBUF_RING, &reg, 1);
+    munmap(buffer_ring_, buffer_ring_size_);
+  }
+  munmap(sqes_, sqes_size_);
+  munmap(sq_ring_, sq_ring_size_);
+}
+
+bool IOUring::available(void) {
+  /* ENOSYS: not compiled in; EPERM: disabled by sysctl or seccomp; EINVAL:
+   * no provided buffer rings (before Linux 5.19) */
+  try {
+    IOUring probe(4);
+    probe.setup_buffer_ring(1, 64);
+    return true;
+  } catch (const exception& e) {
+    return false;
+  }
+}
+
+void IOUring::setup_buffer_ring(const uint16_t count, const size_t size) {
+  if (buffer_ring_) {
+    throw runtime_error("io_uring: buffer ring already registered");
+  }
+  if (count == 0 or (count & (count - 1)) != 0) {
+    throw runtime_error("io_uring: buffer count must be a power of two");
+  }
+
+  buffer_count_ = count;
+  buffer_size_ = size;
+  buffers_.resize(size_t(count) * size);
+
+  buffer_ring_size_ = count * sizeof(io_uring_buf);
+  void* ring = mmap(nullptr, buffer_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ring == MAP_FAILED) {
+    throw unix_error("mmap buffer ring");
+  }
+  buffer_ring_ = static_cast<io_uring_buf_ring*>(ring);
+
+  io_uring_buf_reg reg;
+  memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = reinterpret_cast<uint64_t>(buffer_ring_);
+  reg.ring_entries = count;
+  reg.bgid = BUFFER_GROUP;
+  CheckSystemCall("io_uring_register PBUF_RING",
+                  io_uring_register(ring_fd_.fd_num(),
+                                    IORING_REGISTER_PBUF_RING, &reg, 1));
+
+  for (uint16_t id = 0; id < count; id++) {
+    recycle_buffer(id);
+  }
+}
+
+void IOUring::recycle_buffer(const uint16_t buffer_id) {
+  /* the tail shares storage with the reserved field of the first entry;
+   * index the entries from the ring base, since __DECLARE_FLEX_ARRAY moves
+   * `bufs` past an empty struct when compiled as C++ */
+  const uint16_t tail = buffer_ring_->tail;
+  io_uring_buf* entries = reinterpret_cast<io_uring_buf*>(buffer_ring_);
+  io_uring_buf& entry = entries[tail & (buffer_count_ - 1)];
+
+  entry.addr = reinterpret_cast<uint64_t>(buffer(buffer_id));
+  entry.len = buffer_size_;
+  entry.bid = buffer_id;
+
+  __atomic_store_n(&buffer_ring_->tail, uint16_t(tail + 1), __ATOMIC_RELEASE);
+}
+
+io_uring_sqe* IOUring::get_sqe(void) {
+  const unsigned int head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+
+  if (sq_local_tail_ - head >= params_.sq_entries) {
+    /* queue is full: hand what we have to the kernel first */
+    submit_and_wait(0);
+  }
+
+  const unsigned int index = sq_local_tail_ & sq_mask_;
+  io_uring_sqe* sqe = &sqes_[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sq_array_[index] = index;
+
+  sq_local_tail_++;
+  to_submit_++;
+  return sqe;
+}
+
+void IOUring::prep_multishot_accept(const int fd, const uint64_t user_data) {
+  io_uring_sqe* sqe = get_sqe();
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = fd;
+  sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+  sqe->accept_flags = SOCK_CLOEXEC;
+  sqe->user_data = user_data;
+}
+
+void IOUring::prep_multishot_recv(const int fd, const uint64_t user_data) {
+  if (not buffer_ring_) {
+    throw runtime_error("io_uring: multishot recv needs a buffer ring");
+  }
+
+  io_uring_sqe* sqe = get_sqe();
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = fd;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = BUFFER_GROUP;
+  sqe->user_data = user_data;
+}
+
+void IOUring::prep_multishot_recvmsg(const int fd, msghdr* header,
+                                     const uint64_t user_data) {
+  if (not buffer_ring_) {
+    throw runtime_error("io_uring: multishot recvmsg needs a buffer ring");
+  }
+
+  io_uring_sqe* sqe = get_sqe();
+  sqe->opcode = IORING_OP_RECVMSG;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<uint64_t>(header);
+  sqe->len = 1;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = BUFFER_GROUP;
+  sqe->user_data = user_data;
+}
+
+void IOUring::prep_send(const int fd, const char* data, const size_t length,
+                        const uint64_t user_data) {
+  io_uring_sqe* sqe = get_sqe();
+  sqe->opcode = IORING_OP_SEND;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<uint64_t>(data);
+  sqe->len = length;
+  sqe->msg_flags = MSG_NOSIGNAL;
+  sqe->user_data = user_data;
+}
+
+void IOUring::prep_sendmsg(const int fd, const msghdr* message,
+                           const uint64_t user_data) {
+  io_uring_sqe* sqe = get_sqe();
+  sqe->opcode = IORING_OP_SENDMSG;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<uint64_t>(message);
+  sqe->len = 1;
+  sqe->msg_flags = MSG_NOSIGNAL;
+  sqe->user_data = user_data;
+}
+
+void IOUring::prep_read(FileDescriptor& fd, char* data, const size_t length,
+                        const uint64_t user_data) {
+  io_uring_sqe* sqe = get_sqe();
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = fd.fd_num();
+  sqe->addr = reinterpret_cast<uint64_t>(data);
+  sqe->len = length;
+  /* read at the current file position */
+  sqe->off = uint64_t(-1);
+  sqe->user_data = user_data;
+}
+
+void IOUring::prep_write(FileDescriptor& fd, const char* data,
+                         const size_t length, const uint64_t user_data) {
+  io_uring_sqe* sqe = get_sqe();
+  sqe->opcode = IORING_OP_WRITE;
+  sqe->fd = fd.fd_num();
+  sqe->addr = reinterpret_cast<uint64_t>(data);
+  sqe->len = length;
+  sqe->off = uint64_t(-1);
+  sqe->user_data = user_data;
+}
+
+void IOUring::prep_cancel(const uint64_t target_user_data,
+                          const uint64_t user_data) {
+  io_uring_sqe* sqe = get_sqe();
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = -1;
+  sqe->addr = target_user_data;
+  sqe->user_data = user_data;
+}
+
+int IOUring::enter(const unsigned int to_submit,
+                   const unsigned int min_complete, const unsigned int flags) {
+  int ret;
+  do {
+    ret = syscall(__NR_io_uring_enter, ring_fd_.fd_num(), to_submit,
+                  min_complete, flags, nullptr, 0);
+  } while (ret < 0 and errno == EINTR);
+
+  return CheckSystemCall("io_uring_enter", ret);
+}
+
+unsigned int IOUring::submit_and_wait(const unsigned int min_complete) {
+  /* publish the queued entries to the kernel */
+  __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+
+  const unsigned int to_submit = to_submit_;
+  if (to_submit == 0 and min_complete == 0) {
+    return 0;
+  }
+
+  const int submitted = enter(
+      to_submit, min_complete, min_complete > 0 ? IORING_ENTER_GETEVENTS : 0);
+  to_submit_ -= submitted;
+  return submitted;
+}
+
+IOUring::Datagram IOUring::parse_datagram(const msghdr& header,
+                                          const char* buffer,
+                                          const size_t length) {
+  if (length < sizeof(io_uring_recvmsg_out)) {
+    throw runtime_error("io_uring: short recvmsg buffer");
+  }
+
+  io_uring_recvmsg_out out;
+  memcpy(&out, buffer, sizeof(out));
+
+  /* layout: header | name (msg_namelen) | control (msg_controllen) | data */
+  const char* name = buffer + sizeof(out);
+  const char* payload = name + header.msg_namelen + header.msg_controllen;
+  const size_t available = length - (payload - buffer);
+
+  return {reinterpret_cast<const sockaddr*>(name),
+          min(out.namelen, header.msg_namelen), payload,
+          min(size_t(out.payloadlen), available),
+          bool(out.flags & MSG_TRUNC)};
+}
@@ -0,0 +1,149 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef IO_URING_HH
+#define IO_URING_HH
+
+#include <linux/io_uring.h>
+#include <sys/socket.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "file_descriptor.hh"
+
+/* io_uring engine built directly on the io_uring system calls.
+ *
+ * Requests are only queued by the prep_*() methods; submit_and_wait() hands
+ * every queued request to the kernel with a single io_uring_enter(), which
+ * also reaps completions. Multishot receives pick their buffers from one
+ * provided buffer ring, so a busy socket costs no syscall per message.
+ *
+ * Not thread safe: one thread prepares, submits and reaps. */
+class IOUring {
+ public:
+  struct Completion {
+    uint64_t user_data;
+    int32_t res;
+    uint32_t flags;
+
+    /* a multishot request stays armed while this is set */
+    bool more(void) const { return flags & IORING_CQE_F_MORE; }
+    bool has_buffer(void) const { return flags & IORING_CQE_F_BUFFER; }
+    uint16_t buffer_id(void) const { return flags >> IORING_CQE_BUFFER_SHIFT; }
+  };
+
+  /* datagram received by a multishot recvmsg */
+  struct Datagram {
+    const sockaddr* name;
+    socklen_t name_length;
+    const char* payload;
+    size_t payload_length;
+    bool truncated;
+  };
+
+  IOUring(const unsigned int entries = 256);
+  ~IOUring();
+
+  /* whether the running kernel lets this process create a ring */
+  static bool available(void);
+
+  /* register `count` buffers of `size` bytes for multishot receives */
+  void setup_buffer_ring(const uint16_t count, const size_t size);
+  char* buffer(const uint16_t buffer_id) {
+    return &buffers_[size_t(buffer_id) * buffer_size_];
+  }
+  size_t buffer_size(void) const { return buffer_size_; }
+  /* give a consumed buffer back to the kernel */
+  void recycle_buffer(const uint16_t buffer_id);
+
+  void prep_multishot_accept(const int fd, const uint64_t user_data);
+  void prep_multishot_recv(const int fd, const uint64_t user_data);
+  /* `header` must stay alive while the request is armed; only its
+   * msg_namelen and msg_controllen are used */
+  void prep_multishot_recvmsg(const int fd, msghdr* header,
+                              const uint64_t user_data);
+  /* `data` (and `message`) must stay alive until the completion */
+  void prep_send(const int fd, const char* data, const size_t length,
+                 const uint64_t user_data);
+  void prep_sendmsg(const int fd, const msghdr* message,
+                    const uint64_t user_data);
+  void prep_read(FileDescriptor& fd, char* data, const size_t length,
+                 const uint64_t user_data);
+  void prep_write(FileDescriptor& fd, const char* data, const size_t length,
+                  const uint64_t user_data);
+  void prep_cancel(const uint64_t target_user_data, const uint64_t user_data);
+
+  /* submit all queued requests, then wait until at least `min_complete`
+   * completions are ready; returns the number of requests submitted */
+  unsigned int submit_and_wait(const unsigned int min_complete = 1);
+
+  /* hand every ready completion to `handler` and mark them consumed */
+  template <typename Handler>
+  unsigned int for_each_completion(Handler&& handler);
+
+  /* locate the pieces of a multishot recvmsg result in its buffer */
+  static Datagram parse_datagram(const msghdr& header, const char* buffer,
+                                 const size_t length);
+
+  /* forbid copying and moving: the kernel holds pointers into the rings */
+  IOUring(const IOUring& other) = delete;
+  IOUring& operator=(const IOUring& other) = delete;
+
+ private:
+  static constexpr uint16_t BUFFER_GROUP = 0;
+
+  /* filled in by io_uring_setup() while ring_fd_ is constructed */
+  io_uring_params params_{};
+  FileDescriptor ring_fd_;
+
+  /* mmapped regions */
+  void* sq_ring_{nullptr};
+  size_t sq_ring_size_{0};
+  void* cq_ring_{nullptr};
+  io_uring_sqe* sqes_{nullptr};
+  size_t sqes_size_{0};
+
+  /* submission queue */
+  unsigned int* sq_head_{nullptr};
+  unsigned int* sq_tail_{nullptr};
+  unsigned int sq_mask_{0};
+  unsigned int* sq_array_{nullptr};
+  unsigned int sq_local_tail_{0};
+  unsigned int to_submit_{0};
+
+  /* completion queue */
+  unsigned int* cq_head_{nullptr};
+  unsigned int* cq_tail_{nullptr};
+  unsigned int cq_mask_{0};
+  io_uring_cqe* cqes_{nullptr};
+
+  /* provided buffer ring */
+  io_uring_buf_ring* buffer_ring_{nullptr};
+  size_t buffer_ring_size_{0};
+  uint16_t buffer_count_{0};
+  size_t buffer_size_{0};
+  std::vector<char> buffers_{};
+
+  io_uring_sqe* get_sqe(void);
+  int enter(const unsigned int to_submit, const unsigned int min_complete,
+            const unsigned int flags);
+};
+
+template <typename Handler>
+unsigned int IOUring::for_each_completion(Handler&& handler) {
+  /* the ring indices are shared with the kernel */
+  unsigned int head = *cq_head_;
+  const unsigned int tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+  unsigned int count = 0;
+
+  for (; head != tail; head++, count++) {
+    const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+    handler(Completion{cqe.user_data, cqe.res, cqe.flags});
+  }
+
+  __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+  return count;
+}
+
+#endif /* IO_URING_HH */
@@ -2,9 +2,12 @@
 
 #include <sys/fcntl.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <unistd.h>
 
+#include <cstring>
+
 #include "exception.hh"
 
 using namespace std;
@@ -116,4 +119,72 @@ string::const_iterator IPCSocket::write(const std::string& buffer,
   } while (write_all and (it != buffer.end()));
 
   return it;
-}
\ No newline at end of file
+}
+
+size_t IPCSocket::writev(initializer_list<string_view> buffers,
+                         const bool write_all) {
+  if (not connected_.load()) return 0;
+
+  try {
+    return FileDescriptor::writev(buffers, write_all);
+  } catch (const unix_error& e) {
+    connected_.store(false);
+    return 0;
+  }
+}
+
+void IPCSocket::send_fd(const FileDescriptor& fd) {
+  /* at least one byte of data has to go along */
+  char data = 0;
+  iovec iov{&data, sizeof(data)};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &fd.fd_num(), sizeof(int));
+
+  SystemCall("sendmsg SCM_RIGHTS", sendmsg(fd_num(), &msg, MSG_NOSIGNAL));
+  register_write();
+}
+
+FileDescriptor IPCSocket::recv_fd(void) {
+  char data;
+  iovec iov{&data, sizeof(data)};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  if (SystemCall("recvmsg SCM_RIGHTS",
+                 recvmsg(fd_num(), &msg, MSG_CMSG_CLOEXEC)) == 0) {
+    set_eof();
+    throw runtime_error("recv_fd: peer closed without passing a descriptor");
+  }
+  register_read();
+
+  const cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  if (cmsg == nullptr or cmsg->cmsg_level != SOL_SOCKET or
+      cmsg->cmsg_type != SCM_RIGHTS or cmsg->cmsg_len != CMSG_LEN(sizeof(int))) {
+    throw runtime_error("recv_fd: no descriptor received");
+  }
+  int fd;
+  memcpy(&fd, CMSG_DATA(cmsg), sizeof(fd));
+  return FileDescriptor(fd);
+}
+
+pid_t IPCSocket::peer_pid(void) const {
+  ucred credentials;
+  getsockopt(SOL_SOCKET, SO_PEERCRED, credentials);
+  return credentials.pid;
+}
@@ -39,6 +39,18 @@ class IPCSocket : public FileDescriptor {
   /* override write; add sanity check*/
   virtual std::string::const_iterator write(const std::string& buffer,
                                             const bool write_all = true);
+  /* the same check for gather writes: returns 0 once disconnected */
+  virtual size_t writev(std::initializer_list<std::string_view> buffers,
+                        const bool write_all = true) override;
+
+  /* pass a file descriptor to the peer (SCM_RIGHTS); the peer gets its own
+   * copy, so `fd` may be closed afterwards */
+  void send_fd(const FileDescriptor& fd);
+  /* receive a file descriptor passed by send_fd(); throws at EOF */
+  FileDescriptor recv_fd(void);
+
+  /* pid of the connected peer */
+  pid_t peer_pid(void) const;
 
  protected:
   /* get and set socket option */
@@ -1,53 +1,344 @@
 #include "logging.hh"
 
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+
 #include <algorithm>
+#include <atomic>
 #include <chrono>
-#include <iomanip>
-#include <iostream>
-#include <sstream>
+#include <condition_variable>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+int64_t RealtimeMicros() {
+  timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return int64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+// One thread's messages on their way to the writer: a single-producer,
+// single-consumer ring of records, each a header followed by the text.
+class LogBuffer {
+ public:
+  struct Record {
+    int64_t realtime_us;
+    const char* fname;
+    int32_t line;
+    LogLevel severity;
+    // PADDING marks the rest of the ring as unused before wrapping
+    uint32_t length;
+  };
+
+  static constexpr size_t CAPACITY = 64 * 1024;
+  // the largest text that goes through the ring
+  static constexpr size_t MAX_LENGTH = CAPACITY / 4;
+
+  // false if the ring has no room
+  bool Push(const Record& record, std::string_view text) {
+    const size_t size = RecordSize(text.size());
+    const uint64_t head = head_.load(std::memory_order_relaxed);
+    const uint64_t tail = tail_.load(std::memory_order_acquire);
+    const size_t offset = head % CAPACITY;
+    const size_t to_end = CAPACITY - offset;
+    // a record never wraps: skip to the start instead
+    const size_t skip = to_end < size ? to_end : 0;
+    if (CAPACITY - (head - tail) < skip + size) {
+      return false;
+    }
+    if (skip >= sizeof(Record)) {
+      Record padding{};
+      padding.length = PADDING;
+      memcpy(&data_[offset], &padding, sizeof(padding));
+    }
+    char* slot = &data_[(head + skip) % CAPACITY];
+    memcpy(slot, &record, sizeof(record));
+    memcpy(slot + sizeof(record), text.data(), text.size());
+    head_.store(head + skip + size, std::memory_order_release);
+    return true;
+  }
+
+  // visit and release every record pushed so far
+  template <typename Visitor>
+  void Drain(Visitor&& visit) {
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    const uint64_t head = head_.load(std::memory_order_acquire);
+    while (tail < head) {
+      const size_t offset = tail % CAPACITY;
+      const size_t to_end = CAPACITY - offset;
+      Record record;
+      if (to_end >= sizeof(record)) {
+        memcpy(&record, &data_[offset], sizeof(record));
+      }
+      if (to_end < sizeof(record) || record.length == PADDING) {
+        tail += to_end;
+        continue;
+      }
+      visit(record, std::string_view(&data_[offset + sizeof(record)],
+                                     record.length));
+      tail += RecordSize(record.length);
+    }
+    tail_.store(tail, std::memory_order_release);
+  }
+
+  // called once the owning thread has pushed its last record
+  void Retire() { retired_.store(true, std::memory_order_release); }
+  bool retired() const { return retired_.load(std::memory_order_acquire); }
+
+ private:
+  static constexpr uint32_t PADDING = UINT32_MAX;
+
+  static size_t RecordSize(const size_t length) {
+    return (sizeof(Record) + length + 7) & ~size_t(7);
+  }
+
+  alignas(64) std::atomic<uint64_t> head_{0};
+  alignas(64) std::atomic<uint64_t> tail_{0};
+  std::atomic<bool> retired_{false};
+  char data_[CAPACITY];
+};
+
+// A thread's hold on its LogBuffer: retires the buffer when the thread
+// exits, and the writer frees it after draining it one last time.
+class BufferOwner {
+ public:
+  explicit BufferOwner(LogBuffer* buffer) : buffer_(buffer) {}
+  ~BufferOwner() {
+    buffer_->Retire();
+    buffer_ = nullptr;
+  }
+
+  BufferOwner(const BufferOwner&) = delete;
+  BufferOwner& operator=(const BufferOwner&) = delete;
+
+  // null once the thread is exiting
+  LogBuffer* buffer() const { return buffer_; }
+
+ private:
+  LogBuffer* buffer_;
+};
+
+// Collects the messages of every thread and writes them to stderr.
+class AsyncLog {
+ public:
+  // never destroyed, so that threads still running at exit can log; what
+  // they logged before is flushed by an atexit handler
+  static AsyncLog& Get() {
+    static AsyncLog* log = [] {
+      auto* log = new AsyncLog();
+      atexit(FlushLog);
+      return log;
+    }();
+    return *log;
+  }
+
+  void Append(LogLevel severity, const char* fname, int line,
+              std::string_view text) {
+    if (!writer_running_.load(std::memory_order_acquire)) {
+      StartWriter();
+    }
+    const LogBuffer::Record record{RealtimeMicros(), fname, line, severity,
+                                   uint32_t(text.size())};
+    LogBuffer* buffer = ThreadBuffer();
+    if (text.size() > LogBuffer::MAX_LENGTH || !buffer ||
+        !buffer->Push(record, text)) {
+      // the writer has fallen behind, or this thread is exiting: write this
+      // one ourselves, after what is already queued
+      WriteSync(record, text);
+      return;
+    }
+    // warnings and worse should not wait for the next periodic flush
+    if (severity >= LogLevel::WARNING) {
+      wakeup_.notify_one();
+    }
+  }
+
+  void WriteSync(const LogBuffer::Record& record, std::string_view text) {
+    std::lock_guard<std::mutex> lock(drain_mutex_);
+    DrainLocked();
+    std::string out;
+    Format(record, text, out);
+    fwrite(out.data(), 1, out.size(), stderr);
+    fflush(stderr);
+  }
+
+  void Flush() {
+    std::lock_guard<std::mutex> lock(drain_mutex_);
+    DrainLocked();
+  }
+
+  // joins the writer, then writes what is left; the next Append() starts a
+  // new writer
+  void StopWriter() {
+    {
+      std::lock_guard<std::mutex> lock(writer_mutex_);
+      if (writer_running_.load(std::memory_order_relaxed)) {
+        {
+          std::lock_guard<std::mutex> wakeup_lock(wakeup_mutex_);
+          stop_writer_ = true;
+        }
+        wakeup_.notify_one();
+        writer_.join();
+        writer_running_.store(false, std::memory_order_release);
+      }
+    }
+    Flush();
+  }
+
+ private:
+  static constexpr auto FLUSH_INTERVAL = std::chrono::milliseconds(20);
+
+  AsyncLog() : log_time_(LogTimeFromEnv()) {}
+
+  void StartWriter() {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    if (writer_running_.load(std::memory_order_relaxed)) {
+      return;
+    }
+    stop_writer_ = false;
+    // no signal handler may run on the writer while it holds drain_mutex_
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &previous);
+    writer_ = std::thread(&AsyncLog::WriterLoop, this);
+    pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+    writer_running_.store(true, std::memory_order_release);
+  }
+
+  LogBuffer* ThreadBuffer() {
+    // owned by the registry, so that messages outlive their thread
+    thread_local BufferOwner owner(Register());
+    return owner.buffer();
+  }
+
+  LogBuffer* Register() {
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    buffers_.push_back(std::make_unique<LogBuffer>());
+    return buffers_.back().get();
+  }
+
+  void WriterLoop() {
+    std::unique_lock<std::mutex> lock(wakeup_mutex_);
+    while (!stop_writer_) {
+      wakeup_.wait_for(lock, FLUSH_INTERVAL);
+      Flush();
+    }
+  }
+
+  // requires drain_mutex_
+  void DrainLocked() {
+    {
+      std::lock_guard<std::mutex> lock(registry_mutex_);
+      for (auto it = buffers_.begin(); it != buffers_.end();) {
+        // checked before draining: a retired buffer gets no more records
+        const bool retired = (*it)->retired();
+        (*it)->Drain([this](const LogBuffer::Record& record,
+                            std::string_view text) {
+          pending_.emplace_back(record.realtime_us, std::string());
+          Format(record, text, pending_.back().second);
+        });
+        if (retired) {
+          it = buffers_.erase(it);
+        } else {
+          ++it;
+        }
+      }
+    }
+    if (pending_.empty()) {
+      return;
+    }
+    // interleave the threads in time order
+    std::stable_sort(
+        pending_.begin(), pending_.end(),
+        [](const auto& a, const auto& b) { return a.first < b.first; });
+    for (const auto& line : pending_) {
+      fwrite(line.second.data(), 1, line.second.size(), stderr);
+    }
+    fflush(stderr);
+    pending_.clear();
+  }
+
+  // the format LogMessage has always written, timestamp included
+  void Format(const LogBuffer::Record& record, std::string_view text,
+              std::string& out) {
+    char prefix[64];
+    int length;
+    if (log_time_) {
+      const time_t seconds = record.realtime_us / 1000000;
+      if (seconds != formatted_second_) {
+        // only the seconds need localtime and strftime, once per second
+        tm local;
+        localtime_r(&seconds, &local);
+        strftime(formatted_time_, sizeof(formatted_time_),
+                 "%Y-%m-%d %H:%M:%S", &local);
+        formatted_second_ = seconds;
+      }
+      length = snprintf(prefix, sizeof(prefix), "[%s.%6d: %c ",
+                        formatted_time_, int(record.realtime_us % 1000000),
+                        LOG_LEVELS[static_cast<int>(record.severity)]);
+    } else {
+      length = snprintf(prefix, sizeof(prefix), "[%c ",
+                        LOG_LEVELS[static_cast<int>(record.severity)]);
+    }
+    out.append(prefix, length);
+    out += record.fname;
+    out += ':';
+    out += std::to_string(record.line);
+    out += "] ";
+    out += text;
+    out += '\n';
+  }
+
+  const bool log_time_;
+
+  std::mutex registry_mutex_{};
+  std::vector<std::unique_ptr<LogBuffer>> buffers_{};
+
+  // serializes draining, which the writer and WriteSync() both do
+  std::mutex drain_mutex_{};
+  std::vector<std::pair<int64_t, std::string>> pending_{};
+  time_t formatted_second_{-1};
+  char formatted_time_[32]{};
+
+  // serializes starting and stopping the writer
+  std::mutex writer_mutex_{};
+  std::thread writer_{};
+  std::atomic<bool> writer_running_{false};
+
+  std::mutex wakeup_mutex_{};
+  std::condition_variable wakeup_{};
+  // requires wakeup_mutex_
+  bool stop_writer_{false};
+};
+
+}  // namespace
 
 LogMessage::LogMessage(const char* fname, int line, LogLevel severity)
     : fname_(fname), line_(line), severity_(severity) {}
 
-void LogMessage::GenerateLogMessage(bool log_time) {
-  // we want all logs to go to stderr
-  // original level to use stderr is INFO
-  bool use_cout =
-      static_cast<int>(severity_) < static_cast<int>(LogLevel::TRACE);
-  // std::ostream& os = use_cout ? std::cout : std::cerr;
-  std::stringstream stream;
-  auto os = use_cout ? stdout : stderr;
-  if (log_time) {
-    auto now = std::chrono::system_clock::now();
-    auto as_time_t = std::chrono::system_clock::to_time_t(now);
-
-    auto duration = now.time_since_epoch();
-    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(duration);
-    auto micros_remainder =
-        std::chrono::duration_cast<std::chrono::microseconds>(duration -
-                                                              seconds);
-
-    const size_t time_buffer_size = 30;
-    char time_buffer[time_buffer_size];
-    strftime(time_buffer, time_buffer_size, "%Y-%m-%d %H:%M:%S",
-             localtime(&as_time_t));
-    stream << "[" << time_buffer << "." << std::setw(6) << micros_remainder.count()
-       << ": " << LOG_LEVELS[static_cast<int>(severity_)] << " " << fname_
-       << ":" << line_ << "] " << str() << std::endl;
+void LogMessage::GenerateLogMessage(bool sync) {
+  const std::string text = str();
+  if (sync) {
+    AsyncLog::Get().WriteSync({RealtimeMicros(), fname_, line_, severity_,
+                               uint32_t(text.size())},
+                              text);
   } else {
-    stream << "[" << LOG_LEVELS[static_cast<int>(severity_)] << " " << fname_ << ":"
-       << line_ << "] " << str() << std::endl;
+    AsyncLog::Get().Append(severity_, fname_, line_, text);
   }
-  // dump stream.str to stdout/stderr
-  fprintf(os, stream.str().c_str());
 }
 
 LogMessage::~LogMessage() {
-  static LogLevel min_log_level = MinLogLevelFromEnv();
-  static bool log_time = LogTimeFromEnv();
-  if (severity_ >= min_log_level) {
-    GenerateLogMessage(log_time);
+  if (severity_ >= MinLogLevel()) {
+    GenerateLogMessage(false);
   }
 }
 
@@ -55,11 +346,14 @@ LogMessageFatal::LogMessageFatal(const char* file, int line)
     : LogMessage(file, line, LogLevel::FATAL) {}
 
 LogMessageFatal::~LogMessageFatal() {
-  static bool log_time = LogTimeFromEnv();
-  GenerateLogMessage(log_time);
+  GenerateLogMessage(true);
   abort();
 }
 
+void FlushLog() { AsyncLog::Get().Flush(); }
+
+void StopLogThread() { AsyncLog::Get().StopWriter(); }
+
 LogLevel ParseLogLevelStr(const char* env_var_val) {
   std::string min_log_level(env_var_val);
   std::transform(min_log_level.begin(), min_log_level.end(),
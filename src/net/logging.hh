@@ -10,6 +10,12 @@ enum class LogLevel { TRACE, DEBUG, INFO, WARNING, ERROR, FATAL };
 
 #define LOG_LEVELS "TDIWEF"
 
+// LOG() below this level is compiled out, arguments and all
+// (0 = TRACE ... 5 = FATAL; see LOG_MIN_LEVEL in CMakeLists.txt)
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 0
+#endif
+
 // Always-on checking
 #define CHECK(x) \
   if (!(x))      \
@@ -48,13 +54,16 @@ enum class LogLevel { TRACE, DEBUG, INFO, WARNING, ERROR, FATAL };
     CHECK(r == ncclSuccess) << "NCCL error: " << ncclGetErrorString(r); \
   }
 
+// Enabled messages are handed to a per-thread buffer and written to stderr
+// by a background thread, which also formats the timestamps; FATAL messages
+// flush everything and are written synchronously.
 class LogMessage : public std::basic_ostringstream<char> {
  public:
   LogMessage(const char* fname, int line, LogLevel severity);
   ~LogMessage();
 
  protected:
-  void GenerateLogMessage(bool log_time);
+  void GenerateLogMessage(bool sync);
 
  private:
   const char* fname_;
@@ -70,12 +79,38 @@ class LogMessageFatal : public LogMessage {
   ~LogMessageFatal();
 };
 
-#define _LOG_TRACE LogMessage(__FILE__, __LINE__, LogLevel::TRACE)
-#define _LOG_DEBUG LogMessage(__FILE__, __LINE__, LogLevel::DEBUG)
-#define _LOG_INFO LogMessage(__FILE__, __LINE__, LogLevel::INFO)
-#define _LOG_WARNING LogMessage(__FILE__, __LINE__, LogLevel::WARNING)
-#define _LOG_ERROR LogMessage(__FILE__, __LINE__, LogLevel::ERROR)
-#define _LOG_FATAL LogMessageFatal(__FILE__, __LINE__)
+// turns the message expression into void so that it can sit in a ?:
+class LogMessageVoidify {
+ public:
+  void operator&(const std::ostream&) {}
+};
+
+LogLevel MinLogLevelFromEnv();
+bool LogTimeFromEnv();
+
+inline LogLevel MinLogLevel() {
+  static const LogLevel min_log_level = MinLogLevelFromEnv();
+  return min_log_level;
+}
+
+// a disabled message is one branch: neither the stream nor the arguments
+// are evaluated
+#define _LOG_ENABLED(severity)                                  \
+  (static_cast<int>(LogLevel::severity) >= LOG_COMPILE_LEVEL && \
+   LogLevel::severity >= MinLogLevel())
+#define _LOG_IF(severity) \
+  !_LOG_ENABLED(severity) ? (void)0 : LogMessageVoidify() &
+
+#define _LOG_TRACE \
+  _LOG_IF(TRACE) LogMessage(__FILE__, __LINE__, LogLevel::TRACE)
+#define _LOG_DEBUG \
+  _LOG_IF(DEBUG) LogMessage(__FILE__, __LINE__, LogLevel::DEBUG)
+#define _LOG_INFO _LOG_IF(INFO) LogMessage(__FILE__, __LINE__, LogLevel::INFO)
+#define _LOG_WARNING \
+  _LOG_IF(WARNING) LogMessage(__FILE__, __LINE__, LogLevel::WARNING)
+#define _LOG_ERROR \
+  _LOG_IF(ERROR) LogMessage(__FILE__, __LINE__, LogLevel::ERROR)
+#define _LOG_FATAL LogMessageVoidify() & LogMessageFatal(__FILE__, __LINE__)
 
 #define _LOG(severity) _LOG_##severity
 
@@ -84,7 +119,11 @@ class LogMessageFatal : public LogMessage {
 #define GET_LOG(_1, _2, NAME, ...) NAME
 #define LOG(...) GET_LOG(__VA_ARGS__, _LOG_RANK, _LOG)(__VA_ARGS__)
 
-LogLevel MinLogLevelFromEnv();
-bool LogTimeFromEnv();
+// write out everything logged so far
+void FlushLog();
+
+// flush, and stop the thread that writes the log until the next message, so
+// that the process is single-threaded again and may fork (see ChildProcess)
+void StopLogThread();
 
 #endif  // LOGGING_HH
@@ -0,0 +1,58 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "observation_sampler.hh"
+
+#include <exception>
+#include <stdexcept>
+
+#include "logging.hh"
+#include "pipe.hh"
+#include "poller.hh"
+
+using namespace std;
+using namespace PollerShortNames;
+
+ObservationSampler::ObservationSampler(DeepCCSocket& sock,
+                                       const uint64_t period_us,
+                                       const Mode mode)
+    : sock_(sock),
+      period_us_(period_us),
+      mode_(mode),
+      stop_pipe_(make_pipe()) {
+  if (period_us == 0) {
+    throw runtime_error("ObservationSampler: period must be positive");
+  }
+  sampler_ = thread(&ObservationSampler::loop, this);
+}
+
+ObservationSampler::~ObservationSampler() {
+  stop_pipe_.second.write("x");
+  sampler_.join();
+}
+
+void ObservationSampler::loop(void) {
+  Poller poller;
+  bool failed = false;
+
+  poller.add_action(Poller::Action(stop_pipe_.first, Direction::In, [] {
+    return ResultType::Exit;
+  }));
+  poller.add_periodic_timer(period_us_, [this, &failed] {
+    try {
+      if (mode_ == Mode::Watch) {
+        sock_.watch();
+      } else {
+        sock_.observe();
+      }
+    } catch (const exception& e) {
+      LOG(WARNING) << "ObservationSampler stops: " << e.what();
+      failed = true;
+      return;
+    }
+    samples_++;
+  });
+
+  while (not failed and
+         poller.poll(-1).result != Poller::Result::Type::Exit) {
+  }
+}
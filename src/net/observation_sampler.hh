@@ -0,0 +1,60 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef OBSERVATION_SAMPLER_HH
+#define OBSERVATION_SAMPLER_HH
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <utility>
+
+#include "deepcc_socket.hh"
+#include "file_descriptor.hh"
+
+/* takes intermediate observations of a DeepCCSocket every `period_us` on a
+ * thread of its own, between the control loop's requests.
+ *
+ * Each REQUEST_ACTION then merges the observations made since the previous
+ * one, so the averages a step sees cover many samples across the interval,
+ * and the sampling goes on while the control loop waits for an action.
+ * With the patched kernel, whose averages restart at every read, this
+ * changes nothing but max_packets_out; with TCP_INFO, where RTT is read as
+ * a single smoothed value per sample, it is what makes avg_urtt an average.
+ *
+ * The thread runs a Poller with a periodic timer, so late observations skip
+ * the periods they missed instead of bunching up.
+ *
+ * With Mode::Watch it is the only sampler of a flow that nothing controls:
+ * each sample is a step of its own (DeepCCSocket::watch()), which readers
+ * pick up from the socket's snapshot.
+ *
+ * Stops when destroyed, or at the first error from the socket. */
+class ObservationSampler {
+ public:
+  enum class Mode { Observe, Watch };
+
+  ObservationSampler(DeepCCSocket& sock, const uint64_t period_us,
+                     const Mode mode = Mode::Observe);
+  ~ObservationSampler();
+
+  /* observations made so far */
+  uint64_t samples(void) const { return samples_.load(); }
+
+  /* forbid copying ObservationSampler objects or assigning them */
+  ObservationSampler(const ObservationSampler& other) = delete;
+  const ObservationSampler& operator=(const ObservationSampler& other) =
+      delete;
+
+ private:
+  DeepCCSocket& sock_;
+  const uint64_t period_us_;
+  const Mode mode_;
+  std::atomic<uint64_t> samples_{0};
+  /* the destructor writes to it to stop the sampler */
+  std::pair<FileDescriptor, FileDescriptor> stop_pipe_;
+  std::thread sampler_{};
+
+  void loop(void);
+};
+
+#endif /* OBSERVATION_SAMPLER_HH */
@@ -0,0 +1,197 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "offline_state_provider.hh"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "exception.hh"
+#include "perf_log.hh"
+#include "timestamp.hh"
+
+using namespace std;
+
+/* a record of a binary perf log, in the column order of the TSV form */
+static TCPDeepCCInfo perf_log_record(const uint64_t* values) {
+  TCPDeepCCInfo info;
+  info.init();
+  info.min_rtt = values[0];
+  info.avg_urtt = values[1];
+  info.cnt = values[2];
+  /* the perf log stores srtt in us, the service expects it << 3 */
+  info.srtt_us = values[3] << 3;
+  info.avg_thr = values[4];
+  info.thr_cnt = values[5];
+  info.pacing_rate = values[6];
+  info.lost_bytes = values[7];
+  info.packets_out = values[8];
+  info.retrans_out = values[9];
+  info.max_packets_out = values[10];
+  info.cwnd = values[11];
+  info.mss = OFFLINE_MSS;
+  return info;
+}
+
+vector<TCPDeepCCInfo> load_perf_log_states(const string& path) {
+  ifstream log(path);
+  if (not log.is_open()) {
+    throw runtime_error("cannot open perf log " + path);
+  }
+
+  vector<TCPDeepCCInfo> rows;
+  char magic[sizeof(PerfLog::MAGIC)] = {};
+  log.read(magic, sizeof(magic));
+  const bool binary = log.gcount() == sizeof(magic) and
+                      equal(magic, magic + sizeof(magic), PerfLog::MAGIC);
+  if (binary) {
+    const PerfLogReader reader(path);
+    if (reader.columns().size() != 13) {
+      throw runtime_error("unexpected columns in perf log " + path);
+    }
+    reader.for_each([&](const uint64_t, const uint64_t* values) {
+      rows.push_back(perf_log_record(values));
+    });
+  } else {
+    log.clear();
+    log.seekg(0);
+  }
+
+  /* text logs: min_rtt avg_urtt cnt srtt_us avg_thr thr_cnt pacing_rate
+   * loss_bytes packets_out retrans_out max_packets_out cwnd assigned_cwnd */
+  string line;
+  while (not binary and getline(log, line)) {
+    istringstream fields(line);
+    TCPDeepCCInfo info;
+    info.init();
+    u32 srtt_us, assigned_cwnd;
+    if (not(fields >> info.min_rtt >> info.avg_urtt >> info.cnt >> srtt_us >>
+            info.avg_thr >> info.thr_cnt >> info.pacing_rate >>
+            info.lost_bytes >> info.packets_out >> info.retrans_out >>
+            info.max_packets_out >> info.cwnd >> assigned_cwnd)) {
+      continue;
+    }
+    info.srtt_us = srtt_us << 3;
+    info.mss = OFFLINE_MSS;
+    rows.push_back(info);
+  }
+  if (rows.empty()) {
+    throw runtime_error("no samples in perf log " + path);
+  }
+  return rows;
+}
+
+TCPDeepCCInfo synthesize_state(const SyntheticLink& link, const u32 cwnd,
+                               const u64 interval_us, mt19937& rng) {
+  uniform_real_distribution<double> noise(0.0, 0.05);
+  const double bdp_packets =
+      max(1.0, double(link.bandwidth) * link.base_rtt_us / 1e6 / OFFLINE_MSS);
+  const double queue = max(0.0, cwnd - bdp_packets) / bdp_packets;
+  const double rtt_us = link.base_rtt_us * (1 + queue) * (1 + noise(rng));
+
+  TCPDeepCCInfo info;
+  info.init();
+  info.mss = OFFLINE_MSS;
+  info.cwnd = cwnd;
+  info.min_rtt = link.base_rtt_us;
+  info.avg_urtt = rtt_us;
+  info.srtt_us = u32(rtt_us) << 3;
+  info.cnt = max(u64(1), interval_us / u64(rtt_us));
+  info.thr_cnt = info.cnt;
+  info.avg_thr =
+      min(double(link.bandwidth), cwnd * OFFLINE_MSS * 1e6 / rtt_us) *
+      (1 - noise(rng));
+  info.pacing_rate = min(u64(UINT32_MAX), u64(info.avg_thr * 1.2));
+  info.packets_out = min(double(cwnd), bdp_packets * (1 + queue));
+  info.max_packets_out = info.packets_out;
+  /* drop what does not fit in a queue of one BDP */
+  info.lost_bytes =
+      queue > 1 ? u32((queue - 1) * bdp_packets * OFFLINE_MSS * noise(rng))
+                : 0;
+  info.retrans_out = queue > 1 ? 1 : 0;
+  return info;
+}
+
+OfflineStateProvider::OfflineStateProvider(const double time_scale,
+                                           const string& actions_log)
+    : time_scale_(time_scale), actions_log_(actions_log) {
+  if (not(time_scale_ > 0)) {
+    throw runtime_error("OfflineStateProvider: time scale must be positive");
+  }
+}
+
+OfflineStateProvider::~OfflineStateProvider() {
+  if (actions_log_.empty()) {
+    return;
+  }
+  ofstream log(actions_log_);
+  log << "time_us\tcwnd\n";
+  for (const auto& [time_us, cwnd] : actuations_) {
+    log << time_us << "\t" << cwnd << "\n";
+  }
+  if (not log) {
+    cerr << "OfflineStateProvider: failed to write " << actions_log_ << endl;
+  }
+}
+
+string OfflineStateProvider::congestion_control(const string& cc) const {
+  return cc == "astraea" ? "cubic" : cc;
+}
+
+void OfflineStateProvider::enable(const int, const int) {
+  /* nothing in the kernel to enable */
+}
+
+void OfflineStateProvider::set_cwnd(const int, const uint32_t cwnd) {
+  cwnd_ = cwnd;
+  actuations_.emplace_back(elapsed_us(), cwnd);
+}
+
+uint64_t OfflineStateProvider::elapsed_us(void) {
+  const uint64_t now = monotonic_usecs();
+  if (start_us_ == 0) {
+    start_us_ = now;
+  }
+  return (now - start_us_) * time_scale_;
+}
+
+ReplayStateProvider::ReplayStateProvider(const string& path,
+                                         const double time_scale,
+                                         const string& actions_log)
+    : OfflineStateProvider(time_scale, actions_log),
+      states_(load_perf_log_states(path)) {}
+
+TCPDeepCCInfo ReplayStateProvider::sample(const int) {
+  elapsed_us();
+  /* past the end, keep reporting the last state */
+  TCPDeepCCInfo info = states_[min(next_, states_.size() - 1)];
+  next_++;
+  if (cwnd() > 0) {
+    info.cwnd = cwnd();
+  }
+  return info;
+}
+
+SyntheticStateProvider::SyntheticStateProvider(const SyntheticLink& link,
+                                               const uint64_t duration_us,
+                                               const double time_scale,
+                                               const string& actions_log,
+                                               const uint32_t seed)
+    : OfflineStateProvider(time_scale, actions_log),
+      link_(link),
+      duration_us_(duration_us),
+      rng_(seed) {
+  if (link_.bandwidth == 0 or link_.base_rtt_us == 0) {
+    throw runtime_error("SyntheticStateProvider: empty link");
+  }
+}
+
+TCPDeepCCInfo SyntheticStateProvider::sample(const int) {
+  const uint64_t now = elapsed_us();
+  const uint64_t interval_us = now - last_us_;
+  last_us_ = now;
+  /* the initial window until the controller sets one */
+  return synthesize_state(link_, cwnd() > 0 ? cwnd() : 10, interval_us, rng_);
+}
@@ -0,0 +1,117 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef OFFLINE_STATE_PROVIDER_HH
+#define OFFLINE_STATE_PROVIDER_HH
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tcp_info.hh"
+#include "tcp_state_provider.hh"
+
+/* MSS of recorded and synthesized states */
+static constexpr u32 OFFLINE_MSS = 1448;
+
+/* the states a perf log recorded, one per control step; binary logs and
+ * their TSV form are both read. Throws if there is none. */
+std::vector<TCPDeepCCInfo> load_perf_log_states(const std::string& path);
+
+/* a single flow on a link of `bandwidth` (bytes per second) and
+ * `base_rtt_us`, with the queue following the window it was given */
+struct SyntheticLink {
+  u64 bandwidth;
+  u32 base_rtt_us;
+};
+
+/* the state such a flow reports after `interval_us` with `cwnd` packets */
+TCPDeepCCInfo synthesize_state(const SyntheticLink& link, const u32 cwnd,
+                               const u64 interval_us, std::mt19937& rng);
+
+/* states that come from no kernel: the socket is left alone, and the
+ * windows the controller sets are recorded instead of applied.
+ *
+ * With a time scale of N, an interval of T runs in T/N: the tools divide
+ * their control interval by time_scale() and the provider multiplies the
+ * time that passes by it, so a long run replays in a fraction of the time
+ * and the controller still sees the nominal intervals. */
+class OfflineStateProvider : public TCPStateProvider {
+ public:
+  /* (time since the first sample in us, scaled, and the window) */
+  typedef std::pair<uint64_t, uint32_t> Actuation;
+
+  /* if `actions_log` is not empty, the actuations are written there as
+   * tab-separated text when the provider goes away */
+  OfflineStateProvider(const double time_scale,
+                       const std::string& actions_log);
+  ~OfflineStateProvider();
+
+  /* the kernel still carries the data: keep it away from the astraea
+   * module, which only the patched kernel has */
+  std::string congestion_control(const std::string& cc) const override;
+  void enable(const int fd, const int val) override;
+  void set_cwnd(const int fd, const uint32_t cwnd) override;
+  /* there is no link to pace: rates are ignored */
+  void set_pacing_rate(const int, const uint64_t) override {}
+  double time_scale(void) const override { return time_scale_; }
+
+  const std::vector<Actuation>& actuations(void) const { return actuations_; }
+
+  /* forbid copying, which would write the actions log twice */
+  OfflineStateProvider(const OfflineStateProvider& other) = delete;
+  const OfflineStateProvider& operator=(const OfflineStateProvider& other) =
+      delete;
+
+ protected:
+  /* scaled time since the first call, in us */
+  uint64_t elapsed_us(void);
+  /* the last window set, 0 if none */
+  uint32_t cwnd(void) const { return cwnd_; }
+
+ private:
+  const double time_scale_;
+  const std::string actions_log_;
+  uint64_t start_us_{0};
+  uint32_t cwnd_{0};
+  std::vector<Actuation> actuations_{};
+};
+
+/* replays the states of a perf log in order, one per sample, then reports
+ * finished(). The window reported is the last one set, once there is one,
+ * which closes the loop on what the controller decided. */
+class ReplayStateProvider : public OfflineStateProvider {
+ public:
+  ReplayStateProvider(const std::string& path, const double time_scale = 1,
+                      const std::string& actions_log = "");
+
+  std::string name(void) const override { return "replay"; }
+  TCPDeepCCInfo sample(const int fd) override;
+  bool finished(void) const override { return next_ >= states_.size(); }
+
+ private:
+  std::vector<TCPDeepCCInfo> states_;
+  size_t next_{0};
+};
+
+/* a flow on a SyntheticLink for `duration_us` of scaled time */
+class SyntheticStateProvider : public OfflineStateProvider {
+ public:
+  SyntheticStateProvider(const SyntheticLink& link, const uint64_t duration_us,
+                         const double time_scale = 1,
+                         const std::string& actions_log = "",
+                         const uint32_t seed = 0);
+
+  std::string name(void) const override { return "synthetic"; }
+  TCPDeepCCInfo sample(const int fd) override;
+  bool finished(void) const override { return last_us_ >= duration_us_; }
+
+ private:
+  const SyntheticLink link_;
+  const uint64_t duration_us_;
+  std::mt19937 rng_;
+  uint64_t last_us_{0};
+};
+
+#endif /* OFFLINE_STATE_PROVIDER_HH */
@@ -0,0 +1,70 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "paced_state_provider.hh"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+PacedStateProvider::PacedStateProvider(unique_ptr<TCPStateProvider>&& provider,
+                                       const double window_gain,
+                                       const double max_rise)
+    : provider_(move(provider)),
+      window_gain_(window_gain),
+      max_rise_(max_rise) {
+  if (not provider_) {
+    throw runtime_error("PacedStateProvider: no provider to pace");
+  }
+  if (not(window_gain_ >= 1) or not(max_rise_ >= 1)) {
+    throw runtime_error("PacedStateProvider: gains must be at least 1");
+  }
+}
+
+unique_ptr<TCPStateProvider> PacedStateProvider::with_actuation(
+    const string& actuation, unique_ptr<TCPStateProvider>&& provider) {
+  if (actuation == "cwnd") {
+    return move(provider);
+  } else if (actuation != "pacing") {
+    throw runtime_error("unknown actuation: " + actuation);
+  }
+  if (provider->name() != "deepcc" and provider->name() != "tcp_info") {
+    throw runtime_error("pacing needs the deepcc or tcp_info TCP state");
+  }
+  return make_unique<PacedStateProvider>(move(provider));
+}
+
+TCPDeepCCInfo PacedStateProvider::sample(const int fd) {
+  TCPDeepCCInfo info = provider_->sample(fd);
+  if (info.min_rtt > 0) {
+    min_rtt_ = info.min_rtt;
+  }
+  if (info.mss > 0) {
+    mss_ = info.mss;
+  }
+  if (cwnd_ > 0) {
+    info.cwnd = cwnd_;
+  }
+  return info;
+}
+
+void PacedStateProvider::set_cwnd(const int fd, const uint32_t cwnd) {
+  cwnd_ = cwnd;
+  provider_->set_cwnd(
+      fd, min(uint64_t(cwnd * window_gain_), uint64_t(UINT32_MAX)));
+
+  /* no min_rtt yet: the window alone until a sample has one */
+  if (min_rtt_ == 0 or mss_ == 0) {
+    return;
+  }
+  uint64_t rate = uint64_t(cwnd) * mss_ * 1000000 / min_rtt_;
+  if (rate_ > 0) {
+    rate = min(rate, uint64_t(rate_ * max_rise_));
+  }
+  set_pacing_rate(fd, max(rate, uint64_t(1)));
+}
+
+void PacedStateProvider::set_pacing_rate(const int fd, const uint64_t rate) {
+  provider_->set_pacing_rate(fd, rate);
+  rate_ = rate;
+}
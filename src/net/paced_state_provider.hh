@@ -0,0 +1,69 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef PACED_STATE_PROVIDER_HH
+#define PACED_STATE_PROVIDER_HH
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "tcp_state_provider.hh"
+
+/* another provider, with each window the controller sets also applied as
+ * a pacing rate.
+ *
+ * A window of `cwnd` packets is paced at cwnd * mss per min_rtt: the rate
+ * that keeps `cwnd` in flight when nothing is queued. The kernel's window
+ * is set `window_gain` times larger, so the pacer rather than the window
+ * decides when packets leave, and the window only bounds what the flow can
+ * have in flight once the queue holds more than (window_gain - 1) min_rtt.
+ *
+ * So that a window which grows at once does not go out as a burst, the
+ * rate grows by at most `max_rise` times per window set; it drops at once.
+ * Samples report the window set, not the kernel's larger one, as the
+ * controller scales its actions by it. */
+class PacedStateProvider : public TCPStateProvider {
+ public:
+  static constexpr double DEFAULT_WINDOW_GAIN = 2;
+  static constexpr double DEFAULT_MAX_RISE = 2;
+
+  /* `provider` as it applies windows for an actuation of "cwnd" (itself)
+   * or "pacing" (paced), which needs a kernel to pace */
+  static std::unique_ptr<TCPStateProvider> with_actuation(
+      const std::string& actuation,
+      std::unique_ptr<TCPStateProvider>&& provider);
+
+  /* both gains must be at least 1 */
+  PacedStateProvider(std::unique_ptr<TCPStateProvider>&& provider,
+                     const double window_gain = DEFAULT_WINDOW_GAIN,
+                     const double max_rise = DEFAULT_MAX_RISE);
+
+  std::string name(void) const override { return provider_->name(); }
+  std::string congestion_control(const std::string& cc) const override {
+    return provider_->congestion_control(cc);
+  }
+  void enable(const int fd, const int val) override {
+    provider_->enable(fd, val);
+  }
+  TCPDeepCCInfo sample(const int fd) override;
+  void set_cwnd(const int fd, const uint32_t cwnd) override;
+  void set_pacing_rate(const int fd, const uint64_t rate) override;
+  double time_scale(void) const override { return provider_->time_scale(); }
+  bool finished(void) const override { return provider_->finished(); }
+
+  /* the rate last set in bytes per second, 0 if none */
+  uint64_t pacing_rate(void) const { return rate_; }
+
+ private:
+  std::unique_ptr<TCPStateProvider> provider_;
+  const double window_gain_;
+  const double max_rise_;
+  /* from the last sample that had them */
+  uint32_t min_rtt_{0};
+  uint32_t mss_{0};
+  /* the last window and rate set, 0 if none */
+  uint32_t cwnd_{0};
+  uint64_t rate_{0};
+};
+
+#endif /* PACED_STATE_PROVIDER_HH */
@@ -0,0 +1,293 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "perf_log.hh"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <stdexcept>
+
+#include "exception.hh"
+#include "timestamp.hh"
+
+using namespace std;
+
+static uint64_t realtime_usecs(void) {
+  timespec ts;
+  SystemCall("clock_gettime", clock_gettime(CLOCK_REALTIME, &ts));
+  return uint64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+template <typename T>
+static void append_bytes(string& buffer, const T* data, const size_t count) {
+  buffer.append(reinterpret_cast<const char*>(data), count * sizeof(T));
+}
+
+/* chunks start on 8-byte boundaries so that a mapped log can be read in
+ * place */
+static size_t chunks_offset(const PerfLog::FileHeader& header) {
+  const size_t end =
+      sizeof(header) + header.names_length + header.preamble_length;
+  return (end + 7) & ~size_t(7);
+}
+
+PerfLog::PerfLog(const string& path, const vector<string>& columns,
+                 const string& preamble)
+    : fd_(SystemCall("open " + path,
+                     open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                          0644))),
+      columns_(columns.size()),
+      stride_(columns.size() + 1),
+      ring_(CAPACITY * stride_) {
+  string names;
+  for (const auto& column : columns) {
+    names += (names.empty() ? "" : "\t") + column;
+  }
+  const string text = preamble.empty() ? names + "\n" : preamble;
+
+  FileHeader header{};
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.columns = columns_;
+  header.monotonic_origin_us = monotonic_usecs();
+  header.realtime_origin_us = realtime_usecs();
+  header.names_length = names.size();
+  header.preamble_length = text.size();
+
+  string buffer;
+  append_bytes(buffer, &header, 1);
+  buffer += names + text;
+  buffer.resize(chunks_offset(header), '\0');
+  fd_.write(buffer);
+
+  /* a signal must never land on the writer: a handler that closes the log
+     would then wait on the writer to finish, from the writer itself */
+  sigset_t all, previous;
+  sigfillset(&all);
+  pthread_sigmask(SIG_BLOCK, &all, &previous);
+  writer_ = thread(&PerfLog::writer_loop, this);
+  pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+}
+
+PerfLog::~PerfLog() { close(); }
+
+void PerfLog::append_record(const uint64_t* values, const size_t count) {
+  if (count != columns_) {
+    throw runtime_error("PerfLog: expected " + to_string(columns_) +
+                        " values, got " + to_string(count));
+  }
+  /* either close() sees this append in progress and waits for it, or the
+   * append sees the log closed and counts the record as dropped */
+  appending_.store(true, memory_order_seq_cst);
+  const uint64_t head = head_.load(memory_order_relaxed);
+  if (not running_.load(memory_order_seq_cst) or
+      head - tail_.load(memory_order_acquire) >= CAPACITY) {
+    dropped_.fetch_add(1, memory_order_relaxed);
+    appending_.store(false, memory_order_release);
+    return;
+  }
+
+  uint64_t* slot = &ring_[(head % CAPACITY) * stride_];
+  slot[0] = monotonic_usecs();
+  memcpy(slot + 1, values, count * sizeof(uint64_t));
+  head_.store(head + 1, memory_order_release);
+  appending_.store(false, memory_order_release);
+}
+
+void PerfLog::writer_loop(void) {
+  unique_lock<mutex> lock(wakeup_mutex_);
+  while (running_.load()) {
+    wakeup_.wait_for(lock, FLUSH_INTERVAL, [this] { return not running_; });
+    drain();
+  }
+}
+
+void PerfLog::drain(void) {
+  const uint64_t tail = tail_.load(memory_order_relaxed);
+  const uint64_t head = head_.load(memory_order_acquire);
+  if (head == tail) {
+    return;
+  }
+
+  ChunkHeader chunk{};
+  chunk.magic = CHUNK_MAGIC;
+  chunk.records = head - tail;
+  chunk.first_us = ring_[(tail % CAPACITY) * stride_];
+  chunk.last_us = ring_[((head - 1) % CAPACITY) * stride_];
+
+  /* the minima of all columns, then the maxima */
+  vector<uint64_t> extremes(2 * columns_);
+  fill(extremes.begin(), extremes.begin() + columns_, UINT64_MAX);
+  for (uint64_t i = tail; i < head; i++) {
+    const uint64_t* values = &ring_[(i % CAPACITY) * stride_] + 1;
+    for (size_t c = 0; c < columns_; c++) {
+      extremes[c] = min(extremes[c], values[c]);
+      extremes[columns_ + c] = max(extremes[columns_ + c], values[c]);
+    }
+  }
+
+  string buffer;
+  buffer.reserve(sizeof(chunk) +
+                 (extremes.size() + chunk.records * stride_) * sizeof(uint64_t));
+  append_bytes(buffer, &chunk, 1);
+  append_bytes(buffer, extremes.data(), extremes.size());
+  for (uint64_t i = tail; i < head; i++) {
+    append_bytes(buffer, &ring_[(i % CAPACITY) * stride_], stride_);
+  }
+  /* the slots are free again once copied */
+  tail_.store(head, memory_order_release);
+
+  fd_.write(buffer);
+}
+
+void PerfLog::close(void) {
+  {
+    lock_guard<mutex> lock(wakeup_mutex_);
+    if (not running_.exchange(false, memory_order_seq_cst)) {
+      return;
+    }
+  }
+  wakeup_.notify_one();
+  writer_.join();
+  /* an append that saw the log open finishes before the last drain */
+  while (appending_.load(memory_order_acquire)) {
+    this_thread::yield();
+  }
+  /* anything appended while the writer was finishing */
+  drain();
+
+  if (dropped_ > 0) {
+    cerr << "PerfLog: dropped " << dropped_ << " records" << endl;
+  }
+}
+
+PerfLogReader::PerfLogReader(const string& path) {
+  FileDescriptor fd(
+      SystemCall("open " + path, open(path.c_str(), O_RDONLY | O_CLOEXEC)));
+  struct stat st;
+  SystemCall("fstat " + path, fstat(fd.fd_num(), &st));
+  map_size_ = st.st_size;
+  if (map_size_ < sizeof(header_)) {
+    throw runtime_error(path + ": not a perf log");
+  }
+  map_ = mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE, fd.fd_num(), 0);
+  if (map_ == MAP_FAILED) {
+    map_ = nullptr;
+    throw unix_error("mmap " + path);
+  }
+  /* queries mostly sweep forward through the records */
+  madvise(map_, map_size_, MADV_SEQUENTIAL);
+
+  const char* const begin = static_cast<const char*>(map_);
+  const char* const end = begin + map_size_;
+  memcpy(&header_, begin, sizeof(header_));
+  if (memcmp(header_.magic, PerfLog::MAGIC, sizeof(PerfLog::MAGIC)) or
+      header_.version != PerfLog::VERSION) {
+    munmap(map_, map_size_);
+    throw runtime_error(path + ": not a version " +
+                        to_string(PerfLog::VERSION) + " perf log");
+  }
+  const char* cursor = begin + sizeof(header_);
+  if (chunks_offset(header_) > map_size_) {
+    munmap(map_, map_size_);
+    throw runtime_error(path + ": truncated header");
+  }
+
+  const string names(cursor, header_.names_length);
+  preamble_.assign(cursor + header_.names_length, header_.preamble_length);
+  size_t start = 0;
+  while (columns_.size() < header_.columns) {
+    const size_t name_end = names.find('\t', start);
+    columns_.push_back(names.substr(start, name_end - start));
+    start = name_end + 1;
+  }
+
+  /* walk the chunk headers; the records stay on disk until visited */
+  const size_t record_size = (header_.columns + 1) * sizeof(uint64_t);
+  const size_t summary_size = 2 * header_.columns * sizeof(uint64_t);
+  cursor = begin + chunks_offset(header_);
+  while (size_t(end - cursor) >= sizeof(PerfLog::ChunkHeader) + summary_size) {
+    PerfLog::ChunkHeader header;
+    memcpy(&header, cursor, sizeof(header));
+    if (header.magic != PerfLog::CHUNK_MAGIC) {
+      munmap(map_, map_size_);
+      throw runtime_error(path + ": corrupt chunk");
+    }
+    const uint64_t* summary =
+        reinterpret_cast<const uint64_t*>(cursor + sizeof(header));
+    const char* data = cursor + sizeof(header) + summary_size;
+
+    const size_t records =
+        min<size_t>(header.records, (end - data) / record_size);
+    if (records > 0) {
+      Chunk chunk{header.first_us, header.last_us, records, summary,
+                  summary + header_.columns,
+                  reinterpret_cast<const uint64_t*>(data)};
+      /* a log cut short by a crash ends with a partial chunk, whose summary
+       * covers records that are missing */
+      if (records < header.records) {
+        chunk.last_us = chunk.data[(records - 1) * (header_.columns + 1)];
+        chunk.min = chunk.max = nullptr;
+      }
+      chunks_.push_back(chunk);
+      records_ += records;
+    }
+    cursor = data + records * record_size;
+    if (records < header.records) {
+      break;
+    }
+  }
+}
+
+PerfLogReader::~PerfLogReader() {
+  if (map_) {
+    munmap(map_, map_size_);
+  }
+}
+
+size_t PerfLogReader::column(const string& name) const {
+  const auto it = find(columns_.begin(), columns_.end(), name);
+  if (it == columns_.end()) {
+    throw runtime_error("perf log has no column \"" + name + "\"");
+  }
+  return it - columns_.begin();
+}
+
+size_t PerfLogReader::first_chunk(const uint64_t from_us) const {
+  return partition_point(chunks_.begin(), chunks_.end(),
+                         [from_us](const Chunk& chunk) {
+                           return chunk.last_us < from_us;
+                         }) -
+         chunks_.begin();
+}
+
+pair<uint64_t, uint64_t> PerfLogReader::extremes(const size_t column,
+                                                 const uint64_t from_us,
+                                                 const uint64_t to_us) const {
+  pair<uint64_t, uint64_t> result{UINT64_MAX, 0};
+  const size_t stride = columns_.size() + 1;
+  for (size_t c = first_chunk(from_us);
+       c < chunks_.size() and chunks_[c].first_us <= to_us; c++) {
+    const Chunk& chunk = chunks_[c];
+    if (chunk.min and chunk.first_us >= from_us and chunk.last_us <= to_us) {
+      result.first = min(result.first, chunk.min[column]);
+      result.second = max(result.second, chunk.max[column]);
+      continue;
+    }
+    for (size_t i = 0; i < chunk.records; i++) {
+      const uint64_t* record = chunk.data + i * stride;
+      if (record[0] >= from_us and record[0] <= to_us) {
+        result.first = min(result.first, record[1 + column]);
+        result.second = max(result.second, record[1 + column]);
+      }
+    }
+  }
+  return result;
+}
@@ -0,0 +1,199 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef PERF_LOG_HH
+#define PERF_LOG_HH
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "file_descriptor.hh"
+
+/* asynchronous binary performance log.
+ *
+ * append() copies one record of integer columns, stamped with the monotonic
+ * clock, into a ring that a background thread drains to disk every
+ * FLUSH_INTERVAL in one large write. The appending thread makes no syscall
+ * and never blocks: if the writer falls behind, records are dropped and
+ * counted. append() may be called from one thread at a time.
+ *
+ * File layout (native byte order):
+ *   FileHeader, column names (tab separated), preamble, zero padding up to
+ *   a multiple of 8 bytes
+ *   chunks of ChunkHeader, the minimum of every column, the maximum of every
+ *   column, and `records` records, each record being the timestamp and then
+ *   one uint64_t per column
+ *
+ * The preamble is the text the TSV form of the log starts with; perf_log_tsv
+ * prints it followed by one line per record, which reproduces the logs the
+ * tools used to write line by line. */
+class PerfLog {
+ public:
+  static constexpr char MAGIC[8] = {'P', 'E', 'R', 'F', 'L', 'O', 'G', '\0'};
+  static constexpr uint32_t VERSION = 2;
+  static constexpr uint32_t CHUNK_MAGIC = 0x4b4e4843; /* "CHNK" */
+
+  struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t columns;
+    /* both clocks at open, to map record timestamps to wall-clock time */
+    uint64_t monotonic_origin_us;
+    uint64_t realtime_origin_us;
+    uint32_t names_length;
+    uint32_t preamble_length;
+  };
+
+  struct ChunkHeader {
+    uint32_t magic;
+    uint32_t records;
+    /* timestamps of the first and the last record */
+    uint64_t first_us;
+    uint64_t last_us;
+  };
+
+  /* an empty preamble stands for the tab-separated column names */
+  PerfLog(const std::string& path, const std::vector<std::string>& columns,
+          const std::string& preamble = "");
+  ~PerfLog();
+
+  /* one value per column, e.g. append(min_rtt, avg_urtt, ...) */
+  template <typename... Values>
+  void append(const Values&... values) {
+    const uint64_t record[] = {static_cast<uint64_t>(values)...};
+    append_record(record, sizeof...(values));
+  }
+  void append_record(const uint64_t* values, const size_t count);
+
+  /* write out everything appended so far and stop the writer; later
+   * appends are counted as dropped */
+  void close(void);
+
+  uint64_t dropped(void) const { return dropped_.load(); }
+
+ private:
+  static constexpr size_t CAPACITY = 4096; /* records, a power of two */
+  static constexpr auto FLUSH_INTERVAL = std::chrono::milliseconds(50);
+
+  FileDescriptor fd_;
+  const size_t columns_;
+  /* words per record: the timestamp and the columns */
+  const size_t stride_;
+  std::vector<uint64_t> ring_;
+  /* records appended (written by the appender) and written (by the writer) */
+  std::atomic<uint64_t> head_{0};
+  std::atomic<uint64_t> tail_{0};
+  std::atomic<uint64_t> dropped_{0};
+  std::atomic<bool> running_{true};
+  /* set by append() while it checks running_ and fills a slot */
+  std::atomic<bool> appending_{false};
+  /* lets close() wake the writer early; never touched by append() */
+  std::mutex wakeup_mutex_{};
+  std::condition_variable wakeup_{};
+  std::thread writer_{};
+
+  void writer_loop(void);
+  /* write out the records in the ring as one chunk */
+  void drain(void);
+};
+
+/* reader of a binary performance log, mapped into memory.
+ *
+ * Opening a log only walks the chunk headers to build a time index. A range
+ * query then touches just the chunks that overlap the range, and the
+ * extremes of a column over a range come from the chunk summaries, reading
+ * records only in the chunks at either end. */
+class PerfLogReader {
+ public:
+  struct Chunk {
+    uint64_t first_us;
+    uint64_t last_us;
+    size_t records;
+    /* one value per column; null if the chunk was cut short */
+    const uint64_t* min;
+    const uint64_t* max;
+    /* the records, each the timestamp and then the columns */
+    const uint64_t* data;
+  };
+
+  PerfLogReader(const std::string& path);
+  ~PerfLogReader();
+
+  const std::vector<std::string>& columns(void) const { return columns_; }
+  const std::string& preamble(void) const { return preamble_; }
+  const PerfLog::FileHeader& header(void) const { return header_; }
+  const std::vector<Chunk>& chunks(void) const { return chunks_; }
+  uint64_t records(void) const { return records_; }
+
+  /* index of the named column; throws if the log has no such column */
+  size_t column(const std::string& name) const;
+
+  /* call visitor(timestamp_us, values) for every record in order, values
+   * pointing at one uint64_t per column */
+  template <typename Visitor>
+  void for_each(Visitor&& visitor) const;
+
+  /* the same for records stamped within [from_us, to_us] */
+  template <typename Visitor>
+  void for_each(const uint64_t from_us, const uint64_t to_us,
+                Visitor&& visitor) const;
+
+  /* minimum and maximum of a column over [from_us, to_us]; {UINT64_MAX, 0}
+   * if no record lies within */
+  std::pair<uint64_t, uint64_t> extremes(const size_t column,
+                                         const uint64_t from_us,
+                                         const uint64_t to_us) const;
+
+  /* forbid copying, which would unmap the log twice */
+  PerfLogReader(const PerfLogReader& other) = delete;
+  const PerfLogReader& operator=(const PerfLogReader& other) = delete;
+
+ private:
+  PerfLog::FileHeader header_{};
+  std::vector<std::string> columns_{};
+  std::string preamble_{};
+  void* map_{nullptr};
+  size_t map_size_{0};
+  /* in file order, hence in timestamp order */
+  std::vector<Chunk> chunks_{};
+  uint64_t records_{0};
+
+  /* index of the first chunk that may hold records stamped at or after
+   * from_us */
+  size_t first_chunk(const uint64_t from_us) const;
+};
+
+template <typename Visitor>
+void PerfLogReader::for_each(Visitor&& visitor) const {
+  const size_t stride = columns_.size() + 1;
+  for (const auto& chunk : chunks_) {
+    for (size_t i = 0; i < chunk.records; i++) {
+      const uint64_t* record = chunk.data + i * stride;
+      visitor(record[0], record + 1);
+    }
+  }
+}
+
+template <typename Visitor>
+void PerfLogReader::for_each(const uint64_t from_us, const uint64_t to_us,
+                             Visitor&& visitor) const {
+  const size_t stride = columns_.size() + 1;
+  for (size_t c = first_chunk(from_us);
+       c < chunks_.size() and chunks_[c].first_us <= to_us; c++) {
+    const Chunk& chunk = chunks_[c];
+    for (size_t i = 0; i < chunk.records; i++) {
+      const uint64_t* record = chunk.data + i * stride;
+      if (record[0] >= from_us and record[0] <= to_us) {
+        visitor(record[0], record + 1);
+      }
+    }
+  }
+}
+
+#endif /* PERF_LOG_HH */
@@ -6,6 +6,7 @@
 #include <numeric>
 
 #include "exception.hh"
+#include "timestamp.hh"
 
 using namespace std;
 using namespace PollerShortNames;
@@ -131,6 +132,77 @@ Poller::Result Poller::poll(const int timeout_ms) {
   return Result::Type::Success;
 }
 
+TimerWheel& Poller::timer_wheel(void) {
+  if (timer_wheel_) {
+    return *timer_wheel_;
+  }
+
+  timer_fd_ = make_unique<TimerFD>();
+  timer_wheel_ = make_unique<TimerWheel>(monotonic_usecs());
+
+  add_action(Action(
+      *timer_fd_, Direction::In,
+      [this]() {
+        timer_fd_->read_expirations();
+        timer_armed_us_ = UINT64_MAX;
+        timer_wheel_->advance(monotonic_usecs());
+        rearm_timer();
+        return ResultType::Continue;
+      },
+      [this]() { return not timer_wheel_->empty(); }));
+
+  return *timer_wheel_;
+}
+
+void Poller::rearm_timer(void) {
+  const uint64_t next_expiry = timer_wheel_->next_expiry_us();
+
+  if (next_expiry == timer_armed_us_) {
+    return;
+  }
+
+  if (next_expiry == UINT64_MAX) {
+    timer_fd_->disarm();
+  } else {
+    timer_fd_->arm(next_expiry);
+  }
+  timer_armed_us_ = next_expiry;
+}
+
+Poller::TimerId Poller::add_timer(const uint64_t delay_us,
+                                  TimerWheel::CallbackType&& callback) {
+  auto& wheel = timer_wheel();
+  const TimerId id = wheel.add(monotonic_usecs(), delay_us, move(callback));
+  rearm_timer();
+  return id;
+}
+
+Poller::TimerId Poller::add_periodic_timer(const uint64_t period_us,
+                                           TimerWheel::CallbackType&& callback,
+                                           const uint64_t delay_us) {
+  if (period_us == 0) {
+    throw runtime_error("Poller: timer period must be positive");
+  }
+
+  auto& wheel = timer_wheel();
+  const TimerId id =
+      wheel.add(monotonic_usecs(),
+                delay_us == UINT64_MAX ? period_us : delay_us, move(callback),
+                period_us);
+  rearm_timer();
+  return id;
+}
+
+bool Poller::cancel_timer(const TimerId id) {
+  /* the timerfd may stay armed for the cancelled deadline; the resulting
+   * wakeup finds nothing to fire and re-arms for the next one */
+  return timer_wheel_ and timer_wheel_->cancel(id);
+}
+
+TimerWheel::Stats Poller::timer_stats(void) const {
+  return timer_wheel_ ? timer_wheel_->stats() : TimerWheel::Stats();
+}
+
 void Poller::remove_actions(const set<int>& fd_nums) {
   if (fd_nums.size() == 0) {
     return;
@@ -8,11 +8,14 @@
 #include <cassert>
 #include <functional>
 #include <list>
+#include <memory>
 #include <queue>
 #include <set>
 #include <vector>
 
 #include "file_descriptor.hh"
+#include "timer_wheel.hh"
+#include "timerfd.hh"
 
 class Poller {
  public:
@@ -63,9 +66,19 @@ class Poller {
   std::vector<pollfd> pollfds_{};
   std::set<int> fds_to_remove_{};
 
+  /* timers share a single timerfd, created on first use */
+  std::unique_ptr<TimerFD> timer_fd_{};
+  std::unique_ptr<TimerWheel> timer_wheel_{};
+  uint64_t timer_armed_us_{UINT64_MAX};
+
   /* remove all actions for file descriptors in `fd_nums` */
   void remove_actions(const std::set<int>& fd_nums);
 
+  /* create the timerfd and register it with the poller */
+  TimerWheel& timer_wheel(void);
+  /* point the timerfd at the next expiry of the wheel */
+  void rearm_timer(void);
+
  public:
   struct Result {
     enum class Type { Success, Timeout, Exit } result;
@@ -79,6 +92,24 @@ class Poller {
   void add_action(Action action);
   void remove_fd(const int fd_num);
   Result poll(const int timeout_ms);
+
+  typedef TimerWheel::TimerId TimerId;
+
+  /* run `callback` once after `delay_us` microseconds */
+  TimerId add_timer(const uint64_t delay_us,
+                    TimerWheel::CallbackType&& callback);
+
+  /* run `callback` every `period_us` microseconds, first after `delay_us`
+   * (one period if not given) */
+  TimerId add_periodic_timer(const uint64_t period_us,
+                             TimerWheel::CallbackType&& callback,
+                             const uint64_t delay_us = UINT64_MAX);
+
+  /* returns false if the timer has already fired or been cancelled */
+  bool cancel_timer(const TimerId id);
+
+  /* firing statistics, e.g. to measure timer jitter */
+  TimerWheel::Stats timer_stats(void) const;
 };
 
 namespace PollerShortNames {
@@ -0,0 +1,45 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "send_buffer_sizer.hh"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+/* whether `size` is more than an eighth away from `current` */
+static bool moved(const uint64_t current, const uint64_t size) {
+  const uint64_t distance = max(current, size) - min(current, size);
+  return current == 0 or distance > current / 8;
+}
+
+SendBufferSizer::SendBufferSizer(TCPSocket& sock, const double headroom)
+    : sock_(sock), headroom_(headroom) {
+  if (not(headroom_ > 1)) {
+    throw runtime_error("SendBufferSizer: headroom must be larger than 1");
+  }
+}
+
+void SendBufferSizer::update(const ControlSample& sample, const u32 cwnd) {
+  const uint64_t bdp = sample.max_tput * sample.info.min_rtt / 1000000;
+  if (bdp == 0) {
+    return;
+  }
+  const uint64_t in_flight = max(bdp, uint64_t(cwnd) * sample.info.mss);
+
+  const uint64_t send_buffer =
+      clamp(uint64_t(headroom_ * in_flight), MIN_SEND_BUFFER, MAX_SIZE);
+  const uint64_t notsent_lowat =
+      clamp(uint64_t((headroom_ - 1) * bdp), MIN_NOTSENT_LOWAT, MAX_SIZE);
+
+  if (moved(send_buffer_, send_buffer)) {
+    sock_.set_send_buffer(send_buffer);
+    send_buffer_ = send_buffer;
+    resizes_++;
+  }
+  if (moved(notsent_lowat_, notsent_lowat)) {
+    sock_.set_notsent_lowat(notsent_lowat);
+    notsent_lowat_ = notsent_lowat;
+    resizes_++;
+  }
+}
@@ -0,0 +1,54 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef SEND_BUFFER_SIZER_HH
+#define SEND_BUFFER_SIZER_HH
+
+#include <cstdint>
+
+#include "control_sample.hh"
+#include "socket.hh"
+
+/* sizes a bulk sender's SO_SNDBUF and TCP_NOTSENT_LOWAT to the path's
+ * bandwidth-delay product, as the control loop estimates it.
+ *
+ * With the kernel's defaults, a sender that writes as fast as it can
+ * either queues megabytes of unsent data in the socket, which a new byte
+ * waits behind, or, with a small fixed buffer, cannot fill a long fat
+ * path. Here the buffer holds `headroom` times what the flow may have in
+ * flight (the BDP, or the window if larger), and writes block once more
+ * than (headroom - 1) BDPs are queued unsent.
+ *
+ * The BDP is max_tput * min_rtt. Until both are known the kernel's sizes
+ * stay, and a size is only set again once it has moved by more than an
+ * eighth, so most control steps make no syscall. */
+class SendBufferSizer {
+ public:
+  static constexpr double DEFAULT_HEADROOM = 2;
+
+  /* `headroom` must be larger than 1 */
+  SendBufferSizer(TCPSocket& sock, const double headroom = DEFAULT_HEADROOM);
+
+  /* resize for the state of a control step that set `cwnd` packets */
+  void update(const ControlSample& sample, const u32 cwnd);
+
+  /* the sizes last set, 0 if none yet */
+  uint64_t send_buffer(void) const { return send_buffer_; }
+  uint64_t notsent_lowat(void) const { return notsent_lowat_; }
+  /* sizes set so far */
+  uint64_t resizes(void) const { return resizes_; }
+
+ private:
+  /* below these, the kernel's own minimums and wakeup costs dominate */
+  static constexpr uint64_t MIN_SEND_BUFFER = 64 * 1024;
+  static constexpr uint64_t MIN_NOTSENT_LOWAT = 16 * 1024;
+  /* the most SO_SNDBUF takes, before the kernel's own cap (wmem_max) */
+  static constexpr uint64_t MAX_SIZE = INT32_MAX / 2;
+
+  TCPSocket& sock_;
+  const double headroom_;
+  uint64_t send_buffer_{0};
+  uint64_t notsent_lowat_{0};
+  uint64_t resizes_{0};
+};
+
+#endif /* SEND_BUFFER_SIZER_HH */
@@ -0,0 +1,68 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef SEQLOCK_HH
+#define SEQLOCK_HH
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/* a value that one writer at a time publishes and any number of readers
+ * copy, with no lock on either side.
+ *
+ * The writer makes the sequence number odd, writes, and makes it even
+ * again; a reader copies and starts over if the number was odd or changed
+ * meanwhile. Readers never delay the writer, and a reader only retries if
+ * it raced with a store. The value is kept as relaxed atomic words, so a
+ * torn copy, which is thrown away, is never a data race either. */
+template <typename T>
+class Seqlock {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "Seqlock holds plain data only");
+
+ public:
+  /* writers must be serialized by the caller */
+  void store(const T& value) {
+    uint64_t words[WORDS] = {};
+    memcpy(words, &value, sizeof(T));
+    const uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < WORDS; i++) {
+      words_[i].store(words[i], std::memory_order_relaxed);
+    }
+    sequence_.store(sequence + 2, std::memory_order_release);
+  }
+
+  T load(void) const {
+    uint64_t words[WORDS];
+    uint64_t before, after;
+    do {
+      before = sequence_.load(std::memory_order_acquire);
+      for (size_t i = 0; i < WORDS; i++) {
+        words[i] = words_[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      after = sequence_.load(std::memory_order_relaxed);
+    } while (before != after or before % 2 == 1);
+
+    T value;
+    memcpy(&value, words, sizeof(T));
+    return value;
+  }
+
+  /* number of stores so far */
+  uint64_t version(void) const {
+    return sequence_.load(std::memory_order_acquire) / 2;
+  }
+
+ private:
+  static constexpr size_t WORDS = (sizeof(T) + 7) / 8;
+
+  alignas(64) std::atomic<uint64_t> sequence_{0};
+  std::array<std::atomic<uint64_t>, WORDS> words_{};
+};
+
+#endif /* SEQLOCK_HH */
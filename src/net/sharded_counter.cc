@@ -0,0 +1,19 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "sharded_counter.hh"
+
+using namespace std;
+
+ShardedCounter::Shard& ShardedCounter::shard(void) {
+  lock_guard<mutex> lock(mutex_);
+  return shards_.emplace_back();
+}
+
+uint64_t ShardedCounter::total(void) const {
+  lock_guard<mutex> lock(mutex_);
+  uint64_t sum = 0;
+  for (const auto& shard : shards_) {
+    sum += shard.value();
+  }
+  return sum;
+}
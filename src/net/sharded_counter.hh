@@ -0,0 +1,44 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef SHARDED_COUNTER_HH
+#define SHARDED_COUNTER_HH
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+/* a counter that several threads add to and another thread reads.
+ *
+ * Every adding thread takes a shard of its own, a cache line that only it
+ * writes, so adding is a plain load and store with no locked instruction
+ * and no cache line bouncing between writers. total() sums the shards. */
+class ShardedCounter {
+ public:
+  class Shard {
+   public:
+    /* only the thread that owns the shard may call add() */
+    void add(const uint64_t n) {
+      value_.store(value_.load(std::memory_order_relaxed) + n,
+                   std::memory_order_relaxed);
+    }
+    uint64_t value(void) const {
+      return value_.load(std::memory_order_relaxed);
+    }
+
+   private:
+    alignas(64) std::atomic<uint64_t> value_{0};
+  };
+
+  /* a new shard for the calling thread, valid as long as the counter */
+  Shard& shard(void);
+
+  uint64_t total(void) const;
+
+ private:
+  mutable std::mutex mutex_{};
+  /* a deque never moves its elements */
+  std::deque<Shard> shards_{};
+};
+
+#endif /* SHARDED_COUNTER_HH */
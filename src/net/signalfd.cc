@@ -4,6 +4,8 @@
 
 #include <csignal>
 #include <cstring>
+#include <memory>
+#include <thread>
 
 #include "exception.hh"
 
@@ -62,3 +64,18 @@ signalfd_siginfo SignalFD::read_signal(void) {
 
   return delivered_signal;
 }
+
+void handle_signals_on_thread(const SignalMask& signals,
+                              function<void(int)> handler) {
+  const int error = pthread_sigmask(SIG_BLOCK, &signals.mask(), nullptr);
+  if (error) {
+    throw unix_error("pthread_sigmask", error);
+  }
+
+  auto signal_fd = make_shared<SignalFD>(signals);
+  thread([signal_fd, handler = move(handler)]() {
+    while (true) {
+      handler(signal_fd->read_signal().ssi_signo);
+    }
+  }).detach();
+}
@@ -4,6 +4,7 @@
 #define SIGNALFD_HH
 
 #include <sys/signalfd.h>
+#include <functional>
 #include <initializer_list>
 
 #include "file_descriptor.hh"
@@ -36,4 +37,10 @@ public:
   signalfd_siginfo read_signal( void ); /* read one signal */
 };
 
+/* block the signals in the calling thread, and so in every thread it starts
+   from then on, and call the handler with each one on a thread of its own;
+   unlike a signal handler, it may take locks, log, join threads and exit */
+void handle_signals_on_thread( const SignalMask & signals,
+                               std::function<void( int )> handler );
+
 #endif /* SIGNALFD_HH */
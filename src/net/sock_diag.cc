@@ -0,0 +1,236 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "sock_diag.hh"
+
+#include <linux/inet_diag.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/sock_diag.h>
+#include <netinet/in.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include "exception.hh"
+
+using namespace std;
+
+size_t TCPStateTable::find(const uint64_t c) const {
+  if (not index_ready_) {
+    index_.clear();
+    for (size_t row = 0; row < size(); row++) {
+      index_.emplace_back(cookie[row], row);
+    }
+    sort(index_.begin(), index_.end());
+    index_ready_ = true;
+  }
+  const auto it = lower_bound(index_.begin(), index_.end(), make_pair(c, size_t(0)));
+  return it != index_.end() and it->first == c ? it->second : NOT_FOUND;
+}
+
+void TCPStateTable::clear(void) {
+  for (auto* column : {&cookie, &bytes_acked, &bytes_retrans, &pacing_rate,
+                       &delivery_rate}) {
+    column->clear();
+  }
+  for (auto* column : {&rtt_us, &min_rtt_us, &snd_cwnd, &snd_mss,
+                       &snd_ssthresh, &unacked, &retrans, &delivered}) {
+    column->clear();
+  }
+  sport.clear();
+  dport.clear();
+  index_ready_ = false;
+}
+
+void TCPStateTable::append(const uint64_t c, const uint16_t src_port,
+                           const uint16_t dst_port, const tcp_info& info) {
+  index_ready_ = false;
+  cookie.push_back(c);
+  sport.push_back(src_port);
+  dport.push_back(dst_port);
+  rtt_us.push_back(info.tcpi_rtt);
+  min_rtt_us.push_back(info.tcpi_min_rtt);
+  snd_cwnd.push_back(info.tcpi_snd_cwnd);
+  snd_mss.push_back(info.tcpi_snd_mss);
+  snd_ssthresh.push_back(info.tcpi_snd_ssthresh);
+  unacked.push_back(info.tcpi_unacked);
+  retrans.push_back(info.tcpi_retrans);
+  delivered.push_back(info.tcpi_delivered);
+  bytes_acked.push_back(info.tcpi_bytes_acked);
+  bytes_retrans.push_back(info.tcpi_bytes_retrans);
+  pacing_rate.push_back(info.tcpi_pacing_rate);
+  delivery_rate.push_back(info.tcpi_delivery_rate);
+}
+
+/* the kernel's TCP_ESTABLISHED, which no uapi header exports */
+static constexpr uint32_t TCP_STATE_ESTABLISHED = 1;
+
+/* the kernel fills at most 32 KiB per recv() of a dump, about 80 sockets */
+static constexpr size_t RECV_BUFFER_SIZE = 32 * 1024;
+
+/* inet_diag bytecode for `filter`, empty if it matches every socket.
+ *
+ * The kernel runs the ops in order, jumping `yes` or `no` bytes ahead; a
+ * socket matches if a jump lands exactly on the end, and is rejected by a
+ * jump past it. Every condition here continues with the next one when it
+ * holds and rejects the socket otherwise. */
+static string filter_bytecode(const SockDiagCollector::Filter& filter) {
+  /* each condition: an op followed by its operand */
+  vector<pair<uint8_t, string>> conditions;
+  for (const auto& [code, port] :
+       {make_pair(INET_DIAG_BC_S_EQ, filter.sport),
+        make_pair(INET_DIAG_BC_D_EQ, filter.dport)}) {
+    if (port != 0) {
+      /* a port comparison keeps the port in the `no` of a second op */
+      const inet_diag_bc_op operand{INET_DIAG_BC_NOP, 0, port};
+      conditions.emplace_back(
+          code, string(reinterpret_cast<const char*>(&operand),
+                       sizeof(operand)));
+    }
+  }
+  if (filter.cgroup != 0) {
+    conditions.emplace_back(
+        INET_DIAG_BC_CGROUP_COND,
+        string(reinterpret_cast<const char*>(&filter.cgroup),
+               sizeof(filter.cgroup)));
+  }
+
+  size_t left = 0;
+  for (const auto& condition : conditions) {
+    left += sizeof(inet_diag_bc_op) + condition.second.size();
+  }
+
+  string bytecode;
+  for (const auto& [code, operand] : conditions) {
+    const uint8_t len = sizeof(inet_diag_bc_op) + operand.size();
+    const inet_diag_bc_op op{code, len, uint16_t(left + 4)};
+    bytecode.append(reinterpret_cast<const char*>(&op), sizeof(op));
+    bytecode.append(operand);
+    left -= len;
+  }
+  return bytecode;
+}
+
+static string dump_request(const uint8_t family, const string& bytecode) {
+  struct {
+    nlmsghdr nlh;
+    inet_diag_req_v2 req;
+  } msg{};
+
+  msg.nlh.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+  msg.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+  msg.req.sdiag_family = family;
+  msg.req.sdiag_protocol = IPPROTO_TCP;
+  msg.req.idiag_states = 1 << TCP_STATE_ESTABLISHED;
+  msg.req.idiag_ext = 1 << (INET_DIAG_INFO - 1);
+
+  string request(reinterpret_cast<const char*>(&msg), sizeof(msg));
+  if (not bytecode.empty()) {
+    rtattr rta{};
+    rta.rta_type = INET_DIAG_REQ_BYTECODE;
+    rta.rta_len = RTA_LENGTH(bytecode.size());
+    request.append(reinterpret_cast<const char*>(&rta), sizeof(rta));
+    request.append(bytecode);
+  }
+  reinterpret_cast<nlmsghdr*>(request.data())->nlmsg_len = request.size();
+  return request;
+}
+
+SockDiagCollector::SockDiagCollector() : SockDiagCollector(Filter()) {}
+
+SockDiagCollector::SockDiagCollector(const Filter& filter)
+    : nl_(SystemCall("socket NETLINK_SOCK_DIAG",
+                     socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC,
+                            NETLINK_SOCK_DIAG))),
+      buffer_(RECV_BUFFER_SIZE) {
+  const string bytecode = filter_bytecode(filter);
+  for (const uint8_t family : {AF_INET, AF_INET6}) {
+    if (filter.family == AF_UNSPEC or filter.family == family) {
+      requests_.push_back(dump_request(family, bytecode));
+    }
+  }
+  if (requests_.empty()) {
+    throw runtime_error("SockDiagCollector: unsupported address family " +
+                        to_string(filter.family));
+  }
+}
+
+const TCPStateTable& SockDiagCollector::collect(void) {
+  table_.clear();
+  for (auto& request : requests_) {
+    dump(request);
+  }
+  return table_;
+}
+
+void SockDiagCollector::dump(string& request) {
+  auto* const hdr = reinterpret_cast<nlmsghdr*>(request.data());
+  hdr->nlmsg_seq = ++seq_;
+
+  sockaddr_nl kernel{};
+  kernel.nl_family = AF_NETLINK;
+  SystemCall("sendto sock_diag",
+             sendto(nl_.fd_num(), request.data(), request.size(), 0,
+                    reinterpret_cast<const sockaddr*>(&kernel),
+                    sizeof(kernel)));
+
+  while (true) {
+    int len = SystemCall(
+        "recv sock_diag", recv(nl_.fd_num(), buffer_.data(), buffer_.size(), 0));
+
+    for (auto* nlh = reinterpret_cast<const nlmsghdr*>(buffer_.data());
+         NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+      if (nlh->nlmsg_seq != seq_) {
+        continue;
+      }
+      if (nlh->nlmsg_type == NLMSG_DONE) {
+        return;
+      }
+      if (nlh->nlmsg_type == NLMSG_ERROR) {
+        const auto* err = reinterpret_cast<const nlmsgerr*>(NLMSG_DATA(nlh));
+        throw unix_error("sock_diag dump", -err->error);
+      }
+      if (nlh->nlmsg_type != SOCK_DIAG_BY_FAMILY) {
+        continue;
+      }
+
+      const auto* diag = reinterpret_cast<const inet_diag_msg*>(NLMSG_DATA(nlh));
+      /* older kernels send a shorter tcp_info: the rest stays zero */
+      tcp_info info{};
+      int attr_len = nlh->nlmsg_len - NLMSG_LENGTH(sizeof(*diag));
+      for (auto* attr = reinterpret_cast<const rtattr*>(diag + 1);
+           RTA_OK(attr, attr_len); attr = RTA_NEXT(attr, attr_len)) {
+        if (attr->rta_type == INET_DIAG_INFO) {
+          memcpy(&info, RTA_DATA(attr),
+                 min(size_t(RTA_PAYLOAD(attr)), sizeof(info)));
+        }
+      }
+
+      const uint64_t cookie = uint64_t(diag->id.idiag_cookie[0]) |
+                              uint64_t(diag->id.idiag_cookie[1]) << 32;
+      table_.append(cookie, ntohs(diag->id.idiag_sport),
+                    ntohs(diag->id.idiag_dport), info);
+    }
+  }
+}
+
+uint64_t SockDiagCollector::socket_cookie(const FileDescriptor& sock) {
+  uint64_t cookie = 0;
+  socklen_t len = sizeof(cookie);
+  SystemCall("getsockopt SO_COOKIE",
+             getsockopt(sock.fd_num(), SOL_SOCKET, SO_COOKIE, &cookie, &len));
+  return cookie;
+}
+
+uint64_t SockDiagCollector::cgroup_id(const string& path) {
+  /* a cgroup v2 id is the inode number of its directory */
+  struct stat st;
+  SystemCall("stat " + path, stat(path.c_str(), &st));
+  if (not S_ISDIR(st.st_mode)) {
+    throw runtime_error(path + " is not a cgroup directory");
+  }
+  return st.st_ino;
+}
@@ -0,0 +1,90 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef SOCK_DIAG_HH
+#define SOCK_DIAG_HH
+
+#include <linux/tcp.h>
+#include <sys/socket.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "file_descriptor.hh"
+
+/* TCP state of many sockets, one column per field: a monitor or a multi-flow
+ * controller sweeps the columns it needs without touching the rest */
+struct TCPStateTable {
+  static constexpr size_t NOT_FOUND = SIZE_MAX;
+
+  /* socket cookie (SO_COOKIE), unique while the socket exists */
+  std::vector<uint64_t> cookie{};
+  std::vector<uint16_t> sport{}, dport{};
+  std::vector<uint32_t> rtt_us{}, min_rtt_us{};
+  std::vector<uint32_t> snd_cwnd{}, snd_mss{}, snd_ssthresh{};
+  std::vector<uint32_t> unacked{}, retrans{}, delivered{};
+  std::vector<uint64_t> bytes_acked{}, bytes_retrans{};
+  std::vector<uint64_t> pacing_rate{}, delivery_rate{};
+
+  size_t size(void) const { return cookie.size(); }
+
+  /* row of the socket with cookie `c`, or NOT_FOUND; the first call after a
+   * change sorts an index, so sweeps that never look a socket up skip it */
+  size_t find(const uint64_t c) const;
+
+  void clear(void);
+  void append(const uint64_t c, const uint16_t src_port,
+              const uint16_t dst_port, const tcp_info& info);
+
+ private:
+  /* (cookie, row) sorted by cookie, valid if index_ready_ */
+  mutable std::vector<std::pair<uint64_t, size_t>> index_{};
+  mutable bool index_ready_{false};
+};
+
+/* collects the tcp_info of every matching TCP socket on the host with one
+ * netlink sock_diag dump per address family, instead of one getsockopt per
+ * socket */
+class SockDiagCollector {
+ public:
+  /* sockets must match every field that is set */
+  struct Filter {
+    /* AF_INET or AF_INET6, AF_UNSPEC for both. Every dump walks the whole
+     * established hash, so naming the family halves the cost. IPv4 peers of
+     * dual-stack sockets are AF_INET6. */
+    uint8_t family = AF_UNSPEC;
+    /* local and remote port, 0 for any */
+    uint16_t sport = 0;
+    uint16_t dport = 0;
+    /* cgroup v2 id (see cgroup_id()), 0 for any */
+    uint64_t cgroup = 0;
+  };
+
+  SockDiagCollector();
+  explicit SockDiagCollector(const Filter& filter);
+
+  /* dump the established sockets; the table stays valid until the next call */
+  const TCPStateTable& collect(void);
+
+  const TCPStateTable& table(void) const { return table_; }
+
+  /* the cookie sock_diag reports for `sock` */
+  static uint64_t socket_cookie(const FileDescriptor& sock);
+
+  /* id of the cgroup v2 directory at `path` */
+  static uint64_t cgroup_id(const std::string& path);
+
+ private:
+  FileDescriptor nl_;
+  /* one SOCK_DIAG_BY_FAMILY request per address family */
+  std::vector<std::string> requests_{};
+  std::vector<char> buffer_;
+  uint32_t seq_{0};
+  TCPStateTable table_{};
+
+  void dump(std::string& request);
+};
+
+#endif /* SOCK_DIAG_HH */
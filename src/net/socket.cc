@@ -6,6 +6,7 @@
 #include <linux/tcp.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 #include "exception.hh"
 #include "timestamp.hh"
@@ -88,6 +89,34 @@ void UDPSocket::sendto(const Address& destination, const string& payload) {
   }
 }
 
+/* gather the buffers into one datagram */
+void UDPSocket::sendto(const Address& destination,
+                       initializer_list<string_view> buffers) {
+  if (buffers.size() > MAX_IOV) {
+    throw runtime_error("sendto: too many buffers");
+  }
+
+  iovec iov[MAX_IOV];
+  size_t count = 0, length = 0;
+  for (const auto& buffer : buffers) {
+    iov[count++] = {const_cast<char*>(buffer.data()), buffer.size()};
+    length += buffer.size();
+  }
+
+  msghdr msg{};
+  msg.msg_name = const_cast<sockaddr*>(&destination.to_sockaddr());
+  msg.msg_namelen = destination.size();
+  msg.msg_iov = iov;
+  msg.msg_iovlen = count;
+  const ssize_t bytes_sent = SystemCall("sendmsg", ::sendmsg(fd_num(), &msg, 0));
+
+  register_write();
+
+  if (size_t(bytes_sent) != length) {
+    throw runtime_error("datagram payload too big for sendmsg()");
+  }
+}
+
 /* send datagram to connected address */
 void UDPSocket::send(const string& payload) {
   const ssize_t bytes_sent =
@@ -163,6 +192,20 @@ pair<Address, string> UDPSocket::recvfrom(void) {
                    string(buffer, recv_len));
 }
 
+size_t UDPSocket::recv_into(char* buffer, const size_t capacity) {
+  /* with MSG_TRUNC, the real length even if it did not fit */
+  const ssize_t recv_len =
+      SystemCall("recv", ::recv(fd_num(), buffer, capacity, MSG_TRUNC));
+
+  if (size_t(recv_len) > capacity) {
+    throw runtime_error("recv (oversized datagram)");
+  }
+
+  register_read();
+
+  return recv_len;
+}
+
 Address TCPSocket::original_dest(void) const {
   Address::raw dstaddr;
   socklen_t len = getsockopt(SOL_IP, SO_ORIGINAL_DST, dstaddr);
@@ -191,4 +234,16 @@ string TCPSocket::get_congestion_control() const {
 
 void TCPSocket::set_nodelay(void) {
   setsockopt(IPPROTO_TCP, TCP_NODELAY, int(true));
+}
+
+void TCPSocket::set_zerocopy(void) {
+  setsockopt(SOL_SOCKET, SO_ZEROCOPY, int(true));
+}
+
+void TCPSocket::set_send_buffer(const int bytes) {
+  setsockopt(SOL_SOCKET, SO_SNDBUF, bytes);
+}
+
+void TCPSocket::set_notsent_lowat(const int bytes) {
+  setsockopt(IPPROTO_TCP, TCP_NOTSENT_LOWAT, bytes);
 }
\ No newline at end of file
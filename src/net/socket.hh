@@ -59,9 +59,16 @@ class UDPSocket : public Socket {
   /* receive datagram and where it came from */
   std::pair<Address, std::string> recvfrom(void);
 
+  /* receive datagram into buffer; returns its length */
+  size_t recv_into(char* buffer, const size_t capacity);
+
   /* send datagram to specified address */
   void sendto(const Address& peer, const std::string& payload);
 
+  /* send the buffers back to back as one datagram to specified address */
+  void sendto(const Address& peer,
+              std::initializer_list<std::string_view> buffers);
+
   /* send datagram to connected address */
   void send(const std::string& payload);
 
@@ -96,6 +103,17 @@ class TCPSocket : public Socket {
 
   /* disable Nagle algorithm */
   void set_nodelay(void);
+
+  /* allow send(..., MSG_ZEROCOPY) */
+  void set_zerocopy(void);
+
+  /* fix the send buffer at `bytes` (the kernel doubles it for overhead),
+   * which turns off its autotuning */
+  void set_send_buffer(const int bytes);
+
+  /* report the socket writable, and let blocking writes return, only while
+   * fewer than `bytes` are queued unsent */
+  void set_notsent_lowat(const int bytes);
 };
 
 #endif /* SOCKET_HH */
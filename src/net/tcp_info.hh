@@ -1,9 +1,10 @@
 #ifndef TCP_INFO_HH
 #define TCP_INFO_HH
 
-#include <linux/tcp.h>
 #include <sys/types.h>
 
+#include <algorithm>
+#include <cstdint>
 #include <sstream>
 #include <string>
 
@@ -60,25 +61,8 @@ struct TCPDeepCCInfo {
     max_packets_out = 0;
     mss = 0;
   }
-  TCPDeepCCInfo& operator=(const TCPDeepCCInfo& a) {
-    this->min_rtt = a.min_rtt;
-    this->avg_urtt = a.avg_urtt;
-    this->cnt = a.cnt;
-    this->avg_thr = a.avg_thr;
-    this->thr_cnt = a.thr_cnt;
-    this->cwnd = a.cwnd;
-    this->pacing_rate = a.pacing_rate;
-    this->lost_bytes = a.lost_bytes;
-    this->srtt_us = a.srtt_us;
-    this->snd_ssthresh = a.snd_ssthresh;
-    this->packets_out = a.packets_out;
-    this->retrans_out = a.retrans_out;
-    this->max_packets_out = a.max_packets_out;
-    this->mss = a.mss;
-    return *this;
-  }
 
-  json to_json() {
+  json to_json() const {
     json out;
     out["min_rtt"] = min_rtt;
     out["avg_urtt"] = avg_urtt;
@@ -97,7 +81,7 @@ struct TCPDeepCCInfo {
     return out;
   }
 
-  std::string to_string() {
+  std::string to_string() const {
     json out = this->to_json();
     return out.dump();
   }
@@ -114,12 +98,15 @@ struct TCPDeepCCInfo {
     u32 total_thr_cnt = this->thr_cnt + src.thr_cnt;
 
     // cnt and thr_cnt may be zero
+    // sums in 64 bits: cnt * avg_urtt alone overflows u32 past ~4.3e9 us,
+    // e.g. ~860k samples of 5 ms, and avg_thr is 64-bit already
 
-    u32 avg_rtt_us = (this->cnt * this->avg_urtt + src.cnt * src.avg_urtt) /
-                     std::max(total_rtt_cnt, u32(1));
-    u32 avg_tput_bps =
-        (this->thr_cnt * this->avg_thr + src.thr_cnt * src.avg_thr) /
-        std::max(total_thr_cnt, u32(1));
+    u64 avg_rtt_us =
+        (u64(this->cnt) * this->avg_urtt + u64(src.cnt) * src.avg_urtt) /
+        std::max(u64(total_rtt_cnt), u64(1));
+    u64 avg_tput_bps =
+        (u64(this->thr_cnt) * this->avg_thr + u64(src.thr_cnt) * src.avg_thr) /
+        std::max(u64(total_thr_cnt), u64(1));
 
     // merge results into des
     this->thr_cnt = total_thr_cnt;
@@ -127,6 +114,8 @@ struct TCPDeepCCInfo {
     this->avg_thr = avg_tput_bps;
     this->avg_urtt = avg_rtt_us;
     this->lost_bytes += src.lost_bytes;
+    this->max_packets_out =
+        std::max(this->max_packets_out, src.max_packets_out);
   }
 };
 
@@ -0,0 +1,150 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "tcp_state_provider.hh"
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "common.hh"
+#include "exception.hh"
+#include "offline_state_provider.hh"
+#include "timestamp.hh"
+
+using namespace std;
+
+unique_ptr<TCPStateProvider> TCPStateProvider::make(
+    const string& spec, const double time_scale, const string& actions_log) {
+  /* name, then arguments separated by ':' */
+  vector<string> args;
+  for (size_t begin = 0;;) {
+    const size_t end = spec.find(':', begin);
+    args.push_back(spec.substr(begin, end - begin));
+    if (end == string::npos) {
+      break;
+    }
+    begin = end + 1;
+  }
+  const string& name = args.front();
+
+  if (name == "replay" and args.size() == 2) {
+    return make_unique<ReplayStateProvider>(args[1], time_scale, actions_log);
+  } else if (name == "synthetic" and args.size() <= 4) {
+    /* 100 Mbps, 40 ms and 60 s unless given */
+    const double mbps = args.size() > 1 ? stod(args[1]) : 100;
+    const double rtt_ms = args.size() > 2 ? stod(args[2]) : 40;
+    const double seconds = args.size() > 3 ? stod(args[3]) : 60;
+    return make_unique<SyntheticStateProvider>(
+        SyntheticLink{u64(mbps * 1e6 / 8), u32(rtt_ms * 1000)},
+        uint64_t(seconds * 1e6), time_scale, actions_log);
+  }
+
+  if (time_scale != 1 or not actions_log.empty()) {
+    throw runtime_error("a time scale or an actions log needs the replay or "
+                        "synthetic TCP state provider");
+  }
+  if (spec == "deepcc") {
+    return make_unique<DeepCCStateProvider>();
+  } else if (spec == "tcp_info") {
+    return make_unique<TCPInfoStateProvider>();
+  }
+  throw runtime_error("unknown TCP state provider: " + spec);
+}
+
+void DeepCCStateProvider::enable(const int fd, const int val) {
+  SystemCall("setsockopt TCP_DEEPCC_ENABLE",
+             setsockopt(fd, IPPROTO_TCP, TCP_DEEPCC_ENABLE, &val, sizeof(val)));
+}
+
+TCPDeepCCInfo DeepCCStateProvider::sample(const int fd) {
+  TCPDeepCCInfo info;
+  socklen_t len = sizeof(info);
+  SystemCall("getsockopt TCP_DEEPCC_INFO",
+             getsockopt(fd, IPPROTO_TCP, TCP_DEEPCC_INFO, &info, &len));
+  return info;
+}
+
+void DeepCCStateProvider::set_cwnd(const int fd, const uint32_t cwnd) {
+  const int val = cwnd;
+  SystemCall("setsockopt TCP_CWND",
+             setsockopt(fd, IPPROTO_TCP, TCP_CWND, &val, sizeof(val)));
+}
+
+void TCPStateProvider::set_pacing_rate(const int fd, const uint64_t rate) {
+  /* ~0U means unlimited */
+  const uint32_t val = min(rate, uint64_t(UINT32_MAX - 1));
+  SystemCall("setsockopt SO_MAX_PACING_RATE",
+             setsockopt(fd, SOL_SOCKET, SO_MAX_PACING_RATE, &val, sizeof(val)));
+}
+
+TCPInfoStateProvider::TCPInfoStateProvider() : last_us_(monotonic_usecs()) {}
+
+string TCPInfoStateProvider::congestion_control(const string& cc) const {
+  return cc == "astraea" ? "cubic" : cc;
+}
+
+void TCPInfoStateProvider::enable(const int, const int) {
+  /* TCP_INFO needs nothing enabled */
+}
+
+TCPDeepCCInfo TCPInfoStateProvider::sample(const int fd) {
+  tcp_info info{};
+  socklen_t len = sizeof(info);
+  SystemCall("getsockopt TCP_INFO",
+             getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len));
+  const uint64_t now = monotonic_usecs();
+  const uint64_t elapsed_us = max(now - last_us_, uint64_t(1));
+
+  TCPDeepCCInfo out;
+  out.init();
+  out.min_rtt = info.tcpi_min_rtt;
+  /* tcpi_delivered came with 4.18: before that, count the RTT as one sample
+   * whenever there is one */
+  const bool has_delivered =
+      len >= offsetof(tcp_info, tcpi_delivered) + sizeof(info.tcpi_delivered);
+  const uint32_t delivered =
+      has_delivered ? info.tcpi_delivered - last_.tcpi_delivered : 1;
+  if (info.tcpi_rtt > 0 and delivered > 0) {
+    out.avg_urtt = info.tcpi_rtt;
+    out.cnt = delivered;
+  }
+  out.avg_thr =
+      (info.tcpi_bytes_acked - last_.tcpi_bytes_acked) * 1000000 / elapsed_us;
+  out.thr_cnt = 1;
+  out.cwnd = cwnd_ > 0 ? cwnd_ : info.tcpi_snd_cwnd;
+  out.pacing_rate =
+      min(uint64_t(info.tcpi_pacing_rate), uint64_t(UINT32_MAX));
+  out.lost_bytes = info.tcpi_bytes_retrans - last_.tcpi_bytes_retrans;
+  /* the patched kernel reports srtt << 3, as tcp_sock keeps it */
+  out.srtt_us = info.tcpi_rtt << 3;
+  out.snd_ssthresh = info.tcpi_snd_ssthresh;
+  out.packets_out = info.tcpi_unacked;
+  out.retrans_out = info.tcpi_retrans;
+  /* the in-flight peak between samples is not visible from here */
+  out.max_packets_out = info.tcpi_unacked;
+  out.mss = info.tcpi_snd_mss;
+
+  last_ = info;
+  last_us_ = now;
+  return out;
+}
+
+void TCPInfoStateProvider::set_cwnd(const int fd, const uint32_t cwnd) {
+  cwnd_ = cwnd;
+  /* a rate set of its own replaces the one from the window; with no RTT
+   * yet, leave the flow unpaced until the first sample has one */
+  if (paced_ or last_.tcpi_rtt == 0 or last_.tcpi_snd_mss == 0) {
+    return;
+  }
+  TCPStateProvider::set_pacing_rate(
+      fd, uint64_t(cwnd) * last_.tcpi_snd_mss * 1000000 / last_.tcpi_rtt);
+}
+
+void TCPInfoStateProvider::set_pacing_rate(const int fd, const uint64_t rate) {
+  paced_ = true;
+  TCPStateProvider::set_pacing_rate(fd, rate);
+}
@@ -0,0 +1,99 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef TCP_STATE_PROVIDER_HH
+#define TCP_STATE_PROVIDER_HH
+
+#include <linux/tcp.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "tcp_info.hh"
+
+/* where a DeepCCSocket gets its TCP state from and where its congestion
+ * window goes to.
+ *
+ * Providers:
+ *   deepcc:   the patched kernel's TCP_DEEPCC_INFO and TCP_CWND (default)
+ *   tcp_info: any kernel; see TCPInfoStateProvider
+ *   replay:PERF_LOG, synthetic[:MBPS[:RTT_MS[:SECONDS]]]: no kernel at
+ *             all; see offline_state_provider.hh
+ * A provider serves one socket: it keeps what it needs between samples. */
+class TCPStateProvider {
+ public:
+  virtual ~TCPStateProvider() {}
+
+  /* one of the providers above; the time scale and the actions log only
+   * apply to the offline ones */
+  static std::unique_ptr<TCPStateProvider> make(
+      const std::string& spec, const double time_scale = 1,
+      const std::string& actions_log = "");
+
+  virtual std::string name(void) const = 0;
+
+  /* the kernel congestion control to run for a flow asking for `cc` */
+  virtual std::string congestion_control(const std::string& cc) const {
+    return cc;
+  }
+
+  /* prepare connected socket `fd` for sample() and set_cwnd() */
+  virtual void enable(const int fd, const int val) = 0;
+
+  /* TCP state of `fd`; avg_urtt, cnt, avg_thr, thr_cnt and lost_bytes cover
+   * the time since the previous sample */
+  virtual TCPDeepCCInfo sample(const int fd) = 0;
+
+  /* apply a congestion window of `cwnd` packets */
+  virtual void set_cwnd(const int fd, const uint32_t cwnd) = 0;
+
+  /* cap the sending rate at `rate` bytes per second, which the kernel
+   * paces to (SO_MAX_PACING_RATE) */
+  virtual void set_pacing_rate(const int fd, const uint64_t rate);
+
+  /* how much faster than real time the states go by */
+  virtual double time_scale(void) const { return 1; }
+
+  /* whether the states have run out */
+  virtual bool finished(void) const { return false; }
+};
+
+/* the patched kernel, which keeps the per-interval averages itself */
+class DeepCCStateProvider : public TCPStateProvider {
+ public:
+  std::string name(void) const override { return "deepcc"; }
+  void enable(const int fd, const int val) override;
+  TCPDeepCCInfo sample(const int fd) override;
+  void set_cwnd(const int fd, const uint32_t cwnd) override;
+};
+
+/* a stock kernel: the state is derived from the difference between two
+ * TCP_INFO samples, and the window is applied as the pacing rate that sends
+ * `cwnd` packets per smoothed RTT (SO_MAX_PACING_RATE), until a rate is
+ * set of its own.
+ *
+ * The kernel runs CUBIC in place of the astraea module and the pacing rate
+ * bounds it, so the kernel's own cwnd says little about the flow: samples
+ * report the last window applied instead, once there is one. */
+class TCPInfoStateProvider : public TCPStateProvider {
+ public:
+  TCPInfoStateProvider();
+
+  std::string name(void) const override { return "tcp_info"; }
+  std::string congestion_control(const std::string& cc) const override;
+  void enable(const int fd, const int val) override;
+  TCPDeepCCInfo sample(const int fd) override;
+  void set_cwnd(const int fd, const uint32_t cwnd) override;
+  void set_pacing_rate(const int fd, const uint64_t rate) override;
+
+ private:
+  /* the previous sample and when it was taken */
+  tcp_info last_{};
+  uint64_t last_us_;
+  /* the last window applied, 0 if none */
+  uint32_t cwnd_{0};
+  /* whether the rate is set of its own, and no longer from the window */
+  bool paced_{false};
+};
+
+#endif /* TCP_STATE_PROVIDER_HH */
@@ -0,0 +1,57 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "thread_cost.hh"
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+
+#include "exception.hh"
+
+using namespace std;
+
+static uint64_t thread_cpu_ns(void) {
+  timespec ts;
+  SystemCall("clock_gettime", clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts));
+  return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/* CPU cycles of the calling thread, user and kernel; -1 where perf events
+ * are not permitted */
+static int open_cycle_counter(void) {
+  perf_event_attr attr{};
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = PERF_COUNT_HW_CPU_CYCLES;
+  attr.exclude_hv = 1;
+  return syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+ThreadCost::ThreadCost()
+    : cpu_start_ns_(thread_cpu_ns()), cycles_fd_(open_cycle_counter()) {}
+
+ThreadCost::~ThreadCost() {
+  if (cycles_fd_ >= 0) {
+    ::close(cycles_fd_);
+  }
+}
+
+string ThreadCost::per_byte(const uint64_t bytes) {
+  if (bytes == 0) {
+    return "no bytes";
+  }
+
+  ostringstream out;
+  out << fixed << setprecision(3)
+      << double(thread_cpu_ns() - cpu_start_ns_) / bytes << " CPU ns/byte";
+  uint64_t cycles;
+  if (cycles_fd_ >= 0 and
+      ::read(cycles_fd_, &cycles, sizeof(cycles)) == sizeof(cycles)) {
+    out << ", " << double(cycles) / bytes << " cycles/byte";
+  }
+  return out.str();
+}
@@ -0,0 +1,28 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef THREAD_COST_HH
+#define THREAD_COST_HH
+
+#include <cstdint>
+#include <string>
+
+/* CPU time, and cycles where perf events are permitted, that the thread
+ * which constructed the object has spent since. Read it on that thread. */
+class ThreadCost {
+ public:
+  ThreadCost();
+  ~ThreadCost();
+
+  /* e.g. "0.143 CPU ns/byte, 0.412 cycles/byte" */
+  std::string per_byte(const uint64_t bytes);
+
+  /* forbid copying ThreadCost objects or assigning them */
+  ThreadCost(const ThreadCost& other) = delete;
+  const ThreadCost& operator=(const ThreadCost& other) = delete;
+
+ private:
+  uint64_t cpu_start_ns_;
+  int cycles_fd_;
+};
+
+#endif /* THREAD_COST_HH */
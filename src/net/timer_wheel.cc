@@ -0,0 +1,291 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "timer_wheel.hh"
+
+#include <cassert>
+#include <stdexcept>
+
+using namespace std;
+
+TimerWheel::TimerWheel(const uint64_t now_us, const uint64_t tick_us)
+    : tick_us_(tick_us), origin_us_(now_us) {
+  if (tick_us_ == 0) {
+    throw runtime_error("TimerWheel: tick must be positive");
+  }
+  heads_.fill(NIL);
+}
+
+uint64_t TimerWheel::to_tick(const uint64_t time_us) const {
+  return time_us <= origin_us_ ? 0 : (time_us - origin_us_) / tick_us_;
+}
+
+uint32_t TimerWheel::allocate_node(void) {
+  if (not free_nodes_.empty()) {
+    const uint32_t index = free_nodes_.back();
+    free_nodes_.pop_back();
+    return index;
+  }
+
+  if (nodes_.size() >= NIL) {
+    throw runtime_error("TimerWheel: too many timers");
+  }
+  nodes_.emplace_back();
+  return nodes_.size() - 1;
+}
+
+void TimerWheel::release_node(const uint32_t index) {
+  Node& node = nodes_[index];
+  node.callback = nullptr;
+  node.state = State::Free;
+  /* invalidate outstanding ids referring to this node */
+  node.generation++;
+  free_nodes_.push_back(index);
+  active_count_--;
+}
+
+void TimerWheel::link(const uint32_t index, const uint32_t list) {
+  Node& node = nodes_[index];
+  node.list = list;
+  node.prev = NIL;
+  node.next = heads_[list];
+  if (node.next != NIL) {
+    nodes_[node.next].prev = index;
+  }
+  heads_[list] = index;
+}
+
+void TimerWheel::unlink(const uint32_t index) {
+  Node& node = nodes_[index];
+  if (node.prev != NIL) {
+    nodes_[node.prev].next = node.next;
+  } else {
+    heads_[node.list] = node.next;
+  }
+  if (node.next != NIL) {
+    nodes_[node.next].prev = node.prev;
+  }
+  node.prev = node.next = node.list = NIL;
+}
+
+void TimerWheel::schedule(const uint32_t index) {
+  uint64_t expires = nodes_[index].expiry_tick;
+  if (expires < current_tick_) {
+    /* already due: run on the next processed tick */
+    expires = current_tick_;
+  }
+
+  const uint64_t delta = expires - current_tick_;
+  unsigned int level = 0;
+  while (level < LEVELS - 1 and delta >= (SLOTS << (level * SLOT_BITS))) {
+    level++;
+  }
+
+  if (level == LEVELS - 1) {
+    /* beyond the range of the wheel: park in the farthest slot and let the
+     * cascade place the timer again */
+    const uint64_t max_delta = (uint64_t(1) << (LEVELS * SLOT_BITS)) - 1;
+    expires = current_tick_ + min(delta, max_delta);
+  }
+
+  const uint64_t slot = (expires >> (level * SLOT_BITS)) & SLOT_MASK;
+  link(index, level * SLOTS + slot);
+}
+
+TimerWheel::TimerId TimerWheel::add(const uint64_t now_us,
+                                    const uint64_t delay_us,
+                                    CallbackType&& callback,
+                                    const uint64_t period_us) {
+  const uint32_t index = allocate_node();
+  Node& node = nodes_[index];
+
+  node.callback = move(callback);
+  node.deadline_us = now_us + delay_us;
+  node.period_us = period_us;
+  node.expiry_tick = to_tick(node.deadline_us);
+  node.state = State::Pending;
+  active_count_++;
+
+  schedule(index);
+
+  return (uint64_t(node.generation) << 32) | index;
+}
+
+bool TimerWheel::cancel(const TimerId id) {
+  const uint32_t index = id & UINT32_MAX;
+  const uint32_t generation = id >> 32;
+
+  if (index >= nodes_.size() or nodes_[index].generation != generation) {
+    return false;
+  }
+
+  Node& node = nodes_[index];
+  switch (node.state) {
+  case State::Pending:
+    unlink(index);
+    release_node(index);
+    return true;
+
+  case State::Running:
+    /* released by run_expired() once the callback returns */
+    node.state = State::Cancelled;
+    return true;
+
+  default:
+    return false;
+  }
+}
+
+void TimerWheel::cascade(const unsigned int level) {
+  const uint64_t slot =
+      (current_tick_ >> (level * SLOT_BITS)) & SLOT_MASK;
+  uint32_t index = heads_[level * SLOTS + slot];
+  heads_[level * SLOTS + slot] = NIL;
+
+  while (index != NIL) {
+    const uint32_t next = nodes_[index].next;
+    schedule(index);
+    index = next;
+  }
+}
+
+void TimerWheel::run_expired(const uint64_t now_us) {
+  while (heads_[EXPIRED_LIST] != NIL) {
+    const uint32_t index = heads_[EXPIRED_LIST];
+    unlink(index);
+
+    const uint64_t deadline_us = nodes_[index].deadline_us;
+    if (deadline_us > now_us) {
+      /* due later within the processed tick: never fire early */
+      link(index, current_tick_ & SLOT_MASK);
+      continue;
+    }
+
+    nodes_[index].state = State::Running;
+    const uint64_t lateness_us = now_us > deadline_us ? now_us - deadline_us : 0;
+    stats_.fired++;
+    stats_.total_lateness_us += lateness_us;
+    stats_.max_lateness_us = max(stats_.max_lateness_us, lateness_us);
+
+    /* callbacks may add timers and thereby reallocate nodes_ */
+    CallbackType callback = move(nodes_[index].callback);
+    try {
+      callback();
+    } catch (...) {
+      /* leave the wheel as the next advance() expects it: this timer done
+       * or rescheduled, and the rest of the tick's timers back in a slot */
+      finish_running(index, move(callback), now_us);
+      while (heads_[EXPIRED_LIST] != NIL) {
+        const uint32_t pending = heads_[EXPIRED_LIST];
+        unlink(pending);
+        schedule(pending);
+      }
+      throw;
+    }
+    finish_running(index, move(callback), now_us);
+  }
+}
+
+void TimerWheel::finish_running(const uint32_t index, CallbackType&& callback,
+                                const uint64_t now_us) {
+  Node& node = nodes_[index];
+  if (node.state == State::Running and node.period_us > 0) {
+    /* keep the original phase; skip periods that were missed entirely */
+    node.deadline_us += node.period_us;
+    if (node.deadline_us <= now_us) {
+      const uint64_t missed = (now_us - node.deadline_us) / node.period_us + 1;
+      node.deadline_us += missed * node.period_us;
+    }
+    node.expiry_tick = to_tick(node.deadline_us);
+    node.callback = move(callback);
+    node.state = State::Pending;
+    schedule(index);
+  } else {
+    release_node(index);
+  }
+}
+
+size_t TimerWheel::advance(const uint64_t now_us) {
+  const uint64_t target_tick = to_tick(now_us);
+
+  if (active_count_ == 0) {
+    /* nothing to cascade: jump straight to the present */
+    current_tick_ = max(current_tick_, target_tick + 1);
+    return 0;
+  }
+
+  const uint64_t fired_before = stats_.fired;
+
+  while (current_tick_ <= target_tick) {
+    const uint64_t slot = current_tick_ & SLOT_MASK;
+
+    /* refill the finer levels when they wrap around */
+    for (unsigned int level = 1;
+         level < LEVELS and
+         ((current_tick_ >> ((level - 1) * SLOT_BITS)) & SLOT_MASK) == 0;
+         level++) {
+      cascade(level);
+    }
+
+    /* move the due list aside so callbacks can schedule into this slot */
+    assert(heads_[EXPIRED_LIST] == NIL);
+    uint32_t index = heads_[slot];
+    heads_[slot] = NIL;
+    while (index != NIL) {
+      const uint32_t next = nodes_[index].next;
+      link(index, EXPIRED_LIST);
+      index = next;
+    }
+
+    current_tick_++;
+    run_expired(now_us);
+  }
+
+  return stats_.fired - fired_before;
+}
+
+uint64_t TimerWheel::next_expiry_us(void) const {
+  if (active_count_ == 0) {
+    return UINT64_MAX;
+  }
+
+  /* does processing tick `t` cascade a non-empty higher-level slot? */
+  auto cascades_at = [this](const uint64_t t) {
+    for (unsigned int level = 1; level < LEVELS; level++) {
+      if (((t >> ((level - 1) * SLOT_BITS)) & SLOT_MASK) != 0) {
+        return false;
+      }
+      const uint64_t slot = (t >> (level * SLOT_BITS)) & SLOT_MASK;
+      if (heads_[level * SLOTS + slot] != NIL) {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  /* level 0 holds exactly the timers of the next SLOTS ticks */
+  for (uint64_t t = current_tick_; t < current_tick_ + SLOTS; t++) {
+    const uint64_t tick_start_us = origin_us_ + t * tick_us_;
+    if (cascades_at(t)) {
+      return tick_start_us;
+    }
+
+    /* wake at the earliest deadline, but no earlier than the tick itself
+     * can be processed */
+    uint64_t earliest_us = UINT64_MAX;
+    for (uint32_t index = heads_[t & SLOT_MASK]; index != NIL;
+         index = nodes_[index].next) {
+      earliest_us = min(earliest_us, nodes_[index].deadline_us);
+    }
+    if (earliest_us != UINT64_MAX) {
+      return max(earliest_us, tick_start_us);
+    }
+  }
+
+  /* otherwise the next event is a cascade at a later level-0 wraparound,
+   * starting with the first one the scan above did not reach */
+  uint64_t t = ((current_tick_ + SLOTS - 1) >> SLOT_BITS) << SLOT_BITS;
+  for (uint64_t i = 0; i < SLOTS and not cascades_at(t); i++) {
+    t += SLOTS;
+  }
+  return origin_us_ + t * tick_us_;
+}
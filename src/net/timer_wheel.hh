@@ -0,0 +1,115 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef TIMER_WHEEL_HH
+#define TIMER_WHEEL_HH
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/* hierarchical timing wheel (Varghese & Lauck) with O(1) add and cancel.
+ *
+ * Time is kept in microseconds and quantized to ticks. Level 0 holds the
+ * timers due within the next SLOTS ticks; each higher level covers SLOTS
+ * times the range of the level below and is cascaded downwards whenever the
+ * level below wraps around. The wheel never reads a clock itself: the owner
+ * passes the current time to add() and advance(). */
+class TimerWheel {
+ public:
+  typedef std::function<void(void)> CallbackType;
+
+  /* opaque handle of a timer; 0 is never a valid id */
+  typedef uint64_t TimerId;
+
+  struct Stats {
+    uint64_t fired{0};
+    /* lateness of firings against their deadlines */
+    uint64_t total_lateness_us{0};
+    uint64_t max_lateness_us{0};
+  };
+
+  static constexpr uint64_t DEFAULT_TICK_US = 100;
+
+  TimerWheel(const uint64_t now_us, const uint64_t tick_us = DEFAULT_TICK_US);
+
+  /* run `callback` once after `delay_us`; if `period_us` is non-zero, keep
+   * running it every `period_us` afterwards until cancelled */
+  TimerId add(const uint64_t now_us, const uint64_t delay_us,
+              CallbackType&& callback, const uint64_t period_us = 0);
+
+  /* returns false if the timer already fired (one-shot) or was cancelled;
+   * a timer may cancel itself or others from inside its callback */
+  bool cancel(const TimerId id);
+
+  /* fire every timer due at or before `now_us`; returns the number fired.
+   * An exception from a callback propagates, and the next call carries on
+   * with the timers left due. */
+  size_t advance(const uint64_t now_us);
+
+  /* earliest time at which advance() may have something to do: either the
+   * earliest deadline in the next non-empty level-0 slot or the next cascade
+   * of a higher level */
+  uint64_t next_expiry_us(void) const;
+
+  size_t size(void) const { return active_count_; }
+  bool empty(void) const { return active_count_ == 0; }
+  uint64_t tick_us(void) const { return tick_us_; }
+  const Stats& stats(void) const { return stats_; }
+
+  /* forbid copying: callbacks may capture `this` of the owner */
+  TimerWheel(const TimerWheel& other) = delete;
+  TimerWheel& operator=(const TimerWheel& other) = delete;
+
+ private:
+  static constexpr unsigned int SLOT_BITS = 6;
+  static constexpr uint64_t SLOTS = 1 << SLOT_BITS;
+  static constexpr uint64_t SLOT_MASK = SLOTS - 1;
+  static constexpr unsigned int LEVELS = 4;
+
+  static constexpr uint32_t NIL = UINT32_MAX;
+  /* list holding the timers of the tick being processed */
+  static constexpr uint32_t EXPIRED_LIST = LEVELS * SLOTS;
+
+  enum class State : uint8_t { Free, Pending, Running, Cancelled };
+
+  struct Node {
+    CallbackType callback{};
+    uint64_t deadline_us{0};
+    uint64_t period_us{0};
+    uint64_t expiry_tick{0};
+    uint32_t prev{NIL}, next{NIL};
+    uint32_t list{NIL};
+    uint32_t generation{1};
+    State state{State::Free};
+  };
+
+  uint64_t tick_us_;
+  uint64_t origin_us_;
+  /* next tick to be processed */
+  uint64_t current_tick_{0};
+  size_t active_count_{0};
+  Stats stats_{};
+
+  std::vector<Node> nodes_{};
+  std::vector<uint32_t> free_nodes_{};
+  /* heads of the slot lists, plus the expired list at EXPIRED_LIST */
+  std::array<uint32_t, LEVELS * SLOTS + 1> heads_{};
+
+  uint64_t to_tick(const uint64_t time_us) const;
+  uint32_t allocate_node(void);
+  void release_node(const uint32_t index);
+
+  void link(const uint32_t index, const uint32_t list);
+  void unlink(const uint32_t index);
+  /* place a pending node in the slot matching its expiry tick */
+  void schedule(const uint32_t index);
+  /* move timers of a higher-level slot down to finer levels */
+  void cascade(const unsigned int level);
+  void run_expired(const uint64_t now_us);
+  /* reschedule a periodic timer whose callback has run, or release it */
+  void finish_running(const uint32_t index, CallbackType&& callback,
+                      const uint64_t now_us);
+};
+
+#endif /* TIMER_WHEEL_HH */
@@ -0,0 +1,52 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "timerfd.hh"
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "exception.hh"
+
+using namespace std;
+
+TimerFD::TimerFD()
+    : FileDescriptor(CheckSystemCall(
+          "timerfd_create", timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK))) {}
+
+void TimerFD::arm(const uint64_t deadline_us) {
+  itimerspec spec;
+  memset(&spec, 0, sizeof(spec));
+
+  /* an all-zero it_value would disarm the timer */
+  const uint64_t deadline = max(deadline_us, uint64_t(1));
+  spec.it_value.tv_sec = deadline / 1000000;
+  spec.it_value.tv_nsec = (deadline % 1000000) * 1000;
+
+  CheckSystemCall("timerfd_settime", timerfd_settime(fd_num(), TFD_TIMER_ABSTIME,
+                                                     &spec, nullptr));
+}
+
+void TimerFD::disarm(void) {
+  itimerspec spec;
+  memset(&spec, 0, sizeof(spec));
+
+  CheckSystemCall("timerfd_settime",
+                  timerfd_settime(fd_num(), 0, &spec, nullptr));
+}
+
+/* read the expiration count; a timer re-armed after poll() reads zero */
+uint64_t TimerFD::read_expirations(void) {
+  uint64_t expirations = 0;
+
+  const ssize_t bytes_read =
+      ::read(fd_num(), &expirations, sizeof(expirations));
+  if (bytes_read < 0 and errno != EAGAIN) {
+    throw unix_error("read timerfd");
+  }
+
+  register_read();
+
+  return bytes_read == sizeof(expirations) ? expirations : 0;
+}
@@ -0,0 +1,26 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef TIMERFD_HH
+#define TIMERFD_HH
+
+#include <cstdint>
+
+#include "file_descriptor.hh"
+
+/* wrapper class for a CLOCK_MONOTONIC timer file descriptor */
+
+class TimerFD : public FileDescriptor {
+ public:
+  TimerFD();
+
+  /* fire once at the absolute monotonic time `deadline_us` */
+  void arm(const uint64_t deadline_us);
+
+  /* stop the timer */
+  void disarm(void);
+
+  /* number of expirations since the last read */
+  uint64_t read_expirations(void);
+};
+
+#endif /* TIMERFD_HH */
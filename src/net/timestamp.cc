@@ -1,18 +1,131 @@
 /* -*-mode:c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
 
+#include <cstdlib>
+#include <cstring>
 #include <ctime>
+#include <thread>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <cpuid.h>
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
 
 #include "timestamp.hh"
 #include "exception.hh"
 
-uint64_t raw_timestamp_usecs( void )
+uint64_t monotonic_nsecs( void )
 {
     timespec ts;
-    SystemCall( "clock_gettime", clock_gettime( CLOCK_REALTIME, &ts ) );
+    SystemCall( "clock_gettime", clock_gettime( CLOCK_MONOTONIC, &ts ) );
+
+    return uint64_t( ts.tv_sec ) * 1000000000 + ts.tv_nsec;
+}
+
+uint64_t monotonic_usecs( void )
+{
+    return monotonic_nsecs() / 1000;
+}
+
+namespace {
+
+/* ISO C++ has no 128-bit integer; the tick-to-ns product needs one */
+__extension__ typedef unsigned __int128 uint128_t;
+
+/* the TSC, scaled to ns by a calibration against CLOCK_MONOTONIC */
+class TSCClock
+{
+private:
+    bool enabled_ { false };
+    uint64_t base_ticks_ { 0 };
+    uint64_t base_nsecs_ { 0 };
+    /* ns per tick, as a 32.32 fixed-point number */
+    uint64_t scale_ { 0 };
+
+    /* CPUID.80000007H:EDX[8]: the TSC ticks at a constant rate in all
+     * P-, C- and T-states */
+    static bool invariant_tsc( void )
+    {
+#ifdef HAVE_TSC
+        unsigned int eax, ebx, ecx, edx;
+        if ( not __get_cpuid( 0x80000007, &eax, &ebx, &ecx, &edx ) ) {
+            return false;
+        }
+        return edx & ( 1 << 8 );
+#else
+        return false;
+#endif
+    }
+
+    static uint64_t ticks( void )
+    {
+#ifdef HAVE_TSC
+        return __rdtsc();
+#else
+        return 0;
+#endif
+    }
+
+    /* a TSC reading and the CLOCK_MONOTONIC time halfway through reading it */
+    static void sample( uint64_t & tsc, uint64_t & nsecs )
+    {
+        const uint64_t before = monotonic_nsecs();
+        tsc = ticks();
+        nsecs = ( before + monotonic_nsecs() ) / 2;
+    }
+
+public:
+    /* calibrates over this long at first use */
+    static constexpr auto CALIBRATION = std::chrono::milliseconds( 20 );
 
-    uint64_t usecs = uint64_t( ts.tv_nsec ) / 1000;
-    usecs += uint64_t( ts.tv_sec ) * 1000000;
-    return usecs;
+    TSCClock()
+    {
+        const char * choice = getenv( "MONOTONIC_CLOCK" );
+        if ( choice == nullptr or strcmp( choice, "tsc" ) or not invariant_tsc() ) {
+            return;
+        }
+
+        uint64_t start_ticks, start_nsecs, end_ticks, end_nsecs;
+        sample( start_ticks, start_nsecs );
+        std::this_thread::sleep_for( CALIBRATION );
+        sample( end_ticks, end_nsecs );
+        if ( end_ticks <= start_ticks ) {
+            return;
+        }
+
+        scale_ = ( uint128_t( end_nsecs - start_nsecs ) << 32 )
+                 / ( end_ticks - start_ticks );
+        base_ticks_ = end_ticks;
+        base_nsecs_ = end_nsecs;
+        enabled_ = true;
+    }
+
+    bool enabled( void ) const { return enabled_; }
+
+    uint64_t nsecs( void ) const
+    {
+        const uint64_t elapsed = ticks() - base_ticks_;
+        return base_nsecs_ + uint64_t( ( uint128_t( elapsed ) * scale_ ) >> 32 );
+    }
+};
+
+const TSCClock & tsc_clock( void )
+{
+    static const TSCClock clock;
+    return clock;
+}
+
+}
+
+uint64_t steady_nsecs( void )
+{
+    const TSCClock & tsc = tsc_clock();
+    return tsc.enabled() ? tsc.nsecs() : monotonic_nsecs();
+}
+
+const char * steady_clock_source( void )
+{
+    return tsc_clock().enabled() ? "tsc" : "clock_gettime";
 }
 
 inline uint64_t usec_to_msec( uint64_t timestamp_usec )
@@ -22,7 +135,7 @@ inline uint64_t usec_to_msec( uint64_t timestamp_usec )
 
 uint64_t initial_timestamp_usecs( void )
 {
-    static uint64_t initial_usecs = raw_timestamp_usecs();
+    static uint64_t initial_usecs = steady_nsecs() / 1000;
     return initial_usecs;
 }
 
@@ -33,7 +146,7 @@ uint64_t initial_timestamp( void )
 
 uint64_t timestamp_usecs( void )
 {
-    return raw_timestamp_usecs() - initial_timestamp_usecs();
+    return steady_nsecs() / 1000 - initial_timestamp_usecs();
 }
 
 uint64_t timestamp( void )
@@ -3,12 +3,47 @@
 #ifndef TIMESTAMP_HH
 #define TIMESTAMP_HH
 
+#include <chrono>
 #include <cstdint>
 
+/* The clocks of the net code and the control loops. All are monotonic, so
+ * none jumps when NTP steps the wall clock. */
+
+/* time since the process first asked, in ms and us */
 uint64_t timestamp( void );
 uint64_t initial_timestamp( void );
 
 uint64_t timestamp_usecs( void );
 uint64_t initial_timestamp_usecs( void );
 
+/* absolute CLOCK_MONOTONIC time, for deadlines and timers, and for
+ * timestamps compared across processes */
+uint64_t monotonic_usecs( void );
+uint64_t monotonic_nsecs( void );
+
+/* the cheapest monotonic clock, for measuring intervals within a process:
+ * CLOCK_MONOTONIC, or with MONOTONIC_CLOCK=tsc in the environment and an
+ * invariant TSC, the TSC calibrated against CLOCK_MONOTONIC at first use.
+ * The TSC may drift from CLOCK_MONOTONIC by a few ppm, so never arm a
+ * timerfd with it. */
+uint64_t steady_nsecs( void );
+
+/* "tsc" or "clock_gettime" */
+const char * steady_clock_source( void );
+
+/* steady_nsecs() as a std::chrono clock, for the control loops */
+struct SteadyClock
+{
+    typedef std::chrono::nanoseconds duration;
+    typedef duration::rep rep;
+    typedef duration::period period;
+    typedef std::chrono::time_point<SteadyClock> time_point;
+    static constexpr bool is_steady = true;
+
+    static time_point now( void ) noexcept
+    {
+        return time_point( duration( steady_nsecs() ) );
+    }
+};
+
 #endif /* TIMESTAMP_HH */
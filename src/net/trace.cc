@@ -0,0 +1,181 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "trace.hh"
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "exception.hh"
+#include "timestamp.hh"
+
+using namespace std;
+
+namespace {
+
+struct Record {
+  uint64_t ts_ns;
+  uint64_t step;
+  uint32_t flow_id;
+  TraceStage stage;
+};
+
+/* records are kept in chunks that never move, so dump() can read them while
+ * the owning thread keeps appending */
+constexpr size_t CHUNK_RECORDS = 4096;
+constexpr size_t MAX_CHUNKS = 512;
+
+struct ThreadBuffer {
+  pid_t tid{0};
+  array<atomic<Record*>, MAX_CHUNKS> chunks{};
+  /* published with release once a record is complete */
+  atomic<size_t> count{0};
+  atomic<uint64_t> dropped{0};
+};
+
+atomic<bool> trace_enabled(false);
+atomic<bool> trace_dumped(false);
+string trace_path;
+
+/* buffers outlive their threads: the trace is written at exit */
+mutex registry_mutex;
+vector<ThreadBuffer*> registry;
+
+ThreadBuffer& local_buffer(void) {
+  thread_local ThreadBuffer* buffer = nullptr;
+  if (buffer == nullptr) {
+    buffer = new ThreadBuffer();
+    buffer->tid = syscall(SYS_gettid);
+    lock_guard<mutex> lock(registry_mutex);
+    registry.push_back(buffer);
+  }
+  return *buffer;
+}
+
+const char* stage_name(const TraceStage stage) {
+  switch (stage) {
+  case TraceStage::ClientSample:
+    return "client sample";
+  case TraceStage::ClientSend:
+    return "client send";
+  case TraceStage::ServerReceive:
+    return "server receive";
+  case TraceStage::Enqueue:
+    return "enqueue";
+  case TraceStage::BatchStart:
+    return "batch start";
+  case TraceStage::InferenceEnd:
+    return "inference end";
+  case TraceStage::ReplySend:
+    return "reply send";
+  case TraceStage::ClientSetCwnd:
+    return "client set cwnd";
+  }
+  return "unknown";
+}
+
+}  // namespace
+
+namespace trace {
+
+void enable(const string& path) {
+  trace_path = path;
+  if (not trace_enabled.exchange(true)) {
+    atexit(dump);
+  }
+}
+
+bool enabled(void) { return trace_enabled.load(memory_order_relaxed); }
+
+void record(const TraceStage stage, const uint32_t flow_id,
+            const uint64_t step) {
+  if (not trace_enabled.load(memory_order_relaxed)) {
+    return;
+  }
+
+  ThreadBuffer& buffer = local_buffer();
+  const size_t index = buffer.count.load(memory_order_relaxed);
+  if (index >= MAX_CHUNKS * CHUNK_RECORDS) {
+    buffer.dropped.fetch_add(1, memory_order_relaxed);
+    return;
+  }
+
+  auto& chunk = buffer.chunks[index / CHUNK_RECORDS];
+  Record* records = chunk.load(memory_order_relaxed);
+  if (records == nullptr) {
+    records = new Record[CHUNK_RECORDS];
+    chunk.store(records, memory_order_release);
+  }
+  records[index % CHUNK_RECORDS] = {monotonic_nsecs(), step, flow_id, stage};
+  buffer.count.store(index + 1, memory_order_release);
+}
+
+void dump(void) {
+  if (not trace_enabled.load() or trace_dumped.exchange(true)) {
+    return;
+  }
+
+  /* written by hand: a trace easily holds millions of events */
+  FILE* out = fopen(trace_path.c_str(), "w");
+  if (out == nullptr) {
+    print_exception("trace", unix_error("fopen " + trace_path));
+    return;
+  }
+
+  const pid_t pid = getpid();
+  fprintf(out,
+          "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+          "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%d,"
+          "\"args\":{\"name\":\"%s\"}}",
+          pid, program_invocation_short_name);
+
+  uint64_t dropped = 0;
+  lock_guard<mutex> lock(registry_mutex);
+  for (const ThreadBuffer* buffer : registry) {
+    const size_t count = buffer->count.load(memory_order_acquire);
+    dropped += buffer->dropped.load(memory_order_relaxed);
+
+    for (size_t i = 0; i < count; i++) {
+      const Record& record = buffer->chunks[i / CHUNK_RECORDS].load(
+          memory_order_acquire)[i % CHUNK_RECORDS];
+
+      /* a step is one async slice across processes, keyed by flow and step;
+       * the stages in between are instants on it */
+      const char* phase = "n";
+      const char* name = stage_name(record.stage);
+      if (record.stage == TraceStage::ClientSample) {
+        phase = "b";
+        name = "control step";
+      } else if (record.stage == TraceStage::ClientSetCwnd) {
+        phase = "e";
+        name = "control step";
+      }
+
+      fprintf(out,
+              ",\n{\"ph\":\"%s\",\"cat\":\"control\",\"name\":\"%s\","
+              "\"id2\":{\"global\":\"0x%x:%llx\"},\"ts\":%llu.%03llu,"
+              "\"pid\":%d,\"tid\":%d,\"args\":{\"stage\":\"%s\","
+              "\"flow\":%u,\"step\":%llu}}",
+              phase, name, record.flow_id, (unsigned long long)record.step,
+              (unsigned long long)(record.ts_ns / 1000),
+              (unsigned long long)(record.ts_ns % 1000), pid, buffer->tid,
+              stage_name(record.stage), record.flow_id,
+              (unsigned long long)record.step);
+    }
+  }
+
+  fprintf(out, "\n],\"otherData\":{\"dropped\":%llu}}\n",
+          (unsigned long long)dropped);
+  fclose(out);
+}
+
+}  // namespace trace
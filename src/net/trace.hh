@@ -0,0 +1,62 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef TRACE_HH
+#define TRACE_HH
+
+#include <cstdint>
+#include <string>
+
+/* end-to-end tracing of control steps in Chrome trace format.
+ *
+ * Every stage a control step passes through is stamped with the monotonic
+ * clock into a buffer owned by the recording thread, so recording takes no
+ * lock and makes no syscall. Each process writes its own trace at exit;
+ * since all of them share CLOCK_MONOTONIC, the traces of a client and of
+ * the inference service can be merged into one timeline, e.g.
+ *
+ *   jq -s '{traceEvents: map(.traceEvents) | add}' client.json infer.json
+ *
+ * and opened in Perfetto or chrome://tracing, where each step shows up as
+ * one async slice from ClientSample to ClientSetCwnd.
+ *
+ * Tracing is compiled in only with ENABLE_TRACE; otherwise TRACE_STEP()
+ * expands to nothing. */
+enum class TraceStage : uint8_t {
+  ClientSample, /* before get_tcp_deepcc_info_json() */
+  ClientSend,
+  ServerReceive,
+  Enqueue, /* queued for batch inference */
+  BatchStart,
+  InferenceEnd,
+  ReplySend,
+  ClientSetCwnd, /* after set_tcp_cwnd() */
+};
+
+namespace trace {
+
+/* start recording and write the trace to `path` at exit */
+void enable(const std::string& path);
+bool enabled(void);
+
+/* stamp `stage` of control step `step` of `flow_id` */
+void record(const TraceStage stage, const uint32_t flow_id,
+            const uint64_t step);
+
+/* write everything recorded so far; called at exit once enabled */
+void dump(void);
+
+}  // namespace trace
+
+#ifdef ENABLE_TRACE
+#define TRACE_STEP(stage, flow_id, step) \
+  trace::record(TraceStage::stage, (flow_id), (step))
+#else
+/* arguments stay unevaluated, but count as used */
+#define TRACE_STEP(stage, flow_id, step) \
+  do {                                   \
+    (void)sizeof(flow_id);               \
+    (void)sizeof(step);                  \
+  } while (0)
+#endif
+
+#endif /* TRACE_HH */
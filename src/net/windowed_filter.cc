@@ -0,0 +1,50 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "windowed_filter.hh"
+
+uint64_t WindowedMaxFilter::update(const uint64_t time, const uint64_t value) {
+  const Sample sample{time, value};
+
+  if (window_ == 0) {
+    if (value >= samples_[0].value) {
+      restart(sample);
+    }
+    return get();
+  }
+
+  /* a new maximum, or nothing left in the window */
+  if (value >= samples_[0].value or time - samples_[2].time > window_) {
+    restart(sample);
+    return get();
+  }
+
+  if (value >= samples_[1].value) {
+    samples_[2] = samples_[1] = sample;
+  } else if (value >= samples_[2].value) {
+    samples_[2] = sample;
+  }
+
+  /* age the samples: the best of the window has left it, or a sub-window
+   * has gone by with its best sample still the overall one */
+  const uint64_t age = time - samples_[0].time;
+  if (age > window_) {
+    samples_[0] = samples_[1];
+    samples_[1] = samples_[2];
+    samples_[2] = sample;
+    if (time - samples_[0].time > window_) {
+      samples_[0] = samples_[1];
+      samples_[1] = samples_[2];
+      samples_[2] = sample;
+    }
+  } else if (samples_[1].time == samples_[0].time and age > window_ / 4) {
+    samples_[2] = samples_[1] = sample;
+  } else if (samples_[2].time == samples_[1].time and age > window_ / 2) {
+    samples_[2] = sample;
+  }
+  return get();
+}
+
+void WindowedMaxFilter::reset(const uint64_t window) {
+  window_ = window;
+  samples_.fill(Sample{0, 0});
+}
@@ -0,0 +1,44 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef WINDOWED_FILTER_HH
+#define WINDOWED_FILTER_HH
+
+#include <array>
+#include <cstdint>
+
+/* maximum of a series over a sliding window of time.
+ *
+ * Kathleen Nichols' algorithm, as Linux runs it for BBR's bandwidth filter
+ * (lib/minmax.c): it keeps the best sample of the window and the best ones
+ * of its second half and last quarter, which become the maximum as older
+ * samples leave the window. O(1) per update and three samples of memory.
+ *
+ * A window of 0 keeps the maximum ever seen. Times only need to be
+ * monotonic, in the same unit as the window. */
+class WindowedMaxFilter {
+ public:
+  explicit WindowedMaxFilter(const uint64_t window = 0) : window_(window) {}
+
+  /* add `value` seen at `time`; returns the maximum over the window */
+  uint64_t update(const uint64_t time, const uint64_t value);
+
+  uint64_t get(void) const { return samples_[0].value; }
+  uint64_t window(void) const { return window_; }
+
+  /* forget the samples, e.g. when changing the window */
+  void reset(const uint64_t window);
+
+ private:
+  struct Sample {
+    uint64_t time;
+    uint64_t value;
+  };
+
+  uint64_t window_;
+  /* best of the window, of its last half and of its last quarter */
+  std::array<Sample, 3> samples_{};
+
+  void restart(const Sample& sample) { samples_.fill(sample); }
+};
+
+#endif /* WINDOWED_FILTER_HH */
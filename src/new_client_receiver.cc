@@ -12,17 +12,18 @@
 #include <cstring>
 
 #include "address.hh"
+#include "bulk_receiver.hh"
 #include "common.hh"
 #include "logging.hh"
 #include "socket.hh"
-
-#define BUFFER 1024
+#include "timestamp.hh"
 
 using namespace std;
-using clock_type = std::chrono::high_resolution_clock;
+using clock_type = SteadyClock;
 
 std::atomic<bool> recv_traffic(true);
-std::atomic<size_t> recv_cnt = 0;
+/* bytes received, one shard per data thread */
+ShardedCounter recv_cnt;
 static size_t last_observed_recv_cnt = 0;
 std::unique_ptr<std::ofstream> perf_log;
 
@@ -37,16 +38,12 @@ void signal_handler(int sig) {
   }
 }
 
-void data_thread(TCPSocket& sock, const uint64_t expected_bytes) {
-  size_t bytes_received = 0;
-  while (recv_traffic.load() and bytes_received < expected_bytes) {
+void data_thread(TCPSocket& sock, const uint64_t expected_bytes,
+                 const BulkReceiver::Mode recv_mode) {
+  BulkReceiver receiver(sock, recv_mode, recv_cnt);
+  while (recv_traffic.load() and receiver.bytes_received() < expected_bytes) {
     try {
-      size_t to_read = std::min<size_t>(BUFFER, expected_bytes - bytes_received);
-      size_t got = sock.read(to_read).length();
-      if (got > 0) {
-        recv_cnt += got;
-        bytes_received += got;
-      } else {
+      if (receiver.receive(expected_bytes - receiver.bytes_received()) == 0) {
         // Connection closed by server
         LOG(INFO) << "Server closed connection";
         break;
@@ -57,7 +54,7 @@ void data_thread(TCPSocket& sock, const uint64_t expected_bytes) {
     }
   }
   recv_traffic = false;  // signal the perf thread to stop so main can join
-  LOG(INFO) << "Data thread exits after receiving " << bytes_received << " bytes";
+  LOG(INFO) << "Data thread exits: " << receiver.summary();
 }
 
 void perf_log_thread(const std::chrono::milliseconds interval) {
@@ -66,7 +63,7 @@ void perf_log_thread(const std::chrono::milliseconds interval) {
   size_t tmp = 0;
   while (recv_traffic.load()) {
     // log the current throughput in Mbps
-    tmp = recv_cnt;
+    tmp = recv_cnt.total();
     unsigned long long current_thr =
         (tmp - last_observed_recv_cnt) * 8 / interval.count() * 1000 / 1000000;
     last_observed_recv_cnt = tmp;
@@ -82,9 +79,11 @@ void usage_error(const string& program_name) {
   cerr << "Usage: " << program_name << " [OPTION]... [COMMAND]" << endl;
   cerr << endl;
   cerr << "Options = --ip=IP_ADDR --port=PORT --cong=ALGORITHM (default: "
-          "CUBIC) --size=BYTES --perf-log=PATH(default is None) --perf-interval=MS"
+          "CUBIC) --size=BYTES --perf-log=PATH(default is None) --perf-interval=MS "
+          "--recv-mode=MODE"
        << endl
-       << "If perf_log is specified, the default log interval is 500ms" << endl;
+       << "If perf_log is specified, the default log interval is 500ms; "
+       << "recv-mode is copy (default), trunc or splice" << endl;
   cerr << endl;
 
   throw runtime_error("invalid arguments");
@@ -110,9 +109,11 @@ int main(int argc, char** argv) {
       {"size", required_argument, nullptr, 's'},
       {"perf-log", optional_argument, nullptr, 'l'},
       {"perf-interval", optional_argument, nullptr, 'i'},
+      {"recv-mode", required_argument, nullptr, 'r'},
       {0, 0, nullptr, 0}};
 
   string ip, service, cong_ctl, perf_log_path, interval;
+  BulkReceiver::Mode recv_mode = BulkReceiver::Mode::COPY;
   uint64_t requested_size = 0;
   while (true) {
     const int opt = getopt_long(argc, argv, "", command_line_options, nullptr);
@@ -135,6 +136,9 @@ int main(int argc, char** argv) {
     case 'p':
       service = optarg;
       break;
+    case 'r':
+      recv_mode = BulkReceiver::parse_mode(optarg);
+      break;
     case 's':
       requested_size = std::stoull(optarg);
       break;
@@ -207,7 +211,7 @@ int main(int argc, char** argv) {
   }
 
   // start data receiving thread
-  thread dt(data_thread, std::ref(client), requested_size);
+  thread dt(data_thread, std::ref(client), requested_size, recv_mode);
   LOG(INFO) << "Client is receiving data from server...";
 
   /* wait for finish */
@@ -15,11 +15,12 @@
 #include "common.hh"
 #include "logging.hh"
 #include "socket.hh"
+#include "timestamp.hh"
 
 #define BUFFER 1024
 
 using namespace std;
-using clock_type = std::chrono::high_resolution_clock;
+using clock_type = SteadyClock;
 
 std::atomic<bool> recv_traffic(true);
 std::atomic<size_t> recv_cnt = 0;
@@ -4,7 +4,6 @@
 
 #include <atomic>
 #include <chrono>
-#include <fstream>
 #include <iostream>
 #include <memory>
 #include <mutex>
@@ -13,24 +12,34 @@
 #include <vector>
 
 #include "address.hh"
+#include "bulk_sender.hh"
 #include "pid.hh"
 #include "child_process.hh"
 #include "common.hh"
+#include "control_sample.hh"
 #include "deepcc_socket.hh"
 #include "filesystem.hh"
+#include "helper_pool.hh"
 #include "ipc_socket.hh"
 #include "json.hpp"
 #include "logging.hh"
+#include "observation_sampler.hh"
+#include "paced_state_provider.hh"
+#include "perf_log.hh"
+#include "poller.hh"
+#include "send_buffer_sizer.hh"
 #include "serialization.hh"
+#include "signalfd.hh"
 #include "socket.hh"
 #include "system_runner.hh"
 #include "tcp_info.hh"
+#include "tcp_state_provider.hh"
+#include "timestamp.hh"
 
-#define BUFSIZ 1024
 #define ALG "astraea"
 
 using namespace std;
-using clock_type = std::chrono::high_resolution_clock;
+using clock_type = SteadyClock;
 using json = nlohmann::json;
 using IPC_ptr = std::unique_ptr<IPCSocket>;
 typedef DeepCCSocket::TCPInfoRequestType RequestType;
@@ -40,10 +49,18 @@ enum MessageType { INIT = 0, START = 1, END = 2, ALIVE = 3, OBSERVE = 4 };
 std::atomic<bool> send_traffic(true);
 std::atomic<size_t> send_cnt = 0;
 static size_t last_observed_send_cnt = 0;
-std::unique_ptr<std::ofstream> perf_log;
+std::unique_ptr<PerfLog> perf_log;
+/* set with --buffer-headroom */
+std::unique_ptr<SendBufferSizer> buffer_sizer;
 std::unique_ptr<IPCSocket> ipc;
 std::unique_ptr<ChildProcess> astraea_pyhelper;
 static int global_flow_id = 0;
+/* when the flow asked for its Python helper, for time-to-first-action */
+static clock_type::time_point helper_requested{};
+static bool first_action_done = false;
+
+/* payload of the last message from the inference side */
+static char ipc_buffer[UINT16_MAX];
 
 template <typename E>
 constexpr typename std::underlying_type<E>::type to_underlying(E e) noexcept {
@@ -65,24 +82,36 @@ void ipc_send_message(std::unique_ptr<IPCSocket>& ipc_sock, const MessageType& t
     message["type"] = to_underlying(type);
   }
 
-  uint16_t len = message.dump().length();
+  const std::string payload = message.dump();
   if (ipc_sock) {
-    ipc_sock->write(put_field(len) + message.dump());
+    ipc_sock->writev({put_field(payload.size()), payload});
   }
 }
 
 void do_congestion_control(DeepCCSocket& sock, std::unique_ptr<IPCSocket>& ipc) {
-  auto state = sock.get_tcp_deepcc_info_json(RequestType::REQUEST_ACTION);
-  LOG(TRACE) << "Server " << global_flow_id << " send state: " << state.dump();
-  ipc_send_message(ipc, MessageType::ALIVE, state);
+  const auto sample = sock.get_control_sample(RequestType::REQUEST_ACTION);
+  LOG(TRACE) << "Server " << global_flow_id << " send state: "
+             << sample.to_json().dump();
+  ipc_send_message(ipc, MessageType::ALIVE, sample.to_json());
 
   auto ts_now = clock_type::now();
 
-  auto header = ipc->read_exactly(2);
-  auto data_len = get_uint16(header.data());
-  auto data = ipc->read_exactly(data_len);
-  int cwnd = json::parse(data).at("cwnd");
+  char header[2];
+  ipc->read_exactly_into(header, sizeof(header));
+  const auto data_len = get_uint16(header);
+  ipc->read_exactly_into(ipc_buffer, data_len);
+  int cwnd = json::parse(ipc_buffer, ipc_buffer + data_len).at("cwnd");
   sock.set_tcp_cwnd(cwnd);
+  if (buffer_sizer) {
+    buffer_sizer->update(sample, cwnd);
+  }
+  if (not first_action_done) {
+    first_action_done = true;
+    LOG(INFO) << "Server " << global_flow_id << " time to first action: "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(
+                     clock_type::now() - helper_requested).count()
+              << "ms";
+  }
 
   auto elapsed = clock_type::now() - ts_now;
   LOG(DEBUG) << "Server GET cwnd: " << cwnd << ", elapsed time is "
@@ -90,64 +119,67 @@ void do_congestion_control(DeepCCSocket& sock, std::unique_ptr<IPCSocket>& ipc)
              << "us";
 
   if (perf_log) {
-    unsigned int srtt = state["srtt_us"];
-    srtt = srtt >> 3; // Convert to microseconds
-    *perf_log << state["min_rtt"] << "\t" << state["avg_urtt"] << "\t"
-              << state["cnt"] << "\t" << srtt << "\t" << state["avg_thr"]
-              << "\t" << state["thr_cnt"] << "\t" << state["pacing_rate"]
-              << "\t" << state["loss_bytes"] << "\t" << state["packets_out"]
-              << "\t" << state["retrans_out"] << "\t"
-              << state["max_packets_out"] << "\t" << state["cwnd"] << "\t"
-              << cwnd << endl;
+    sample.append_to(*perf_log, cwnd);
   }
 }
 
 void do_monitor(DeepCCSocket& sock) {
-  while (send_traffic.load()) {
-    auto state = sock.get_tcp_deepcc_info_json(RequestType::REQUEST_ACTION);
-    if (perf_log) {
-      unsigned int srtt = state["srtt_us"];
-      srtt = srtt >> 3; // Convert to microseconds
-      *perf_log << state["min_rtt"] << "\t" << state["avg_urtt"] << "\t"
-                << state["cnt"] << "\t" << srtt << "\t" << state["avg_thr"]
-                << "\t" << state["thr_cnt"] << "\t" << state["pacing_rate"]
-                << "\t" << state["loss_bytes"] << "\t" << state["packets_out"]
-                << "\t" << state["retrans_out"] << "\t"
-                << state["max_packets_out"] << "\t" << state["cwnd"] << "\t"
-                << 0 << endl;
-    }
-    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+  // the watching sampler's steps, read without the socket's lock
+  static StateSnapshot previous{};
+  const StateSnapshot snapshot = sock.snapshot();
+  if (snapshot.samples == previous.samples) {
+    return;
+  }
+  const auto sample = sock.control_sample(snapshot, previous);
+  previous = snapshot;
+  if (perf_log) {
+    sample.append_to(*perf_log, 0);
+  }
+  if (buffer_sizer) {
+    buffer_sizer->update(sample, sample.info.cwnd);
   }
 }
 
 void control_thread(DeepCCSocket& sock, std::unique_ptr<IPCSocket>& ipc,
-                   const std::chrono::milliseconds interval) {
+                    const bool use_RL, const std::chrono::milliseconds interval) {
   LOG(DEBUG) << "control_thread running";
-  auto when_started = clock_type::now();
-  auto target_time = when_started + interval;
+  // control and monitor ticks share the timers of one poller
+  Poller poller;
+  std::unique_ptr<ObservationSampler> sampler;
+  if (use_RL) {
+    poller.add_periodic_timer(
+        std::chrono::duration_cast<std::chrono::microseconds>(interval).count(),
+        [&]() { do_congestion_control(sock, ipc); }, 0);
+  } else {
+    // the sampler takes the steps; the monitor reads each one half a period
+    // after it was published
+    sampler = std::make_unique<ObservationSampler>(
+        sock, std::chrono::duration_cast<std::chrono::microseconds>(30ms).count(),
+        ObservationSampler::Mode::Watch);
+    poller.add_periodic_timer(
+        std::chrono::duration_cast<std::chrono::microseconds>(30ms).count(),
+        [&]() { do_monitor(sock); },
+        std::chrono::duration_cast<std::chrono::microseconds>(15ms).count());
+  }
   while (send_traffic.load()) {
-    LOG(DEBUG) << "do do_congestion_control running";
-    do_congestion_control(sock, ipc);
-    std::this_thread::sleep_until(target_time);
-    target_time += interval;
+    if (poller.poll(-1).result == Poller::Result::Type::Exit) {
+      break;
+    }
   }
+  auto stats = poller.timer_stats();
+  LOG(DEBUG) << "Server " << global_flow_id << " timers fired " << stats.fired
+             << " times, mean lateness "
+             << stats.total_lateness_us / std::max(stats.fired, uint64_t(1))
+             << "us, max lateness " << stats.max_lateness_us << "us";
 }
 
-void data_thread(TCPSocket& sock, const uint64_t requested_size) {
-  string data(BUFSIZ, 'a');
-  uint64_t sent_total = 0;
-  while (send_traffic.load() && sent_total < requested_size) {
-    size_t to_send = std::min<uint64_t>(data.size(), requested_size - sent_total);
-    if (to_send == data.size()) {
-      auto it = sock.write(data, true);
-      sent_total += (it - data.begin());
-    } else {
-      string chunk = data.substr(0, to_send);
-      auto it = sock.write(chunk, true);
-      sent_total += (it - chunk.begin());
-    }
+void data_thread(TCPSocket& sock, const uint64_t requested_size,
+                 const BulkSender::Mode send_mode) {
+  BulkSender sender(sock, send_mode);
+  while (send_traffic.load() && sender.bytes_sent() < requested_size) {
+    sender.send(requested_size - sender.bytes_sent());
   }
-  LOG(INFO) << "Data thread exits after sending " << sent_total << " bytes";
+  LOG(INFO) << "Data thread exits: " << sender.summary();
   send_traffic = false;
 }
 
@@ -170,7 +202,8 @@ void usage_error(const string& program_name) {
   cerr << endl;
   cerr << "Options = --port=PORT --cong=ALGORITHM --interval=INTERVAL (Milliseconds) "
           "--pyhelper=PYTHON_PATH --model=MODEL_PATH --id=None --perf-log=PATH "
-          "--perf-interval=MS"
+          "--perf-interval=MS --send-mode=MODE --helper-pool=None "
+          "--tcp-state=deepcc --buffer-headroom=0 --actuation=cwnd"
        << endl;
   cerr << endl;
   cerr << "Default congestion control algorithm is CUBIC; " << endl
@@ -179,16 +212,27 @@ void usage_error(const string& program_name) {
        << "pyhelper specifies the path of Python-inference script; " << endl
        << "model-path specifies the pre-trained model, and will be passed to "
           "python inference module; " << endl
-       << "If perf_log is specified, the default log interval is 500ms" << endl;
+       << "If perf_log is specified, the default log interval is 500ms; " << endl
+       << "send-mode is buffer (default), zerocopy, sendfile or splice; " << endl
+       << "helper-pool takes a ready helper from the helper_pool listening "
+          "there instead of starting one; " << endl
+       << "tcp-state is deepcc (the patched kernel) or tcp_info (any kernel); "
+       << endl
+       << "buffer-headroom sizes the send buffer to that many times the "
+          "bytes in flight, and the unsent bytes to one less BDP (0: the "
+          "kernel's sizes); "
+       << endl
+       << "actuation is cwnd (the window alone) or pacing (also a pacing rate "
+          "of the window per min_rtt)"
+       << endl;
 
   throw runtime_error("invalid arguments");
 }
 
 int main(int argc, char** argv) {
-  /* register signal handler */
-  signal(SIGTERM, signal_handler);
-  signal(SIGKILL, signal_handler);
-  signal(SIGINT, signal_handler);
+  /* handle SIGINT and SIGTERM on a thread, where closing the perf log may
+     wait on its writer; a signal handler could interrupt the lock it needs */
+  handle_signals_on_thread({SIGINT, SIGTERM}, signal_handler);
   /* ignore SIGPIPE generated by Socket write */
   if (signal(SIGPIPE, SIG_IGN) == SIG_ERR) {
     throw runtime_error("signal: failed to ignore SIGPIPE");
@@ -206,20 +250,39 @@ int main(int argc, char** argv) {
       {"id", optional_argument, nullptr, 'f'},
       {"perf-log", optional_argument, nullptr, 'l'},
       {"perf-interval", optional_argument, nullptr, 'i'},
+      {"send-mode", required_argument, nullptr, 's'},
+      {"helper-pool", required_argument, nullptr, 'o'},
+      {"tcp-state", required_argument, nullptr, 'e'},
+      {"buffer-headroom", required_argument, nullptr, 'b'},
+      {"actuation", required_argument, nullptr, 'n'},
       {0, 0, nullptr, 0}};
 
   /* use RL inference or not */
   bool use_RL = false;
-  string service, pyhelper, model, cong_ctl, interval, id, perf_log_path, perf_interval;
+  string service, pyhelper, model, cong_ctl, interval, id, perf_log_path, perf_interval,
+      helper_pool;
+  /* patched kernel, or TCP_INFO on any kernel */
+  string tcp_state = "deepcc";
+  BulkSender::Mode send_mode = BulkSender::Mode::BUFFER;
+  /* size the send buffer to the BDP unless 0 */
+  double buffer_headroom = 0;
+  /* the window alone, or paced as well */
+  string actuation = "cwnd";
   while (true) {
     const int opt = getopt_long(argc, argv, "", command_line_options, nullptr);
     if (opt == -1) { /* end of options */
       break;
     }
     switch (opt) {
+    case 'b':
+      buffer_headroom = stod(optarg);
+      break;
     case 'c':
       cong_ctl = optarg;
       break;
+    case 'e':
+      tcp_state = optarg;
+      break;
     case 'f':
       id = optarg;
       break;
@@ -235,9 +298,18 @@ int main(int argc, char** argv) {
     case 'm':
       model = optarg;
       break;
+    case 'n':
+      actuation = optarg;
+      break;
+    case 'o':
+      helper_pool = optarg;
+      break;
     case 'p':
       service = optarg;
       break;
+    case 's':
+      send_mode = BulkSender::parse_mode(optarg);
+      break;
     case 't':
       interval = optarg;
       break;
@@ -261,36 +333,46 @@ int main(int argc, char** argv) {
   }
 
   std::chrono::milliseconds control_interval(20ms);
-  if ((cong_ctl == "astraea" or cong_ctl == "rtcp_astraea") and not(pyhelper.empty() or model.empty())) {
-    if (not fs::exists(pyhelper)) {
-      throw runtime_error("Pyhelper does not exist");
-    }
-    if (not fs::exists(model)) {
-      throw runtime_error("Trained model does not exist");
+  if ((cong_ctl == "astraea" or cong_ctl == "rtcp_astraea") and
+      not(helper_pool.empty() and (pyhelper.empty() or model.empty()))) {
+    helper_requested = clock_type::now();
+    if (not helper_pool.empty()) {
+      /* the pool's helpers have loaded their model already */
+      ipc = make_unique<IPCSocket>(HelperPool::checkout(helper_pool));
+      LOG(INFO) << "Server: got a Python helper from the pool at "
+                << helper_pool;
+    } else {
+      if (not fs::exists(pyhelper)) {
+        throw runtime_error("Pyhelper does not exist");
+      }
+      if (not fs::exists(model)) {
+        throw runtime_error("Trained model does not exist");
+      }
+      string ipc_dir = "astraea_ipc";
+      fs::create_directory(ipc_dir);
+      string ipc_file = fs::path(ipc_dir) / ("astraea" + to_string(pid()));
+      IPCSocket ipcsock;
+      ipcsock.set_reuseaddr();
+      ipcsock.bind(ipc_file);
+      ipcsock.listen();
+
+      fs::path ipc_path = fs::current_path() / ipc_file;
+
+      LOG(INFO) << "Server: IPC listen at " << ipc_path;
+
+      vector<string> prog_args{pyhelper, "--ipc-path", ipc_path,
+                               "--model-path", model};
+      astraea_pyhelper = std::make_unique<ChildProcess>(
+          pyhelper,
+          [&pyhelper, &prog_args]() { return ezexec(pyhelper, prog_args); });
+
+      LOG(INFO) << "Server: started subprocess of Python helper";
+      ipc = make_unique<IPCSocket>(ipcsock.accept());
     }
-    string ipc_dir = "astraea_ipc";
-    fs::create_directory(ipc_dir);
-    string ipc_file = fs::path(ipc_dir) / ("astraea" + to_string(pid()));
-    IPCSocket ipcsock;
-    ipcsock.set_reuseaddr();
-    ipcsock.bind(ipc_file);
-    ipcsock.listen();
-
-    fs::path ipc_path = fs::current_path() / ipc_file;
-
-    LOG(INFO) << "Server: IPC listen at " << ipc_path;
-
-    vector<string> prog_args{pyhelper, "--ipc-path", ipc_path, "--model-path",
-                             model};
-    astraea_pyhelper = std::make_unique<ChildProcess>(
-        pyhelper,
-        [&pyhelper, &prog_args]() { return ezexec(pyhelper, prog_args); });
 
     if (not interval.empty()) {
       control_interval = std::move(std::chrono::milliseconds(stoi(interval)));
     }
-    LOG(INFO) << "Server: started subprocess of Python helper";
-    ipc = make_unique<IPCSocket>(ipcsock.accept());
     LOG(INFO) << "Server " << global_flow_id
               << " IPC with env has been established, control interval is "
               << control_interval.count() << "ms";
@@ -306,13 +388,15 @@ int main(int argc, char** argv) {
 
   std::chrono::milliseconds log_interval(500ms);
   if (not perf_log_path.empty()) {
-    perf_log.reset(new std::ofstream(perf_log_path));
-    if (not perf_log->good()) {
-      throw runtime_error(perf_log_path + ": error opening for writing");
-    }
     if (not perf_interval.empty()) {
       log_interval = std::chrono::milliseconds(stoi(perf_interval));
     }
+    // Astraea logs the column names, other algorithms the interval
+    perf_log = std::make_unique<PerfLog>(
+        perf_log_path, ControlSample::perf_log_columns(),
+        use_RL ? ""
+               : "# Interval = " + std::to_string(log_interval.count()) +
+                     "ms\n");
   }
 
   int port = stoi(service);
@@ -324,6 +408,8 @@ int main(int argc, char** argv) {
   LOG(INFO) << "Server listen at " << port;
 
   DeepCCSocket client = server.accept();
+  client.set_state_provider(PacedStateProvider::with_actuation(
+      actuation, TCPStateProvider::make(tcp_state)));
   struct timeval timeout = {10, 0};
   setsockopt(client.fd_num(), SOL_SOCKET, SO_RCVTIMEO, (char *)&timeout, sizeof(timeout));
   setsockopt(client.fd_num(), SOL_SOCKET, SO_SNDTIMEO, (char *)&timeout, sizeof(timeout));
@@ -338,6 +424,9 @@ int main(int argc, char** argv) {
     LOG(DEBUG) << "Server " << global_flow_id << " "
                << "enables deepCC plugin: " << enable_deepcc;
   }
+  if (buffer_headroom > 0) {
+    buffer_sizer = std::make_unique<SendBufferSizer>(client, buffer_headroom);
+  }
 
   // Read requested size from client (uint64_t)
   uint64_t requested_size = 0;
@@ -350,39 +439,23 @@ int main(int argc, char** argv) {
     LOG(INFO) << "Client requested " << requested_size << " bytes";
   }
 
-  if (use_RL and perf_log) {
-    *perf_log << "min_rtt\t"
-              << "avg_urtt\t"
-              << "cnt\t"
-              << "srtt_us\t"
-              << "avg_thr\t"
-              << "thr_cnt\t"
-              << "pacing_rate\t"
-              << "loss_bytes\t"
-              << "packets_out\t"
-              << "retrans_out\t"
-              << "max_packets_out\t"
-              << "CWND in Kernel\t"
-              << "CWND to Assign" << endl;
-  } else if (perf_log) {
-    *perf_log << "# Interval = " << log_interval.count() << "ms" << endl;
-  }
-
   // start threads
   thread ct;
   thread log_thread;
 
   if (use_RL and ipc != nullptr) {
     ct = std::move(thread(control_thread, std::ref(client), std::ref(ipc),
-                          control_interval));
+                          true, control_interval));
     LOG(DEBUG) << "Server " << global_flow_id << " Started control thread ... ";
-  } else if (cong_ctl != "astraea" and cong_ctl != "rtcp_astraea" and perf_log != nullptr) {
+  } else if (cong_ctl != "astraea" and cong_ctl != "rtcp_astraea" and
+             (perf_log or buffer_sizer)) {
     LOG(INFO) << "Launch monitor thread for " << cong_ctl << " ...";
-    ct = thread(do_monitor, std::ref(client));
+    ct = thread(control_thread, std::ref(client), std::ref(ipc), false,
+                control_interval);
   }
 
   // start data sending thread with requested size
-  thread dt(data_thread, std::ref(client), requested_size);
+  thread dt(data_thread, std::ref(client), requested_size, send_mode);
   LOG(INFO) << "Server " << global_flow_id << " is sending data to client...";
 
   /* wait for finish */
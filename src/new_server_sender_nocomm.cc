@@ -16,6 +16,7 @@
 #include "pid.hh"
 #include "child_process.hh"
 #include "common.hh"
+#include "control_sample.hh"
 #include "deepcc_socket.hh"
 #include "filesystem.hh"
 #include "ipc_socket.hh"
@@ -25,12 +26,13 @@
 #include "socket.hh"
 #include "system_runner.hh"
 #include "tcp_info.hh"
+#include "timestamp.hh"
 
 #define BUFSIZ 1024
 #define ALG "astraea"
 
 using namespace std;
-using clock_type = std::chrono::high_resolution_clock;
+using clock_type = SteadyClock;
 using json = nlohmann::json;
 using IPC_ptr = std::unique_ptr<IPCSocket>;
 typedef DeepCCSocket::TCPInfoRequestType RequestType;
@@ -40,6 +42,8 @@ enum MessageType { INIT = 0, START = 1, END = 2, ALIVE = 3, OBSERVE = 4 };
 std::atomic<bool> send_traffic(true);
 std::atomic<size_t> send_cnt = 0;
 static size_t last_observed_send_cnt = 0;
+// rows end in "\n" and are buffered: closed at the end of main() and on
+// SIGINT/SIGTERM, but the unwritten tail is lost if the process is killed
 std::unique_ptr<std::ofstream> perf_log;
 std::unique_ptr<IPCSocket> ipc;
 std::unique_ptr<ChildProcess> astraea_pyhelper;
@@ -71,9 +75,10 @@ void ipc_send_message(std::unique_ptr<IPCSocket>& ipc_sock, const MessageType& t
 }
 
 void do_congestion_control(DeepCCSocket& sock, std::unique_ptr<IPCSocket>& ipc) {
-  auto state = sock.get_tcp_deepcc_info_json(RequestType::REQUEST_ACTION);
-  LOG(TRACE) << "Server " << global_flow_id << " send state: " << state.dump();
-  ipc_send_message(ipc, MessageType::ALIVE, state);
+  const auto sample = sock.get_control_sample(RequestType::REQUEST_ACTION);
+  LOG(TRACE) << "Server " << global_flow_id << " send state: "
+             << sample.to_json().dump();
+  ipc_send_message(ipc, MessageType::ALIVE, sample.to_json());
 
   auto ts_now = clock_type::now();
 
@@ -89,31 +94,15 @@ void do_congestion_control(DeepCCSocket& sock, std::unique_ptr<IPCSocket>& ipc)
              << "us";
 
   if (perf_log) {
-    unsigned int srtt = state["srtt_us"];
-    srtt = srtt >> 3; // Convert to microseconds
-    *perf_log << state["min_rtt"] << "\t" << state["avg_urtt"] << "\t"
-              << state["cnt"] << "\t" << srtt << "\t" << state["avg_thr"]
-              << "\t" << state["thr_cnt"] << "\t" << state["pacing_rate"]
-              << "\t" << state["loss_bytes"] << "\t" << state["packets_out"]
-              << "\t" << state["retrans_out"] << "\t"
-              << state["max_packets_out"] << "\t" << state["cwnd"] << "\t"
-              << cwnd << endl;
+    sample.write_tsv(*perf_log, cwnd);
   }
 }
 
 void do_monitor(DeepCCSocket& sock) {
   while (send_traffic.load()) {
-    auto state = sock.get_tcp_deepcc_info_json(RequestType::REQUEST_ACTION);
+    const auto sample = sock.get_control_sample(RequestType::REQUEST_ACTION);
     if (perf_log) {
-      unsigned int srtt = state["srtt_us"];
-      srtt = srtt >> 3; // Convert to microseconds
-      *perf_log << state["min_rtt"] << "\t" << state["avg_urtt"] << "\t"
-                << state["cnt"] << "\t" << srtt << "\t" << state["avg_thr"]
-                << "\t" << state["thr_cnt"] << "\t" << state["pacing_rate"]
-                << "\t" << state["loss_bytes"] << "\t" << state["packets_out"]
-                << "\t" << state["retrans_out"] << "\t"
-                << state["max_packets_out"] << "\t" << state["cwnd"] << "\t"
-                << 0 << endl;
+      sample.write_tsv(*perf_log, 0);
     }
     std::this_thread::sleep_for(std::chrono::milliseconds(30));
   }
@@ -344,19 +333,7 @@ int main(int argc, char** argv) {
   LOG(INFO) << "Will send " << requested_size << " bytes to client (no size handshake)";
 
   if (use_RL and perf_log) {
-    *perf_log << "min_rtt\t"
-              << "avg_urtt\t"
-              << "cnt\t"
-              << "srtt_us\t"
-              << "avg_thr\t"
-              << "thr_cnt\t"
-              << "pacing_rate\t"
-              << "loss_bytes\t"
-              << "packets_out\t"
-              << "retrans_out\t"
-              << "max_packets_out\t"
-              << "CWND in Kernel\t"
-              << "CWND to Assign" << endl;
+    *perf_log << ControlSample::perf_log_header() << endl;
   } else if (perf_log) {
     *perf_log << "# Interval = " << log_interval.count() << "ms" << endl;
   }
@@ -382,4 +359,7 @@ int main(int argc, char** argv) {
   if (log_thread.joinable()) {
     log_thread.join();
   }
+  if (perf_log) {
+    perf_log->close();
+  }
 }
\ No newline at end of file
@@ -13,17 +13,20 @@
 #include "deepcc_socket.hh"
 #include "exception.hh"
 #include "filesystem.hh"
+#include "frame_codec.hh"
 #include "ipc_socket.hh"
 #include "json.hpp"
 #include "logging.hh"
 #include "poller.hh"
 #include "serialization.hh"
+#include "signalfd.hh"
 #include "socket.hh"
 #include "tcp_info.hh"
+#include "timestamp.hh"
 
 using namespace std;
 using namespace std::literals;
-using clock_type = std::chrono::high_resolution_clock;
+using clock_type = SteadyClock;
 using namespace PollerShortNames;
 typedef DeepCCSocket::TCPInfoRequestType RequestType;
 
@@ -72,48 +75,59 @@ std::unique_ptr<FileDescriptor> setup_ipc_socket(const string& ipc_file) {
   return std::make_unique<FileDescriptor>(std::move(tmp_ipc));
 }
 
+/* apply one control message from the user and queue the resulting state */
+void control(DeepCCSocket& client, const std::string_view reply,
+             const std::chrono::milliseconds interval, FrameWriter& replies) {
+  int cwnd = -1, flow = -1, msg = -1;
+  auto data = json::parse(reply.begin(), reply.end());
+  try {
+    cwnd = data.at("cwnd");
+    flow = data.at("tun_id");
+    msg = data.at("msg");
+    LOG(DEBUG) << "GET cwnd for flow " << flow << " from user: " << cwnd
+               << "; msg is " << msg;
+  } catch (const exception& e) {
+    print_exception("set_cwnd", e);
+    throw runtime_error("Cannot get control message from user");
+  }
+  // wait for cwnd enforcement or not
+  if (msg == 1) {
+    // enforce cwnd and wait for effect
+    client.set_tcp_cwnd(cwnd);
+    // prepare state
+    auto target_time = clock_type::now() + interval;
+    std::this_thread::sleep_until(target_time);
+  }
+  json info = client.get_tcp_deepcc_info_json(RequestType::REQUEST_ACTION);
+  LOG(TRACE) << info.dump();
+  /*
+   * write info to IPC socket
+   * info should be string dumped from json
+   */
+  json state = info;
+  json message;
+  message["state"] = state;
+  message["tun_id"] = flow;
+  replies.push(message.dump());
+}
+
 void control_thread(DeepCCSocket& client, IPC_ptr& ipc,
                     std::chrono::milliseconds interval = 10ms, int id = -1) {
+  FrameReader frames(*ipc);
+  FrameWriter replies(*ipc);
   poller.add_action(Poller::Action(
       *ipc, Direction::In,
       // callback
       [&]() -> ResultType {
-        auto header = ipc->read_exactly(2);
-        auto reply_len = get_uint16(header.data());
-        auto reply = ipc->read_exactly(reply_len);
-        int cwnd = -1, flow = -1, msg = -1;
-        auto data = json::parse(reply);
-        try {
-          cwnd = data.at("cwnd");
-          flow = data.at("tun_id");
-          msg = data.at("msg");
-          LOG(DEBUG) << "GET cwnd for flow " << flow << " from user: " << cwnd
-                     << "; msg is " << msg;
-        } catch (const exception& e) {
-          print_exception("set_cwnd", e);
-          throw runtime_error("Cannot get control message from user");
+        frames.fill();
+        if (frames.eof()) {
+          throw runtime_error("IPC closed by the user");
         }
-        // wait for cwnd enforcement or not
-        if (msg == 1) {
-          // enforce cwnd and wait for effect
-          client.set_tcp_cwnd(cwnd);
-          // prepare state
-          auto target_time = clock_type::now() + interval;
-          std::this_thread::sleep_until(target_time);
+        // answer every message that has arrived, then write all the answers
+        while (const auto reply = frames.pop()) {
+          control(client, *reply, interval, replies);
         }
-        json info =
-            client.get_tcp_deepcc_info_json(RequestType::REQUEST_ACTION);
-        LOG(TRACE) << info.dump();
-        /*
-         * write info to IPC socket
-         * info should be string dumped from json
-         */
-        json state = info;
-        json message;
-        message["state"] = state;
-        message["tun_id"] = flow;
-        uint16_t len = message.dump().length();
-        ipc->write(put_field(len) + message.dump());
+        replies.flush();
       },
       // when interested
       []() { return true; },
@@ -149,10 +163,9 @@ void usage_error(const string& program_name) {
 }
 
 int main(int argc, char** argv) {
-  /* register signal handler */
-  signal(SIGTERM, signal_handler);
-  signal(SIGKILL, signal_handler);
-  signal(SIGINT, signal_handler);
+  /* handle SIGINT and SIGTERM on a thread, where the handler may log; a
+     signal handler could interrupt the logger holding the lock it needs */
+  handle_signals_on_thread({SIGINT, SIGTERM}, signal_handler);
 
   if (argc < 1) {
     usage_error(argv[0]);
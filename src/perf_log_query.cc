@@ -0,0 +1,265 @@
+#include <getopt.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "histogram.hh"
+#include "perf_log.hh"
+
+using namespace std;
+
+void usage_error(const string& program_name) {
+  cerr << "Usage: " << program_name << " [OPTION]... PERF_LOG..." << endl;
+  cerr << endl;
+  cerr << "Options = --from=SECONDS --to=SECONDS --window=MS --threads=N "
+          "--extremes"
+       << endl;
+  cerr << endl;
+  cerr << "Summarizes throughput, RTT, loss and cwnd of every log, and of all "
+          "of them together, over the records within [from, to] seconds "
+          "since each log was opened;"
+       << endl
+       << "throughput percentiles are over the mean of every --window "
+          "(default 1000ms);"
+       << endl
+       << "--extremes instead prints the minimum and maximum of every column"
+       << endl;
+
+  throw runtime_error("invalid arguments");
+}
+
+/* the statistics of one log, or of several merged */
+struct Summary {
+  uint64_t records{0};
+  uint64_t span_us{0};
+  /* mean of avg_thr in every window */
+  Histogram throughput_kbps{};
+  Histogram srtt_us{};
+  /* bytes delivered, estimated as avg_thr over the time between records */
+  long double delivered{0};
+  uint64_t lost{0};
+  long double cwnd_sum{0};
+  uint64_t cwnd_min{UINT64_MAX};
+  uint64_t cwnd_max{0};
+
+  void merge(const Summary& other) {
+    records += other.records;
+    span_us = max(span_us, other.span_us);
+    throughput_kbps.merge(other.throughput_kbps);
+    srtt_us.merge(other.srtt_us);
+    delivered += other.delivered;
+    lost += other.lost;
+    cwnd_sum += other.cwnd_sum;
+    cwnd_min = min(cwnd_min, other.cwnd_min);
+    cwnd_max = max(cwnd_max, other.cwnd_max);
+  }
+};
+
+struct Query {
+  double from_s{0};
+  double to_s{-1}; /* negative: up to the end */
+  uint64_t window_us{1000000};
+
+  uint64_t from_us(const PerfLogReader& log) const {
+    return log.header().monotonic_origin_us + uint64_t(from_s * 1e6);
+  }
+  uint64_t to_us(const PerfLogReader& log) const {
+    return to_s < 0 ? UINT64_MAX
+                    : log.header().monotonic_origin_us + uint64_t(to_s * 1e6);
+  }
+};
+
+Summary summarize(const string& path, const Query& query) {
+  const PerfLogReader log(path);
+  const size_t thr = log.column("avg_thr");
+  const size_t srtt = log.column("srtt_us");
+  const size_t loss = log.column("loss_bytes");
+  const size_t cwnd = log.column("CWND in Kernel");
+  const uint64_t from_us = query.from_us(log);
+  const uint64_t to_us = query.to_us(log);
+
+  Summary summary;
+  uint64_t first_us = 0, previous_us = 0;
+  uint64_t window = 0, window_count = 0;
+  long double window_sum = 0;
+  auto close_window = [&] {
+    if (window_count > 0) {
+      summary.throughput_kbps.add(window_sum / window_count * 8 / 1000);
+    }
+    window_sum = 0;
+    window_count = 0;
+  };
+
+  log.for_each(from_us, to_us, [&](const uint64_t ts, const uint64_t* values) {
+    if (summary.records == 0) {
+      first_us = previous_us = ts;
+    }
+    summary.records++;
+
+    if ((ts - from_us) / query.window_us != window) {
+      close_window();
+      window = (ts - from_us) / query.window_us;
+    }
+    window_sum += values[thr];
+    window_count++;
+
+    summary.srtt_us.add(values[srtt]);
+    summary.delivered += (long double)values[thr] * (ts - previous_us) / 1e6;
+    summary.lost += values[loss];
+    summary.cwnd_sum += values[cwnd];
+    previous_us = ts;
+  });
+  close_window();
+
+  summary.span_us = previous_us - first_us;
+  /* served from the chunk summaries */
+  tie(summary.cwnd_min, summary.cwnd_max) = log.extremes(cwnd, from_us, to_us);
+  return summary;
+}
+
+void print_header(void) {
+  cout << "log\trecords\tseconds\tthr_mbps_mean\tthr_mbps_p5\tthr_mbps_p50\t"
+          "thr_mbps_p95\tsrtt_ms_p50\tsrtt_ms_p95\tsrtt_ms_p99\tloss_pct\t"
+          "cwnd_mean\tcwnd_min\tcwnd_max"
+       << endl;
+}
+
+void print_summary(const string& name, const Summary& summary) {
+  const Histogram& thr = summary.throughput_kbps;
+  const Histogram& srtt = summary.srtt_us;
+  const long double total = summary.delivered + summary.lost;
+  cout << name << "\t" << summary.records << fixed << setprecision(2) << "\t"
+       << summary.span_us / 1e6 << "\t" << thr.mean() / 1000 << "\t"
+       << thr.percentile(5) / 1000.0 << "\t" << thr.percentile(50) / 1000.0
+       << "\t" << thr.percentile(95) / 1000.0 << "\t"
+       << srtt.percentile(50) / 1000.0 << "\t" << srtt.percentile(95) / 1000.0
+       << "\t" << srtt.percentile(99) / 1000.0 << "\t"
+       << (total > 0 ? double(summary.lost * 100 / total) : 0.0) << "\t"
+       << (summary.records ? double(summary.cwnd_sum / summary.records) : 0.0)
+       << "\t" << (summary.records ? summary.cwnd_min : 0) << "\t"
+       << summary.cwnd_max << endl;
+}
+
+/* min and max of every column, from the chunk index alone where possible */
+string extremes(const string& path, const Query& query) {
+  const PerfLogReader log(path);
+  string out;
+  for (size_t c = 0; c < log.columns().size(); c++) {
+    const auto range = log.extremes(c, query.from_us(log), query.to_us(log));
+    if (range.first > range.second) {
+      continue;
+    }
+    out += path + "\t" + log.columns()[c] + "\t" + to_string(range.first) +
+           "\t" + to_string(range.second) + "\n";
+  }
+  return out;
+}
+
+/* call job(i) for every i < count on `threads` threads, rethrowing the first
+ * exception */
+template <typename Job>
+void parallel_for(const size_t count, const unsigned int threads, Job&& job) {
+  atomic<size_t> next{0};
+  vector<exception_ptr> errors(count);
+  vector<thread> workers;
+  for (unsigned int t = 0; t < min<size_t>(threads, count); t++) {
+    workers.emplace_back([&] {
+      for (size_t i = next++; i < count; i = next++) {
+        try {
+          job(i);
+        } catch (...) {
+          errors[i] = current_exception();
+        }
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  for (const auto& error : errors) {
+    if (error) {
+      rethrow_exception(error);
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  const option command_line_options[] = {
+      {"from", required_argument, nullptr, 'f'},
+      {"to", required_argument, nullptr, 't'},
+      {"window", required_argument, nullptr, 'w'},
+      {"threads", required_argument, nullptr, 'n'},
+      {"extremes", no_argument, nullptr, 'e'},
+      {0, 0, nullptr, 0}};
+
+  Query query;
+  unsigned int threads = max(1u, thread::hardware_concurrency());
+  bool print_extremes = false;
+  while (true) {
+    const int opt = getopt_long(argc, argv, "", command_line_options, nullptr);
+    if (opt == -1) { /* end of options */
+      break;
+    }
+    switch (opt) {
+    case 'f':
+      query.from_s = stod(optarg);
+      break;
+    case 't':
+      query.to_s = stod(optarg);
+      break;
+    case 'w':
+      query.window_us = stoul(optarg) * 1000;
+      break;
+    case 'n':
+      threads = stoul(optarg);
+      break;
+    case 'e':
+      print_extremes = true;
+      break;
+    case '?':
+      usage_error(argv[0]);
+      break;
+    default:
+      throw runtime_error("getopt_long: unexpected return value " +
+                          to_string(opt));
+    }
+  }
+  if (optind == argc or query.from_s < 0 or query.window_us == 0 or
+      threads == 0) {
+    usage_error(argv[0]);
+  }
+  const vector<string> paths(argv + optind, argv + argc);
+
+  if (print_extremes) {
+    vector<string> outputs(paths.size());
+    parallel_for(paths.size(), threads,
+                 [&](const size_t i) { outputs[i] = extremes(paths[i], query); });
+    cout << "log\tcolumn\tmin\tmax" << endl;
+    for (const auto& output : outputs) {
+      cout << output;
+    }
+    return 0;
+  }
+
+  vector<Summary> summaries(paths.size());
+  parallel_for(paths.size(), threads, [&](const size_t i) {
+    summaries[i] = summarize(paths[i], query);
+  });
+
+  print_header();
+  Summary all;
+  for (size_t i = 0; i < paths.size(); i++) {
+    print_summary(paths[i], summaries[i]);
+    all.merge(summaries[i]);
+  }
+  if (paths.size() > 1) {
+    print_summary("all", all);
+  }
+}
@@ -0,0 +1,71 @@
+#include <getopt.h>
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "perf_log.hh"
+
+using namespace std;
+
+void usage_error(const string& program_name) {
+  cerr << "Usage: " << program_name << " [OPTION]... PERF_LOG" << endl;
+  cerr << endl;
+  cerr << "Options = --timestamps" << endl;
+  cerr << endl;
+  cerr << "Prints a binary perf log as the tab-separated text the tools used "
+          "to write; "
+       << endl
+       << "--timestamps prefixes every row with its time in us since the log "
+          "was opened"
+       << endl;
+
+  throw runtime_error("invalid arguments");
+}
+
+int main(int argc, char** argv) {
+  const option command_line_options[] = {
+      {"timestamps", no_argument, nullptr, 't'}, {0, 0, nullptr, 0}};
+
+  bool timestamps = false;
+  while (true) {
+    const int opt = getopt_long(argc, argv, "", command_line_options, nullptr);
+    if (opt == -1) { /* end of options */
+      break;
+    }
+    switch (opt) {
+    case 't':
+      timestamps = true;
+      break;
+    case '?':
+      usage_error(argv[0]);
+      break;
+    default:
+      throw runtime_error("getopt_long: unexpected return value " +
+                          to_string(opt));
+    }
+  }
+  if (optind + 1 != argc) {
+    usage_error(argv[0]);
+  }
+
+  PerfLogReader log(argv[optind]);
+  const uint64_t origin_us = log.header().monotonic_origin_us;
+  const size_t columns = log.columns().size();
+
+  string out = log.preamble();
+  log.for_each([&](const uint64_t timestamp_us, const uint64_t* values) {
+    if (timestamps) {
+      out += to_string(timestamp_us - origin_us) + "\t";
+    }
+    for (size_t i = 0; i < columns; i++) {
+      out += to_string(values[i]);
+      out += i + 1 < columns ? '\t' : '\n';
+    }
+    if (out.size() >= (1 << 16)) {
+      cout << out;
+      out.clear();
+    }
+  });
+  cout << out;
+}
@@ -14,13 +14,14 @@
 #include "common.hh"
 #include "logging.hh"
 #include "socket.hh"
+#include "timestamp.hh"
 
 #define BUFFER 1024
 
 using namespace std;
-using clock_type = std::chrono::high_resolution_clock;
+using clock_type = SteadyClock;
 
-std::chrono::_V2::system_clock::time_point ts_now = clock_type::now();
+clock_type::time_point ts_now = clock_type::now();
 std::unique_ptr<std::ofstream> perf_log;
 std::atomic<bool> recv_traffic(true);
 std::atomic<size_t> recv_cnt = 0;
@@ -4,7 +4,6 @@
 
 #include <atomic>
 #include <chrono>
-#include <fstream>
 #include <iostream>
 #include <memory>
 #include <mutex>
@@ -13,24 +12,28 @@
 #include <vector>
 
 #include "address.hh"
+#include "bulk_sender.hh"
 #include "pid.hh"
 #include "child_process.hh"
 #include "common.hh"
+#include "control_sample.hh"
 #include "deepcc_socket.hh"
 #include "filesystem.hh"  // Add this line
 #include "ipc_socket.hh"
 #include "json.hpp"  // Add this
 #include "logging.hh"
+#include "perf_log.hh"
 #include "serialization.hh"  // Add this
+#include "signalfd.hh"
 #include "socket.hh"
 #include "system_runner.hh"
 #include "tcp_info.hh"  // Add this
+#include "timestamp.hh"
 
-#define BUFSIZ 1024
 #define ALG "astraea"
 
 using namespace std;
-using clock_type = std::chrono::high_resolution_clock;
+using clock_type = SteadyClock;
 using json = nlohmann::json;  // Add this
 using IPC_ptr = std::unique_ptr<IPCSocket>;  // Add this
 typedef DeepCCSocket::TCPInfoRequestType RequestType;  // Add this
@@ -40,11 +43,14 @@ enum MessageType { INIT = 0, START = 1, END = 2, ALIVE = 3, OBSERVE = 4 };
 std::atomic<bool> send_traffic(true);
 std::atomic<size_t> send_cnt = 0;
 static size_t last_observed_send_cnt = 0;
-std::unique_ptr<std::ofstream> perf_log;
+std::unique_ptr<PerfLog> perf_log;
 std::unique_ptr<IPCSocket> ipc;
 std::unique_ptr<ChildProcess> astraea_pyhelper;
 static int global_flow_id = 0;
 
+/* payload of the last message from the inference side */
+static char ipc_buffer[UINT16_MAX];
+
 // Add the to_underlying template function after the includes and before the enum
 template <typename E>
 constexpr typename std::underlying_type<E>::type to_underlying(E e) noexcept {
@@ -66,9 +72,9 @@ void ipc_send_message(std::unique_ptr<IPCSocket>& ipc_sock, const MessageType& t
     message["type"] = to_underlying(type);
   }
 
-  uint16_t len = message.dump().length();
+  const std::string payload = message.dump();
   if (ipc_sock) {
-    ipc_sock->write(put_field(len) + message.dump());
+    ipc_sock->writev({put_field(payload.size()), payload});
   }
 }
 
@@ -88,20 +94,22 @@ void signal_handler(int sig) {
 
 // Update the do_congestion_control function call (line 84) to use MessageType enum:
 void do_congestion_control(DeepCCSocket& sock, std::unique_ptr<IPCSocket>& ipc) {
-  auto state = sock.get_tcp_deepcc_info_json(RequestType::REQUEST_ACTION);
-  LOG(TRACE) << "Server " << global_flow_id << " send state: " << state.dump();
+  const auto sample = sock.get_control_sample(RequestType::REQUEST_ACTION);
+  LOG(TRACE) << "Server " << global_flow_id << " send state: "
+             << sample.to_json().dump();
   
   // Use proper ipc_send_message with MessageType enum
-  ipc_send_message(ipc, MessageType::ALIVE, state);
+  ipc_send_message(ipc, MessageType::ALIVE, sample.to_json());
   
   // Add timing measurement
   auto ts_now = clock_type::now();
   
   // Wait for action (this won't block indefinitely anymore)
-  auto header = ipc->read_exactly(2);
-  auto data_len = get_uint16(header.data());
-  auto data = ipc->read_exactly(data_len);
-  int cwnd = json::parse(data).at("cwnd");
+  char header[2];
+  ipc->read_exactly_into(header, sizeof(header));
+  const auto data_len = get_uint16(header);
+  ipc->read_exactly_into(ipc_buffer, data_len);
+  int cwnd = json::parse(ipc_buffer, ipc_buffer + data_len).at("cwnd");
   sock.set_tcp_cwnd(cwnd);
   
   auto elapsed = clock_type::now() - ts_now;
@@ -111,31 +119,15 @@ void do_congestion_control(DeepCCSocket& sock, std::unique_ptr<IPCSocket>& ipc)
   
   // Log performance data
   if (perf_log) {
-    unsigned int srtt = state["srtt_us"];
-    srtt = srtt >> 3; // Convert to microseconds
-    *perf_log << state["min_rtt"] << "\t" << state["avg_urtt"] << "\t"
-              << state["cnt"] << "\t" << srtt << "\t" << state["avg_thr"]
-              << "\t" << state["thr_cnt"] << "\t" << state["pacing_rate"]
-              << "\t" << state["loss_bytes"] << "\t" << state["packets_out"]
-              << "\t" << state["retrans_out"] << "\t"
-              << state["max_packets_out"] << "\t" << state["cwnd"] << "\t"
-              << cwnd << endl;
+    sample.append_to(*perf_log, cwnd);
   }
 }
 
 void do_monitor(DeepCCSocket& sock) {
   while (send_traffic.load()) {
-    auto state = sock.get_tcp_deepcc_info_json(RequestType::REQUEST_ACTION);
+    const auto sample = sock.get_control_sample(RequestType::REQUEST_ACTION);
     if (perf_log) {
-      unsigned int srtt = state["srtt_us"];
-      srtt = srtt >> 3; // Convert to microseconds
-      *perf_log << state["min_rtt"] << "\t" << state["avg_urtt"] << "\t"
-                << state["cnt"] << "\t" << srtt << "\t" << state["avg_thr"]
-                << "\t" << state["thr_cnt"] << "\t" << state["pacing_rate"]
-                << "\t" << state["loss_bytes"] << "\t" << state["packets_out"]
-                << "\t" << state["retrans_out"] << "\t"
-                << state["max_packets_out"] << "\t" << state["cwnd"] << "\t"
-                << 0 << endl;
+      sample.append_to(*perf_log, 0);
     }
     std::this_thread::sleep_for(std::chrono::milliseconds(30));
   }
@@ -155,12 +147,12 @@ void control_thread(DeepCCSocket& sock, std::unique_ptr<IPCSocket>& ipc,
   }
 }
 
-void data_thread(TCPSocket& sock) {
-  string data(BUFSIZ, 'a');
+void data_thread(TCPSocket& sock, const BulkSender::Mode send_mode) {
+  BulkSender sender(sock, send_mode);
   while (send_traffic.load()) {
-      sock.write(data, true);
+    sender.send();
   }
-  LOG(INFO) << "Data thread exits";
+  LOG(INFO) << "Data thread exits: " << sender.summary();
 }
 
 void usage_error(const string& program_name) {
@@ -168,7 +160,7 @@ void usage_error(const string& program_name) {
   cerr << endl;
   cerr << "Options = --port=PORT --cong=ALGORITHM --interval=INTERVAL (Milliseconds) "
           "--pyhelper=PYTHON_PATH --model=MODEL_PATH --id=None --perf-log=PATH "
-          "--perf-interval=MS"
+          "--perf-interval=MS --send-mode=MODE"
        << endl;
   cerr << endl;
   cerr << "Default congestion control algorithm is CUBIC; " << endl
@@ -177,16 +169,16 @@ void usage_error(const string& program_name) {
        << "pyhelper specifies the path of Python-inference script; " << endl
        << "model-path specifies the pre-trained model, and will be passed to "
           "python inference module; " << endl
-       << "If perf_log is specified, the default log interval is 500ms" << endl;
+       << "If perf_log is specified, the default log interval is 500ms; " << endl
+       << "send-mode is buffer (default), zerocopy, sendfile or splice" << endl;
 
   throw runtime_error("invalid arguments");
 }
 
 int main(int argc, char** argv) {
-  /* register signal handler */
-  signal(SIGTERM, signal_handler);
-  signal(SIGKILL, signal_handler);
-  signal(SIGINT, signal_handler);
+  /* handle SIGINT and SIGTERM on a thread, where closing the perf log may
+     wait on its writer; a signal handler could interrupt the lock it needs */
+  handle_signals_on_thread({SIGINT, SIGTERM}, signal_handler);
   /* ignore SIGPIPE generated by Socket write */
   if (signal(SIGPIPE, SIG_IGN) == SIG_ERR) {
     throw runtime_error("signal: failed to ignore SIGPIPE");
@@ -204,11 +196,13 @@ int main(int argc, char** argv) {
       {"id", optional_argument, nullptr, 'f'},
       {"perf-log", optional_argument, nullptr, 'l'},
       {"perf-interval", optional_argument, nullptr, 'i'},
+      {"send-mode", required_argument, nullptr, 's'},
       {0, 0, nullptr, 0}};
 
   /* use RL inference or not */
   bool use_RL = false;
   string service, pyhelper, model, cong_ctl, interval, id, perf_log_path, perf_interval;
+  BulkSender::Mode send_mode = BulkSender::Mode::BUFFER;
   while (true) {
     const int opt = getopt_long(argc, argv, "", command_line_options, nullptr);
     if (opt == -1) { /* end of options */
@@ -236,6 +230,9 @@ int main(int argc, char** argv) {
     case 'p':
       service = optarg;
       break;
+    case 's':
+      send_mode = BulkSender::parse_mode(optarg);
+      break;
     case 't':
       interval = optarg;
       break;
@@ -311,13 +308,15 @@ int main(int argc, char** argv) {
   // init perf log file
   std::chrono::milliseconds log_interval(500ms);
   if (not perf_log_path.empty()) {
-    perf_log.reset(new std::ofstream(perf_log_path));
-    if (not perf_log->good()) {
-      throw runtime_error(perf_log_path + ": error opening for writing");
-    }
     if (not perf_interval.empty()) {
       log_interval = std::chrono::milliseconds(stoi(perf_interval));
     }
+    // Astraea logs the column names, other algorithms the interval
+    perf_log = std::make_unique<PerfLog>(
+        perf_log_path, ControlSample::perf_log_columns(),
+        use_RL ? ""
+               : "# Interval = " + std::to_string(log_interval.count()) +
+                     "ms\n");
   }
 
   int port = stoi(service);
@@ -347,25 +346,6 @@ int main(int argc, char** argv) {
                << "enables deepCC plugin: " << enable_deepcc;
   }
 
-  /* setup performance log header for Astraea */
-  if (use_RL and perf_log) {
-    *perf_log << "min_rtt\t"
-              << "avg_urtt\t"
-              << "cnt\t"
-              << "srtt_us\t"
-              << "avg_thr\t"
-              << "thr_cnt\t"
-              << "pacing_rate\t"
-              << "loss_bytes\t"
-              << "packets_out\t"
-              << "retrans_out\t"
-              << "max_packets_out\t"
-              << "CWND in Kernel\t"
-              << "CWND to Assign" << endl;
-  } else if (perf_log) {
-    *perf_log << "# Interval = " << log_interval.count() << "ms" << endl;
-  }
-
   // start threads
   thread ct;
   thread log_thread;
@@ -382,7 +362,7 @@ int main(int argc, char** argv) {
 
 
   // start data sending thread
-  thread dt(data_thread, std::ref(client));
+  thread dt(data_thread, std::ref(client), send_mode);
   LOG(INFO) << "Server " << global_flow_id << " is sending data to client...";
 
   /* wait for finish */
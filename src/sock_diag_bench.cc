@@ -0,0 +1,115 @@
+#include <getopt.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "child_process.hh"
+#include "exception.hh"
+#include "histogram.hh"
+#include "sock_diag.hh"
+#include "socket.hh"
+#include "timestamp.hh"
+
+using namespace std;
+
+void usage_error(const string& program_name) {
+  cerr << "Usage: " << program_name << " [OPTION]..." << endl;
+  cerr << endl;
+  cerr << "Options = --flows=N --rounds=N" << endl;
+  cerr << endl;
+  cerr << "Opens N loopback connections (default 10000) and times reading "
+          "the tcp_info of all of them with one sock_diag dump against one "
+          "getsockopt(TCP_INFO) per socket"
+       << endl;
+
+  throw runtime_error("invalid arguments");
+}
+
+int main(int argc, char** argv) {
+  const option command_line_options[] = {
+      {"flows", required_argument, nullptr, 'n'},
+      {"rounds", required_argument, nullptr, 'r'},
+      {0, 0, nullptr, 0}};
+
+  size_t flows = 10000, rounds = 100;
+  while (true) {
+    const int opt = getopt_long(argc, argv, "", command_line_options, nullptr);
+    if (opt == -1) { /* end of options */
+      break;
+    }
+    switch (opt) {
+    case 'n':
+      flows = stoul(optarg);
+      break;
+    case 'r':
+      rounds = stoul(optarg);
+      break;
+    case '?':
+      usage_error(argv[0]);
+      break;
+    default:
+      throw runtime_error("getopt_long: unexpected return value " +
+                          to_string(opt));
+    }
+  }
+  if (optind != argc or flows == 0 or rounds == 0) {
+    usage_error(argv[0]);
+  }
+
+  TCPSocket listener;
+  listener.set_reuseaddr();
+  listener.bind(Address("127.0.0.1", 0));
+  listener.listen(SOMAXCONN);
+  const uint16_t port = listener.local_address().port();
+
+  /* the accepted ends live in a child, so that each process needs only one
+   * descriptor per flow */
+  ChildProcess acceptor("acceptor", [&]() {
+    vector<TCPSocket> accepted;
+    while (accepted.size() < flows) {
+      accepted.push_back(listener.accept());
+    }
+    while (true) {
+      pause();
+    }
+    return 0;
+  });
+
+  vector<TCPSocket> socks(flows);
+  for (auto& sock : socks) {
+    sock.connect(Address("127.0.0.1", port));
+  }
+  cerr << "Connected " << flows << " flows to port " << port << endl;
+
+  /* only the connecting ends: their remote port is the listener's */
+  SockDiagCollector collector({AF_INET, 0, port, 0});
+  Histogram dump_us, getsockopt_us;
+  for (size_t round = 0; round < rounds; round++) {
+    uint64_t start = monotonic_usecs();
+    const size_t found = collector.collect().size();
+    dump_us.add(monotonic_usecs() - start);
+    if (found != flows) {
+      throw runtime_error("sock_diag found " + to_string(found) + " of " +
+                          to_string(flows) + " flows");
+    }
+
+    start = monotonic_usecs();
+    for (auto& sock : socks) {
+      tcp_info info;
+      socklen_t len = sizeof(info);
+      SystemCall("getsockopt TCP_INFO", getsockopt(sock.fd_num(), IPPROTO_TCP,
+                                                   TCP_INFO, &info, &len));
+    }
+    getsockopt_us.add(monotonic_usecs() - start);
+  }
+
+  cout << "method\tus_per_round" << endl;
+  cout << "sock_diag\t" << dump_us.summary() << endl;
+  cout << "getsockopt\t" << getsockopt_us.summary() << endl;
+  return 0;
+}
@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "timer_wheel.hh"
+
+using namespace std;
+
+/* self-checks of TimerWheel; prints the failed cases and exits non-zero if
+ * there are any */
+
+static unsigned int failures = 0;
+
+static void check(const bool ok, const string& what) {
+  if (not ok) {
+    cerr << "FAIL: " << what << endl;
+    failures++;
+  }
+}
+
+/* a timer added at `now_us` with `delay_us` left, driven the way Poller
+ * drives the wheel: sleep until next_expiry_us(), then advance() */
+static void check_fires_on_time(const uint64_t now_us,
+                                const uint64_t delay_us) {
+  TimerWheel wheel(0);
+  wheel.advance(now_us);
+  uint64_t fired_us = 0;
+  uint64_t clock_us = now_us;
+  wheel.add(now_us, delay_us, [&] { fired_us = clock_us; });
+  const uint64_t deadline_us = now_us + delay_us;
+
+  const string name =
+      "timer at " + to_string(now_us) + " us + " + to_string(delay_us) + " us";
+  for (unsigned int wakeups = 0; fired_us == 0; wakeups++) {
+    const uint64_t next_us = wheel.next_expiry_us();
+    if (next_us > deadline_us + wheel.tick_us() or wakeups > 1000) {
+      check(false, name + ": next expiry " + to_string(next_us) +
+                       " us is past the deadline " + to_string(deadline_us));
+      return;
+    }
+    clock_us = max(clock_us, next_us);
+    wheel.advance(clock_us);
+  }
+  check(fired_us >= deadline_us and fired_us - deadline_us < wheel.tick_us(),
+        name + ": fired at " + to_string(fired_us) + " us");
+}
+
+/* a throwing callback leaves the wheel usable: a periodic timer keeps its
+ * period, and the timers due in the same tick run on the next advance() */
+static void check_throwing_callback(void) {
+  TimerWheel wheel(0);
+  unsigned int periodic = 0, others = 0;
+  wheel.add(0, 1000, [&] {
+    periodic++;
+    throw runtime_error("callback failed");
+  }, 1000);
+  for (int i = 0; i < 3; i++) {
+    wheel.add(0, 1000, [&] { others++; });
+  }
+
+  unsigned int thrown = 0;
+  for (uint64_t now_us = 1000; now_us <= 3000; now_us += 1000) {
+    for (;;) {
+      try {
+        wheel.advance(now_us);
+        break;
+      } catch (const runtime_error&) {
+        thrown++;
+      }
+    }
+  }
+  check(periodic == 3 and thrown == 3,
+        "throwing periodic timer ran " + to_string(periodic) + " times");
+  check(others == 3, "timers next to a throwing one ran " +
+                         to_string(others) + " times, not 3");
+  check(wheel.size() == 1, "wheel holds " + to_string(wheel.size()) +
+                               " timers, not the periodic one");
+}
+
+int main() {
+  /* advance() leaves the wheel on a level-0 wraparound (tick 128 here), and
+   * the cascade one wraparound later used to be skipped: 409 ms late */
+  check_fires_on_time(12700, 7000);
+
+  /* every phase against the wraparound, for delays on each level */
+  for (uint64_t now_us = 0; now_us < 3 * 64 * 100; now_us += 100) {
+    for (const uint64_t delay_us :
+         {50, 100, 6300, 6400, 7000, 12700, 409600, 500000, 30000000}) {
+      check_fires_on_time(now_us, delay_us);
+    }
+  }
+
+  check_throwing_callback();
+
+  if (failures > 0) {
+    cerr << failures << " checks failed" << endl;
+    return EXIT_FAILURE;
+  }
+  cout << "timer_wheel_check: all passed" << endl;
+  return EXIT_SUCCESS;
+}